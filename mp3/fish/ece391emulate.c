@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -176,6 +177,30 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+static uint8_t* back_screen = NULL;
+static uint8_t back_page[4096];
+
+int32_t 
+ece391_vidmap_buffered (uint8_t** screen_start)
+{
+    if (ece391_vidmap (&back_screen) == -1) {
+        back_screen = NULL;
+        return -1;
+    }
+    memcpy (back_page, back_screen, sizeof (back_page));
+    *screen_start = back_page;
+    return 0;
+}
+
+int32_t 
+ece391_vflip (void)
+{
+    if (back_screen == NULL)
+        return -1;
+    memcpy (back_screen, back_page, sizeof (back_page));
+    return 0;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -19,6 +19,57 @@ extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
+extern int32_t ece391_set_handler (int32_t signum, void* handler);
+extern int32_t ece391_sigreturn (void);
+
+/* Fills buf with the most recent syscalls, oldest first, in whole records.
+ * Returns the number of bytes copied. */
+typedef struct ece391_trace_rec {
+	uint32_t pid;
+	uint32_t num;
+	uint32_t args[3];
+	int32_t ret;
+	uint32_t cycles;
+} ece391_trace_rec_t;
+
+extern int32_t ece391_trace (void* buf, int32_t nbytes);
+
+/* Sampling profiler. prof_ctl starts sampling every interval RTC ticks, or
+ * stops with 0 and returns the number of samples dropped. prof_read drains
+ * samples into buf in whole records. */
+typedef struct ece391_prof_sample {
+	uint32_t eip;
+	uint32_t pid;
+} ece391_prof_sample_t;
+
+extern int32_t ece391_prof_ctl (int32_t interval);
+extern int32_t ece391_prof_read (void* buf, int32_t nbytes);
+
+/* Copies the calling program. Returns 0 in the copy and its pid in the
+ * original; both keep running. */
+extern int32_t ece391_fork (void);
+
+/* Waits for a forked child (pid, or any with -1) to halt and returns its
+ * pid, storing its halt status if status is not NULL. With WNOHANG it
+ * returns 0 instead of waiting. -1 if there is no such child. */
+#define WNOHANG 1
+extern int32_t ece391_wait (int32_t* status);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+/* Like vidmap, but maps a private back page, starting as a copy of the
+ * screen. Nothing drawn there shows until vflip copies the whole page to
+ * the screen at once. vflip returns -1 without a back page. */
+extern int32_t ece391_vidmap_buffered (uint8_t** screen_start);
+extern int32_t ece391_vflip (void);
+
+enum signums {
+	DIV_ZERO = 0,
+	SEGFAULT,
+	INTERRUPT,
+	ALARM,
+	USER1,
+	NUM_SIGNALS
+};
 
 #endif /* ECE391SYSCALL_H */
 
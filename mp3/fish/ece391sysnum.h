@@ -11,5 +11,13 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_TRACE   11
+#define SYS_PROF_CTL  12
+#define SYS_PROF_READ 13
+#define SYS_FORK    14
+#define SYS_WAIT    15
+#define SYS_WAITPID 16
+#define SYS_VIDMAP_BUFFERED 17
+#define SYS_VFLIP   18
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,541 @@
+/* createfs.c - Builds the MP3 filesystem image from a directory or an
+ * existing image
+ *
+ * usage: createfs (-i <dir> | -r <image>) [-a <file>]... [-o <image>] [-c] [-s] [-H] [-z] [-f]
+ *
+ *   -i  regular files of a flat directory, plus "." and "rtc"
+ *   -r  the dentries, inodes and blocks of an existing image
+ *   -a  add a host file under its base name, replacing a file of the same
+ *       name and keeping its dentry slot. Implies -c.
+ *   -o  image to write; without it the input is only read (useful with -f)
+ *   -c  lay each file's data blocks out contiguously, in dentry order.
+ *       Always done for -i; for -r the old block numbers are kept unless
+ *       this is given, so that -r alone rewrites the image byte for byte.
+ *   -s  sort the dentries by name, "." stays first
+ *   -H  store a name hash table in the reserved bytes (see fs_driver.h).
+ *       An image read with -r that has one gets it rebuilt.
+ *   -z  compress every regular file that ends up a block or more smaller,
+ *       as ftype 5 (see LZ_FTYPE in fs_driver.h)
+ *   -f  print each file's fragmentation in the image written (or read)
+ *
+ * The layout matches fs_driver.h: a 4kB boot block of 64 byte dentries,
+ * then one 4kB block per inode, then the data blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define BLOCK_SIZE              4096
+#define MAX_FILENAME            32
+#define BOOT_DENTRY_NUM         63
+#define NUM_INODES              64
+#define INODE_DATA_BLOCK_NUM    1023
+#define DENTRY_RESERVED_BYTES   24
+#define BOOT_RESERVED_BYTES     52
+
+#define FTYPE_RTC               0
+#define FTYPE_DIR               1
+#define FTYPE_FILE              2
+#define FTYPE_LZ                5
+
+/* LZ4 block format limits: the last 5 bytes are always literals and no
+ * match starts in the last 12 */
+#define LZ4_MIN_MATCH           4
+#define LZ4_LAST_LITERALS       5
+#define LZ4_MFLIMIT             12
+#define LZ4_RUN_MASK            15
+#define LZ4_HASH_BITS           12
+
+/* Name hash table, must match fs_driver.h */
+#define FS_HASH_MAGIC           0x3154484E  /* "NHT1" */
+#define FS_HASH_BUCKETS         32
+#define FNV_OFFSET              2166136261u
+#define FNV_PRIME               16777619u
+
+typedef struct {
+    uint8_t fname[MAX_FILENAME];
+    uint32_t ftype;
+    uint32_t inode_num;
+    uint8_t reserved[DENTRY_RESERVED_BYTES];
+} dentry_t;
+
+typedef struct {
+    uint32_t num_dentries;
+    uint32_t num_inodes;
+    uint32_t num_data_blocks;
+    uint8_t reserved[BOOT_RESERVED_BYTES];
+    dentry_t dentry[BOOT_DENTRY_NUM];
+} boot_block_t;
+
+/* Reserved bytes of the boot block when -H is given */
+typedef struct {
+    uint32_t magic;
+    uint8_t buckets;
+    uint8_t head[FS_HASH_BUCKETS];      /* dentry index + 1, 0 for none */
+} hash_table_t;
+
+/* Reserved bytes of a dentry when -H is given */
+typedef struct {
+    uint32_t hash;
+    uint8_t next;                       /* dentry index + 1 in the same bucket */
+} dentry_hash_t;
+
+/* One dentry with its file's contents in memory */
+typedef struct {
+    dentry_t dentry;
+    uint8_t* data;
+    uint32_t length;                    /* file length, the inode's */
+    uint32_t stored;                    /* bytes in data blocks, less if compressed */
+    uint32_t nblocks;
+    int32_t blocks[INODE_DATA_BLOCK_NUM];
+} file_t;
+
+static file_t files[BOOT_DENTRY_NUM];
+static uint32_t num_files;
+static uint32_t num_inodes = NUM_INODES;
+static uint32_t num_data_blocks;
+static int image_hashed;                /* the -r image had a hash table */
+
+static int is_file(uint32_t ftype) {
+    return ftype == FTYPE_FILE || ftype == FTYPE_LZ;
+}
+
+static void die(const char* msg, const char* arg) {
+    fprintf(stderr, "createfs: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+    exit(1);
+}
+
+static file_t* add_file(const char* name, uint32_t ftype) {
+    file_t* file;
+    size_t len = strlen(name);
+
+    if (num_files == BOOT_DENTRY_NUM)
+        die("too many files, the boot block holds", "63");
+    file = &files[num_files++];
+    memset(file, 0, sizeof(*file));
+    /* Like the kernel, a 32 character name has no NULL */
+    memcpy(file->dentry.fname, name, len < MAX_FILENAME ? len : MAX_FILENAME);
+    file->dentry.ftype = ftype;
+    return file;
+}
+
+/* Reads a host file's contents into file */
+static void load_file(file_t* file, const char* path) {
+    struct stat st;
+    FILE* f;
+
+    if (stat(path, &st) || !S_ISREG(st.st_mode))
+        die("not a regular file", path);
+    if (st.st_size > (off_t)INODE_DATA_BLOCK_NUM * BLOCK_SIZE)
+        die("file too large for one inode", path);
+
+    free(file->data);
+    file->length = st.st_size;
+    file->stored = st.st_size;
+    file->nblocks = 0;
+    file->data = calloc(1, file->length + 1);
+    if (!file->data || !(f = fopen(path, "rb")))
+        die("cannot read", path);
+    if (fread(file->data, 1, file->length, f) != file->length)
+        die("short read", path);
+    fclose(f);
+}
+
+/* Reads the regular files of dir, in readdir order */
+static void read_dir(const char* dir) {
+    DIR* d;
+    struct dirent* ent;
+    struct stat st;
+    char path[4096];
+
+    if (!(d = opendir(dir)))
+        die("input is not a directory", dir);
+    add_file(".", FTYPE_DIR);
+    add_file("rtc", FTYPE_RTC);
+
+    while ((ent = readdir(d))) {
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+        if (strlen(ent->d_name) > MAX_FILENAME)
+            fprintf(stderr, "createfs: %s: name cut to %d characters\n", ent->d_name, MAX_FILENAME);
+        load_file(add_file(ent->d_name, FTYPE_FILE), path);
+    }
+    closedir(d);
+}
+
+/* Adds path under its base name, or replaces the file of that name */
+static void add_path(const char* path) {
+    const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    uint32_t i;
+
+    for (i = 0; i < num_files; i++) {
+        if (!strncmp((const char*)files[i].dentry.fname, name, MAX_FILENAME)) {
+            if (!is_file(files[i].dentry.ftype))
+                die("cannot replace a device or directory", name);
+            files[i].dentry.ftype = FTYPE_FILE;
+            load_file(&files[i], path);
+            return;
+        }
+    }
+    load_file(add_file(name, FTYPE_FILE), path);
+}
+
+static uint32_t pieces(uint32_t length) {
+    return (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/* Reads an existing image, keeping inode and block numbers */
+static void read_image(const char* path) {
+    FILE* f;
+    uint8_t* img;
+    long size;
+    boot_block_t* boot;
+    int32_t* inode;
+    file_t* file;
+    uint32_t i, j;
+
+    if (!(f = fopen(path, "rb")))
+        die("cannot open", path);
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    if (size < BLOCK_SIZE || !(img = malloc(size)) || fread(img, 1, size, f) != (size_t)size)
+        die("cannot read", path);
+    fclose(f);
+
+    boot = (boot_block_t*)img;
+    image_hashed = (((hash_table_t*)boot->reserved)->magic == FS_HASH_MAGIC);
+    num_inodes = boot->num_inodes;
+    num_data_blocks = boot->num_data_blocks;
+    if (boot->num_dentries > BOOT_DENTRY_NUM ||
+        (uint64_t)(1 + num_inodes + num_data_blocks) * BLOCK_SIZE > (uint64_t)size)
+        die("not a filesystem image", path);
+
+    for (i = 0; i < boot->num_dentries; i++) {
+        file = &files[num_files++];
+        memset(file, 0, sizeof(*file));
+        file->dentry = boot->dentry[i];
+        if (!is_file(file->dentry.ftype))
+            continue;
+        if (file->dentry.inode_num >= num_inodes)
+            die("dentry with a bad inode", path);
+
+        inode = (int32_t*)(img + BLOCK_SIZE * (1 + file->dentry.inode_num));
+        file->length = inode[0];
+        if (file->length > INODE_DATA_BLOCK_NUM * BLOCK_SIZE)
+            die("inode with a bad length", path);
+        file->stored = file->length;
+        /* A compressed file's size is the last end offset, after the table */
+        if (file->dentry.ftype == FTYPE_LZ)
+            file->stored = pieces(file->length) * sizeof(uint32_t);
+        file->data = calloc(1, INODE_DATA_BLOCK_NUM * BLOCK_SIZE + 1);
+        for (j = 0; j * BLOCK_SIZE < file->stored; j++) {
+            if (j == INODE_DATA_BLOCK_NUM)
+                die("compressed file too large", path);
+            file->blocks[j] = inode[1 + j];
+            if ((uint32_t)file->blocks[j] >= num_data_blocks)
+                die("inode with a bad block", path);
+            memcpy(file->data + j * BLOCK_SIZE,
+                   img + BLOCK_SIZE * (1 + num_inodes + file->blocks[j]), BLOCK_SIZE);
+            if (file->dentry.ftype == FTYPE_LZ && file->length &&
+                (j + 1) * BLOCK_SIZE >= pieces(file->length) * sizeof(uint32_t))
+                file->stored = ((uint32_t*)file->data)[pieces(file->length) - 1];
+        }
+        file->nblocks = j;
+    }
+    free(img);
+}
+
+static int compare_names(const void* a, const void* b) {
+    const file_t* fa = a;
+    const file_t* fb = b;
+
+    if (!strcmp((const char*)fa->dentry.fname, "."))
+        return -1;
+    if (!strcmp((const char*)fb->dentry.fname, "."))
+        return 1;
+    return strncmp((const char*)fa->dentry.fname, (const char*)fb->dentry.fname, MAX_FILENAME);
+}
+
+/* Gives the files inodes 0, 1, ... and consecutive blocks in dentry order */
+static void pack(void) {
+    uint32_t i, j, inode = 0;
+
+    num_data_blocks = 0;
+    for (i = 0; i < num_files; i++) {
+        if (!is_file(files[i].dentry.ftype)) {
+            files[i].dentry.inode_num = 0;
+            continue;
+        }
+        if (inode == num_inodes)
+            die("out of inodes", NULL);
+        files[i].dentry.inode_num = inode++;
+        files[i].nblocks = pieces(files[i].stored);
+        for (j = 0; j < files[i].nblocks; j++)
+            files[i].blocks[j] = num_data_blocks++;
+    }
+}
+
+static uint8_t* lz4_put_length(uint8_t* op, uint32_t len) {
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = len;
+    return op;
+}
+
+/* Writes one sequence: the literals from src, then a match unless this
+ * is the last sequence (match_len 0) */
+static uint8_t* lz4_sequence(uint8_t* op, const uint8_t* src, uint32_t lit_len,
+                             uint32_t offset, uint32_t match_len) {
+    uint8_t* token = op++;
+    uint32_t ml = match_len ? match_len - LZ4_MIN_MATCH : 0;
+
+    *token = (lit_len < LZ4_RUN_MASK ? lit_len : LZ4_RUN_MASK) << 4;
+    if (lit_len >= LZ4_RUN_MASK)
+        op = lz4_put_length(op, lit_len - LZ4_RUN_MASK);
+    memcpy(op, src, lit_len);
+    op += lit_len;
+    if (!match_len)
+        return op;
+
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+    *token |= (ml < LZ4_RUN_MASK ? ml : LZ4_RUN_MASK);
+    if (ml >= LZ4_RUN_MASK)
+        op = lz4_put_length(op, ml - LZ4_RUN_MASK);
+    return op;
+}
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Greedy LZ4 block compression of at most one block (so every offset
+ * fits). dst needs room for len + len / 255 + 16 bytes. Returns the
+ * compressed size. */
+static uint32_t lz4_compress(const uint8_t* src, uint32_t len, uint8_t* dst) {
+    uint16_t table[1 << LZ4_HASH_BITS];   /* position + 1 of the last 4 bytes seen */
+    uint8_t* op = dst;
+    uint32_t ip = 0, anchor = 0, ref, match_len, h;
+
+    memset(table, 0, sizeof(table));
+    while (ip + LZ4_MFLIMIT <= len) {
+        h = (read32(src + ip) * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        ref = table[h];
+        table[h] = ip + 1;
+        if (!ref-- || read32(src + ref) != read32(src + ip)) {
+            ip++;
+            continue;
+        }
+        match_len = LZ4_MIN_MATCH;
+        while (ip + match_len < len - LZ4_LAST_LITERALS && src[ref + match_len] == src[ip + match_len])
+            match_len++;
+        op = lz4_sequence(op, src + anchor, ip - anchor, ip - ref, match_len);
+        ip += match_len;
+        anchor = ip;
+    }
+    op = lz4_sequence(op, src + anchor, len - anchor, 0, 0);
+    return op - dst;
+}
+
+/* Replaces the file's data with the compressed stream if that takes
+ * fewer blocks. Pieces that do not shrink are kept as they are. */
+static void compress(file_t* file) {
+    uint32_t n = pieces(file->length);
+    uint32_t i, len, size, packed;
+    uint8_t* stream = calloc(1, n * (sizeof(uint32_t) + 2 * BLOCK_SIZE) + 1);
+    uint8_t piece[2 * BLOCK_SIZE];
+
+    if (!stream)
+        die("out of memory", NULL);
+    size = n * sizeof(uint32_t);
+    for (i = 0; i < n; i++) {
+        len = file->length - i * BLOCK_SIZE;
+        if (len > BLOCK_SIZE)
+            len = BLOCK_SIZE;
+        packed = lz4_compress(file->data + i * BLOCK_SIZE, len, piece);
+        if (packed < len) {
+            memcpy(stream + size, piece, packed);
+            size += packed;
+        } else {
+            memcpy(stream + size, file->data + i * BLOCK_SIZE, len);
+            size += len;
+        }
+        ((uint32_t*)stream)[i] = size;
+    }
+
+    if (pieces(size) >= pieces(file->length)) {
+        free(stream);
+        return;
+    }
+    free(file->data);
+    file->data = stream;
+    file->stored = size;
+    file->dentry.ftype = FTYPE_LZ;
+}
+
+/* FNV-1a over the name, up to MAX_FILENAME characters */
+static uint32_t name_hash(const uint8_t* name) {
+    uint32_t hash = FNV_OFFSET;
+    uint32_t i;
+
+    for (i = 0; i < MAX_FILENAME && name[i] != '\0'; i++)
+        hash = (hash ^ name[i]) * FNV_PRIME;
+    return hash;
+}
+
+/* Chains every dentry into its bucket, in dentry order */
+static void build_hash(boot_block_t* boot) {
+    hash_table_t table;
+    dentry_hash_t link;
+    uint32_t i, bucket;
+    int32_t n;
+
+    memset(&table, 0, sizeof(table));
+    table.magic = FS_HASH_MAGIC;
+    table.buckets = FS_HASH_BUCKETS;
+    for (n = boot->num_dentries - 1; n >= 0; n--) {
+        i = n;
+        link.hash = name_hash(boot->dentry[i].fname);
+        bucket = link.hash % FS_HASH_BUCKETS;
+        link.next = table.head[bucket];
+        table.head[bucket] = i + 1;
+        memset(boot->dentry[i].reserved, 0, DENTRY_RESERVED_BYTES);
+        memcpy(boot->dentry[i].reserved, &link, sizeof(link));
+    }
+    memcpy(boot->reserved, &table, sizeof(table));
+}
+
+static void write_image(const char* path, int hash) {
+    uint64_t size = (uint64_t)(1 + num_inodes + num_data_blocks) * BLOCK_SIZE;
+    uint8_t* img = calloc(1, size);
+    boot_block_t* boot = (boot_block_t*)img;
+    int32_t* inode;
+    uint32_t i, j;
+    FILE* f;
+
+    if (!img)
+        die("out of memory", NULL);
+    boot->num_dentries = num_files;
+    boot->num_inodes = num_inodes;
+    boot->num_data_blocks = num_data_blocks;
+    for (i = 0; i < num_files; i++) {
+        boot->dentry[i] = files[i].dentry;
+        if (!is_file(files[i].dentry.ftype))
+            continue;
+        inode = (int32_t*)(img + BLOCK_SIZE * (1 + files[i].dentry.inode_num));
+        inode[0] = files[i].length;
+        for (j = 0; j < files[i].nblocks; j++) {
+            inode[1 + j] = files[i].blocks[j];
+            memcpy(img + BLOCK_SIZE * (1 + num_inodes + files[i].blocks[j]),
+                   files[i].data + j * BLOCK_SIZE,
+                   (j + 1 < files[i].nblocks) ? BLOCK_SIZE : files[i].stored - j * BLOCK_SIZE);
+        }
+    }
+    if (hash)
+        build_hash(boot);
+
+    if (!(f = fopen(path, "wb")) || fwrite(img, 1, size, f) != size || fclose(f))
+        die("cannot write", path);
+    free(img);
+}
+
+/* One line per file: blocks and runs of consecutive blocks */
+static void report(void) {
+    uint32_t i, j, extents;
+    uint32_t total_blocks = 0, total_extents = 0, regular = 0, contiguous = 0;
+
+    printf("%-32s %6s %7s\n", "file", "blocks", "extents");
+    for (i = 0; i < num_files; i++) {
+        if (!is_file(files[i].dentry.ftype))
+            continue;
+        extents = files[i].nblocks ? 1 : 0;
+        for (j = 1; j < files[i].nblocks; j++)
+            extents += (files[i].blocks[j] != files[i].blocks[j - 1] + 1);
+        printf("%-32.32s %6u %7u%s\n", files[i].dentry.fname, files[i].nblocks, extents,
+               files[i].dentry.ftype == FTYPE_LZ ? "  compressed" : "");
+        regular++;
+        contiguous += (extents <= 1);
+        total_blocks += files[i].nblocks;
+        total_extents += extents;
+    }
+    printf("%u blocks in %u extents, %u of %u files contiguous\n",
+           total_blocks, total_extents, contiguous, regular);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s (-i <dir> | -r <image>) [-a <file>]... [-o <image>] [-c] [-s] [-H] [-z] [-f]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    const char* in_dir = NULL;
+    const char* in_image = NULL;
+    const char* out = NULL;
+    const char* adds[BOOT_DENTRY_NUM];
+    int num_adds = 0;
+    int contiguous = 0, sort = 0, hash = 0, lz = 0, frag = 0;
+    uint32_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:r:a:o:csHzfh")) != -1) {
+        switch (opt) {
+        case 'i': in_dir = optarg; break;
+        case 'r': in_image = optarg; break;
+        case 'a':
+            if (num_adds == BOOT_DENTRY_NUM)
+                usage(argv[0]);
+            adds[num_adds++] = optarg;
+            break;
+        case 'o': out = optarg; break;
+        case 'c': contiguous = 1; break;
+        case 's': sort = 1; break;
+        case 'H': hash = 1; break;
+        case 'z': lz = 1; break;
+        case 'f': frag = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (!in_dir == !in_image || optind != argc)
+        usage(argv[0]);
+
+    if (in_dir) {
+        read_dir(in_dir);
+        contiguous = 1;
+    } else {
+        read_image(in_image);
+    }
+    for (i = 0; i < (uint32_t)num_adds; i++)
+        add_path(adds[i]);
+    /* New contents need new blocks */
+    if (num_adds)
+        contiguous = 1;
+    /* The chains name dentry indices, so a table is rebuilt, never copied */
+    hash |= image_hashed;
+    if (sort)
+        qsort(files, num_files, sizeof(file_t), compare_names);
+    if (lz) {
+        for (i = 0; i < num_files; i++) {
+            if (files[i].dentry.ftype == FTYPE_FILE)
+                compress(&files[i]);
+        }
+        /* The old blocks no longer match the sizes */
+        contiguous = 1;
+    }
+    if (contiguous)
+        pack();
+
+    if (out)
+        write_image(out, hash);
+    if (frag)
+        report();
+    return 0;
+}
@@ -0,0 +1,155 @@
+/* apic.c - Local APIC: IPIs, end of interrupt and the per-CPU timer
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "smp.h"
+#include "pit.h"
+#include "lib.h"
+
+/* Register offsets from lapic_addr, see the Intel SDM vol. 3 ch. 10 */
+#define LAPIC_ID            0x020
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0       // spurious interrupt vector register
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CUR     0x390
+#define LAPIC_TIMER_DIV     0x3E0
+
+#define LAPIC_ID_SHIFT      24
+#define SVR_ENABLE          0x100
+#define ICR_INIT            0x00000500
+#define ICR_STARTUP         0x00000600
+#define ICR_LEVEL_ASSERT    0x00004000
+#define ICR_PENDING         0x00001000  // delivery status, set until the IPI is accepted
+#define ICR_SPIN_MAX        100000
+#define LVT_MASKED          0x00010000
+#define LVT_PERIODIC        0x00020000
+#define TIMER_DIV_16        0x3
+#define TIMER_COUNT_MAX     0xFFFFFFFF
+#define INIT_WAIT_TICKS     2           // >= 10ms between INIT and startup at PIT_HZ
+
+uint32_t lapic_addr = LAPIC_DEFAULT_ADDR;
+uint32_t lapic_timer_count = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_addr + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(lapic_addr + reg) = value;
+}
+
+/* uint32_t lapic_id(void);
+ * Inputs: none
+ * Return Value: APIC ID of the calling CPU
+ * Function: reads it from the CPU's own local APIC */
+uint32_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/* void lapic_enable(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: sets the software enable bit and the spurious vector. The
+ *           timer stays masked until lapic_timer_start. */
+void lapic_enable(void) {
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC_NUM);
+}
+
+/* void lapic_eoi(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: any write to the EOI register ends the in-service interrupt */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* static int32_t lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+ * Inputs: apic_id - destination CPU
+ *         icr - low word of the interrupt command register
+ * Return Value: 0 once the APIC accepted the IPI, -1 if it never did
+ * Function: writes the destination first, the low word sends the IPI */
+static int32_t lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    uint32_t i;
+
+    lapic_write(LAPIC_ICR_HIGH, apic_id << LAPIC_ID_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    for (i = 0; i < ICR_SPIN_MAX; i++) {
+        if (!(lapic_read(LAPIC_ICR_LOW) & ICR_PENDING))
+            return 0;
+        asm volatile ("pause");
+    }
+    return -1;
+}
+
+/* static void pit_wait(uint32_t ticks);
+ * Inputs: ticks - whole PIT ticks to let pass
+ * Return Value: none
+ * Function: busy waits, the wait starts at the next tick edge */
+static void pit_wait(uint32_t ticks) {
+    uint32_t start = pit_ticks;
+
+    while (pit_ticks - start <= ticks)
+        asm volatile ("pause");
+}
+
+/* int32_t lapic_start_ap(uint32_t apic_id, uint32_t vector);
+ * Inputs: apic_id - CPU to start
+ *         vector - page number of its real mode entry point
+ * Return Value: 0 on success, -1 if an IPI was not accepted
+ * Function: INIT puts the CPU in wait-for-SIPI state, the startup IPI then
+ *           starts it in real mode at vector:0000 */
+int32_t lapic_start_ap(uint32_t apic_id, uint32_t vector) {
+    if (lapic_send_ipi(apic_id, ICR_INIT | ICR_LEVEL_ASSERT))
+        return -1;
+    pit_wait(INIT_WAIT_TICKS);
+    return lapic_sipi(apic_id, vector);
+}
+
+/* int32_t lapic_sipi(uint32_t apic_id, uint32_t vector);
+ * Inputs: apic_id - CPU to start
+ *         vector - page number of its real mode entry point
+ * Return Value: 0 on success, -1 if the IPI was not accepted
+ * Function: a CPU that is already running ignores it */
+int32_t lapic_sipi(uint32_t apic_id, uint32_t vector) {
+    return lapic_send_ipi(apic_id, ICR_STARTUP | ICR_LEVEL_ASSERT | vector);
+}
+
+/* void lapic_timer_calibrate(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: lets the bootstrap processor's timer count down for one PIT
+ *           tick with the timer interrupt masked */
+void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC_NUM);
+    pit_wait(0);
+    lapic_write(LAPIC_TIMER_INIT, TIMER_COUNT_MAX);
+    pit_wait(0);
+    lapic_timer_count = TIMER_COUNT_MAX - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+}
+
+/* void lapic_timer_start(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: periodic mode at the calibrated count. All CPUs share a bus
+ *           clock, so the bootstrap processor's count holds for each. */
+void lapic_timer_start(void) {
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC_NUM);
+    lapic_write(LAPIC_TIMER_INIT, lapic_timer_count);
+}
+
+/* void lapic_timer_handler(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: counts the tick on the CPU it arrived on */
+void lapic_timer_handler(void) {
+    ++smp_this_cpu()->ticks;
+    lapic_eoi();
+}
@@ -0,0 +1,50 @@
+/* apic.h - Local APIC: IPIs, end of interrupt and the per-CPU timer
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#define LAPIC_TIMER_VEC_NUM     0x40    // local APIC timer of the application processors
+#define LAPIC_SPURIOUS_VEC_NUM  0xFF    // low nibble must be all ones on older APICs
+
+#ifndef ASM
+
+#include "types.h"
+
+#define LAPIC_DEFAULT_ADDR  0xFEE00000  // where every local APIC sits unless the MP table says otherwise
+
+/* Physical (and, through the APIC window in paging.c, virtual) address of
+ * the local APIC registers. Every CPU sees its own APIC at this address. */
+extern uint32_t lapic_addr;
+
+/* Timer counts per PIT tick, measured once on the bootstrap processor */
+extern uint32_t lapic_timer_count;
+
+/* APIC ID of the CPU this runs on */
+uint32_t lapic_id(void);
+
+/* Software-enables this CPU's local APIC */
+void lapic_enable(void);
+
+/* Acknowledges the interrupt this CPU's local APIC is delivering */
+void lapic_eoi(void);
+
+/* Sends an INIT IPI followed by a startup IPI that begins execution at
+ * the 4kB page vector names. Returns -1 if the APIC never accepted it. */
+int32_t lapic_start_ap(uint32_t apic_id, uint32_t vector);
+
+/* Resends only the startup IPI, the second one the MP spec asks for */
+int32_t lapic_sipi(uint32_t apic_id, uint32_t vector);
+
+/* Measures lapic_timer_count against the PIT. Needs interrupts on. */
+void lapic_timer_calibrate(void);
+
+/* Starts this CPU's timer, one interrupt per PIT tick's length */
+void lapic_timer_start(void);
+
+/* Counts the tick for this CPU, called from LAPIC_TIMER_WRAPPER */
+void lapic_timer_handler(void);
+
+#endif /* ASM */
+#endif /* _APIC_H */
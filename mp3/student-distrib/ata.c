@@ -0,0 +1,163 @@
+/* ata.c - ATA disk on the primary IDE channel, PIO only
+ * vim:ts=4 noexpandtab
+ *
+ * Only the master drive on the primary channel (QEMU's -hda) is used,
+ * with 28 bit LBA. Nothing in the kernel writes to the disk.
+ */
+
+#include "ata.h"
+#include "lib.h"
+
+#define ATA_IO              0x1F0
+#define ATA_CTRL            0x3F6       // device control on write, alternate status on read
+
+/* Register offsets from ATA_IO */
+#define ATA_DATA            0
+#define ATA_ERROR           1
+#define ATA_COUNT           2
+#define ATA_LBA_LO          3
+#define ATA_LBA_MID         4
+#define ATA_LBA_HI          5
+#define ATA_DRIVE           6
+#define ATA_STATUS          7           // command on write
+
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_IDENTIFY    0xEC
+
+#define ATA_SR_ERR          0x01
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_DF           0x20
+#define ATA_SR_BSY          0x80
+#define ATA_FLOATING        0xFF        // status with no drive on the channel
+
+#define ATA_DRIVE_LBA       0xE0        // master, LBA addressing, high LBA bits below
+#define ATA_DRIVE_MASTER    0xA0
+#define ATA_CTRL_NIEN       0x02        // no interrupts from the drive
+#define ATA_LBA28_MAX       0x10000000
+#define ATA_ID_WORDS        256
+#define ATA_ID_SECTORS      60          // words 60-61, sectors reachable with LBA28
+#define ATA_TIMEOUT         1000000     // status polls before giving up
+
+uint32_t ata_present = 0;
+uint32_t ata_sectors = 0;
+
+/* static void ata_delay(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: The status register is only right 400ns after a command or
+ *           drive select. Each alternate status read takes about 100ns. */
+static void ata_delay(void) {
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+}
+
+/* static int32_t ata_wait(uint32_t want);
+ * Inputs: want - status bits that must be set once BSY clears, 0 for none
+ * Return Value: 0 when ready, -1 on an error bit or a timeout */
+static int32_t ata_wait(uint32_t want) {
+    uint32_t status, i;
+
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_IO + ATA_STATUS);
+        if (status & ATA_SR_BSY)
+            continue;
+        if (status & (ATA_SR_ERR | ATA_SR_DF))
+            return -1;
+        if ((status & want) == want)
+            return 0;
+    }
+    return -1;
+}
+
+/* static void ata_command(uint32_t lba, uint32_t count, uint8_t cmd);
+ * Inputs: lba - first sector
+ *         count - sectors, 1 to 256
+ *         cmd - ATA command
+ * Return Value: none */
+static void ata_command(uint32_t lba, uint32_t count, uint8_t cmd) {
+    outb(ATA_DRIVE_LBA | ((lba >> 24) & 0x0F), ATA_IO + ATA_DRIVE);
+    ata_delay();
+    outb(count & 0xFF, ATA_IO + ATA_COUNT);
+    outb(lba & 0xFF, ATA_IO + ATA_LBA_LO);
+    outb((lba >> 8) & 0xFF, ATA_IO + ATA_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_IO + ATA_LBA_HI);
+    outb(cmd, ATA_IO + ATA_STATUS);
+    ata_delay();
+}
+
+/* static void ata_read_words(uint16_t* buf, uint32_t n);
+ * Inputs: buf - destination
+ *         n - 16 bit words to take from the data register
+ * Return Value: none */
+static void ata_read_words(uint16_t* buf, uint32_t n) {
+    asm volatile ("rep insw"
+            : "+D"(buf), "+c"(n)
+            : "d"(ATA_IO + ATA_DATA)
+            : "memory"
+    );
+}
+
+/* void ata_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: IDENTIFY answers with status 0 if there is no drive, and
+ *           ATAPI and SATA devices set the LBA mid/high registers. */
+void ata_init(void) {
+    uint16_t id[ATA_ID_WORDS];
+
+    if (inb(ATA_IO + ATA_STATUS) == ATA_FLOATING)
+        return;
+    outb(ATA_CTRL_NIEN, ATA_CTRL);
+
+    outb(ATA_DRIVE_MASTER, ATA_IO + ATA_DRIVE);
+    ata_delay();
+    outb(0, ATA_IO + ATA_COUNT);
+    outb(0, ATA_IO + ATA_LBA_LO);
+    outb(0, ATA_IO + ATA_LBA_MID);
+    outb(0, ATA_IO + ATA_LBA_HI);
+    outb(ATA_CMD_IDENTIFY, ATA_IO + ATA_STATUS);
+    ata_delay();
+    if (inb(ATA_IO + ATA_STATUS) == 0)
+        return;
+    if (ata_wait(0) == -1 || inb(ATA_IO + ATA_LBA_MID) || inb(ATA_IO + ATA_LBA_HI))
+        return;
+    if (ata_wait(ATA_SR_DRQ) == -1)
+        return;
+    ata_read_words(id, ATA_ID_WORDS);
+
+    ata_sectors = id[ATA_ID_SECTORS] | (id[ATA_ID_SECTORS + 1] << 16);
+    if (ata_sectors == 0)
+        return;
+    ata_present = 1;
+}
+
+/* static int32_t ata_read_pio(uint32_t lba, uint32_t count, uint8_t* buf);
+ * Inputs: as ata_read
+ * Return Value: 0, -1 on an error
+ * Function: the drive raises DRQ once per sector */
+static int32_t ata_read_pio(uint32_t lba, uint32_t count, uint8_t* buf) {
+    uint32_t i;
+
+    ata_command(lba, count, ATA_CMD_READ_PIO);
+    for (i = 0; i < count; i++) {
+        if (ata_wait(ATA_SR_DRQ) == -1)
+            return -1;
+        ata_read_words((uint16_t*)(buf + i * ATA_SECTOR_SIZE), ATA_SECTOR_SIZE / 2);
+        ata_delay();
+    }
+    return 0;
+}
+
+/* int32_t ata_read(uint32_t lba, uint32_t count, void* buf);
+ * Inputs: lba - first sector
+ *         count - sectors to read, at most ATA_MAX_SECTORS
+ *         buf - destination, count * ATA_SECTOR_SIZE bytes
+ * Return Value: 0, -1 on an error */
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf) {
+    if (!ata_present || count == 0 || count > ATA_MAX_SECTORS ||
+        lba >= ata_sectors || count > ata_sectors - lba || lba + count > ATA_LBA28_MAX)
+        return -1;
+    return ata_read_pio(lba, count, buf);
+}
@@ -0,0 +1,25 @@
+/* ata.h - ATA disk on the primary IDE channel, PIO only
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+
+#define ATA_SECTOR_SIZE     512
+#define ATA_MAX_SECTORS     128         // most sectors one ata_read call takes (64kB)
+
+/* Nonzero once ata_init found a disk, and its size in sectors */
+extern uint32_t ata_present;
+extern uint32_t ata_sectors;
+
+/* Looks for the master drive on the primary channel with IDENTIFY. The
+ * drive's interrupt is left off, reads poll for completion. */
+void ata_init(void);
+
+/* Reads count sectors from lba into buf by PIO. Returns 0, or -1 on a
+ * drive error, a timeout or a request past the end of the disk. */
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf);
+
+#endif /* _ATA_H */
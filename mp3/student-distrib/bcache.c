@@ -0,0 +1,90 @@
+/* bcache.c - LRU cache of 4kB blocks read from the disk
+ * vim:ts=4 noexpandtab
+ *
+ * The file system asks for one block at a time: an inode, then the data
+ * blocks it names. Like the page cache, entries carry the time of their
+ * last use and a miss replaces the oldest, so a file read in a loop stays
+ * in memory while a large one passing through only pushes out blocks
+ * nobody has used since.
+ */
+
+#include "bcache.h"
+#include "ata.h"
+#include "lib.h"
+
+#define BCACHE_EMPTY        0xFFFFFFFF
+#define SECTORS_PER_BLOCK   (BCACHE_BLOCK_SIZE / ATA_SECTOR_SIZE)
+
+typedef struct bcache_entry {
+    uint32_t block;                 // BCACHE_EMPTY when the entry is unused
+    uint32_t last_use;
+} bcache_entry_t;
+
+static bcache_entry_t bcache[BCACHE_SIZE];
+static uint8_t bcache_data[BCACHE_SIZE][BCACHE_BLOCK_SIZE] __attribute__((aligned(BCACHE_BLOCK_SIZE)));
+static uint32_t bcache_clock;       // ordering for last_use
+static uint32_t bcache_hits, bcache_misses, bcache_errors;
+static uint32_t bcache_read_cycles; // time spent in ata_read
+
+/* void bcache_flush(void);
+ * Inputs: none
+ * Return Value: none */
+void bcache_flush(void) {
+    uint32_t i;
+
+    for (i = 0; i < BCACHE_SIZE; i++)
+        bcache[i].block = BCACHE_EMPTY;
+}
+
+/* uint8_t* bcache_get(uint32_t block);
+ * Inputs: block - disk block number
+ * Return Value: the block's contents, NULL if it could not be read
+ * Function: Looks the block up, taking note of the least recently used
+ *           entry on the way, and reads it into that entry on a miss.
+ *           Callers are system calls and program loading, which the
+ *           timer does not preempt, so there is no lock. */
+uint8_t* bcache_get(uint32_t block) {
+    bcache_entry_t* victim = &bcache[0];
+    uint32_t i, start;
+
+    for (i = 0; i < BCACHE_SIZE; i++) {
+        if (bcache[i].block == block) {
+            bcache[i].last_use = ++bcache_clock;
+            bcache_hits++;
+            return bcache_data[i];
+        }
+        if (bcache[i].block == BCACHE_EMPTY ||
+            (victim->block != BCACHE_EMPTY && bcache[i].last_use < victim->last_use))
+            victim = &bcache[i];
+    }
+
+    bcache_misses++;
+    i = victim - bcache;
+    victim->block = BCACHE_EMPTY;
+    start = rdtsc();
+    if (ata_read(block * SECTORS_PER_BLOCK, SECTORS_PER_BLOCK, bcache_data[i]) == -1) {
+        bcache_errors++;
+        return NULL;
+    }
+    bcache_read_cycles += rdtsc() - start;
+    victim->block = block;
+    victim->last_use = ++bcache_clock;
+    return bcache_data[i];
+}
+
+/* int32_t diskstat_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written */
+int32_t diskstat_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+
+    len += snprintf(buf + len, size - len, "disk:   %s, %u sectors\n",
+                    ata_present ? "ata0" : "none", ata_sectors);
+    len += snprintf(buf + len, size - len, "bcache: %u blocks, %u hits, %u misses, %u errors\n",
+                    BCACHE_SIZE, bcache_hits, bcache_misses, bcache_errors);
+    len += snprintf(buf + len, size - len, "read:   %u cycles per miss\n",
+                    bcache_misses > bcache_errors ?
+                    bcache_read_cycles / (bcache_misses - bcache_errors) : 0);
+    return len;
+}
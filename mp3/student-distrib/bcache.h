@@ -0,0 +1,24 @@
+/* bcache.h - LRU cache of 4kB blocks read from the disk
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "types.h"
+
+#define BCACHE_SIZE         32          // blocks kept
+#define BCACHE_BLOCK_SIZE   4096
+
+/* Returns the contents of disk block n (at byte n * BCACHE_BLOCK_SIZE),
+ * reading it on a miss. The pointer stays good until BCACHE_SIZE - 1
+ * other blocks have been asked for. NULL on a disk error. */
+uint8_t* bcache_get(uint32_t block);
+
+/* Forgets every block, the next gets all go to the disk */
+void bcache_flush(void);
+
+/* Text for the "diskstat" pseudo file */
+int32_t diskstat_show(int8_t* buf, int32_t size);
+
+#endif /* _BCACHE_H */
@@ -0,0 +1,135 @@
+/* bootprof.c - Time stamps for each stage of the boot
+ * vim:ts=4 noexpandtab
+ *
+ * Stamps are full 64 bit TSC values: the boot loader alone can take more
+ * than the 32 bits rdtsc keeps. Turning them into microseconds needs the
+ * TSC rate, which is measured against the PIT the first time anything
+ * asks, so the boot itself never waits for it.
+ */
+
+#include "bootprof.h"
+#include "lib.h"
+#include "pit.h"
+#include "spinlock.h"
+#include "ktest.h"
+
+#define US_PER_TICK     (1000000 / PIT_HZ)
+#define US_UNKNOWN      0xFFFFFFFF
+
+typedef struct bootprof_stamp {
+    const int8_t* stage;
+    uint64_t tsc;
+} bootprof_stamp_t;
+
+static bootprof_stamp_t stamps[BOOTPROF_MAX_STAGES];
+static uint32_t num_stamps;
+static uint32_t cycles_per_us;      // 0 until bootprof_calibrate
+
+/* void bootprof_mark(const int8_t* stage);
+ * Inputs: stage - name of the stage that just ended
+ * Return Value: none */
+void bootprof_mark(const int8_t* stage) {
+    if (num_stamps == BOOTPROF_MAX_STAGES)
+        return;
+    stamps[num_stamps].stage = stage;
+    stamps[num_stamps].tsc = rdtsc64();
+    num_stamps++;
+}
+
+/* static void bootprof_calibrate(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: counts TSC cycles from one PIT tick to the next, 10ms at most
+ *           twice. Needs interrupts on and is skipped otherwise. */
+static void bootprof_calibrate(void) {
+    uint32_t flags, ticks, start;
+
+    if (cycles_per_us != 0)
+        return;
+    cli_and_save(flags);
+    restore_flags(flags);
+    if (!(flags & EFLAGS_IF))
+        return;
+
+    ticks = pit_ticks;
+    while (pit_ticks == ticks)
+        asm volatile ("pause");
+    start = rdtsc();
+    ticks = pit_ticks;
+    while (pit_ticks == ticks)
+        asm volatile ("pause");
+    cycles_per_us = (rdtsc() - start) / US_PER_TICK;
+}
+
+/* static uint32_t bootprof_us(uint64_t cycles);
+ * Inputs: cycles - a TSC difference
+ * Return Value: the same span in microseconds, US_UNKNOWN if the TSC rate
+ *               is not known or the result would not fit
+ * Function: divides with divl, which takes a 64 bit dividend, since there
+ *           is no libgcc for a 64 bit division */
+static uint32_t bootprof_us(uint64_t cycles) {
+    uint32_t high = cycles >> 32;
+    uint32_t low = cycles;
+    uint32_t us, rem;
+
+    if (cycles_per_us == 0 || high >= cycles_per_us)
+        return US_UNKNOWN;
+    asm ("divl %4"
+            : "=a"(us), "=d"(rem)
+            : "a"(low), "d"(high), "rm"(cycles_per_us)
+    );
+    return us;
+}
+
+/* static uint32_t bootprof_cycles(uint32_t i);
+ * Inputs: i - stamp index, at least 1
+ * Return Value: cycles the stage took, at most 0xFFFFFFFF */
+static uint32_t bootprof_cycles(uint32_t i) {
+    uint64_t cycles = stamps[i].tsc - stamps[i - 1].tsc;
+
+    return (cycles >> 32) ? 0xFFFFFFFF : (uint32_t)cycles;
+}
+
+/* int32_t bootprof_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written */
+int32_t bootprof_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t i, us;
+
+    if (num_stamps == 0)
+        return 0;
+    bootprof_calibrate();
+
+    //Without the TSC rate only the cycle counts are shown
+    if (cycles_per_us == 0) {
+        len += snprintf(buf + len, size - len, "tsc:    rate unknown\n");
+    } else {
+        len += snprintf(buf + len, size - len, "tsc:    %u cycles per us\n", cycles_per_us);
+        len += snprintf(buf + len, size - len, "loader: %u us before entry\n",
+                        bootprof_us(stamps[0].tsc));
+    }
+    len += snprintf(buf + len, size - len, "%-18s%-12s%s\n", "stage", "cycles", "us since entry");
+    for (i = 1; i < num_stamps; i++) {
+        us = bootprof_us(stamps[i].tsc - stamps[0].tsc);
+        if (us == US_UNKNOWN)
+            len += snprintf(buf + len, size - len, "%-18s%u\n", stamps[i].stage, bootprof_cycles(i));
+        else
+            len += snprintf(buf + len, size - len, "%-18s%-12u%u\n", stamps[i].stage,
+                            bootprof_cycles(i), us);
+    }
+    return len;
+}
+
+/* void bootprof_report(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: one line per stage after the first, see ktest_boot */
+void bootprof_report(void) {
+    uint32_t i;
+
+    bootprof_calibrate();
+    for (i = 1; i < num_stamps; i++)
+        ktest_boot(stamps[i].stage, bootprof_cycles(i), bootprof_us(stamps[i].tsc - stamps[0].tsc));
+}
@@ -0,0 +1,24 @@
+/* bootprof.h - Time stamps for each stage of the boot
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BOOTPROF_H
+#define _BOOTPROF_H
+
+#include "types.h"
+
+#define BOOTPROF_MAX_STAGES 24
+
+/* Records the end of a boot stage. The first call, at the top of entry(),
+ * also notes how long the firmware and boot loader took. stage must stay
+ * valid, a string literal. Stamps past BOOTPROF_MAX_STAGES are dropped. */
+void bootprof_mark(const int8_t* stage);
+
+/* Text for the "bootprof" pseudo file: each stage's cycles and the time
+ * from entry() to its end */
+int32_t bootprof_show(int8_t* buf, int32_t size);
+
+/* Sends every stage to the ktest log as a "boot" line */
+void bootprof_report(void);
+
+#endif /* _BOOTPROF_H */
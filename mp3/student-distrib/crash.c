@@ -0,0 +1,48 @@
+/* crash.c - Ring of recent exceptions that killed a process
+ * vim:ts=4 noexpandtab
+ */
+
+#include "crash.h"
+#include "lib.h"
+#include "smp.h"
+
+static crash_rec_t crash_ring[CRASH_RING_SIZE];
+static uint32_t crash_total;        // records ever written, next slot is this mod the size
+
+/* void crash_record(uint32_t vec, uint32_t eip, uint32_t error);
+ * Inputs: vec - exception number
+ *         eip - instruction that faulted
+ *         error - error code pushed by the CPU, or 0
+ * Return Value: none
+ * Function: overwrites the oldest record. Exceptions run with interrupts
+ *           off, so nothing else writes the ring at the same time. */
+void crash_record(uint32_t vec, uint32_t eip, uint32_t error) {
+    crash_rec_t* rec = &crash_ring[crash_total % CRASH_RING_SIZE];
+
+    rec->pid = cur_pid;
+    rec->vec = vec;
+    rec->eip = eip;
+    asm volatile("movl %%cr2, %0" : "=r"(rec->cr2));
+    rec->error = error;
+    ++crash_total;
+}
+
+/* int32_t crashlog_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written
+ * Function: one line per record, oldest first */
+int32_t crashlog_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t i;
+    uint32_t first = (crash_total > CRASH_RING_SIZE) ? crash_total - CRASH_RING_SIZE : 0;
+    crash_rec_t* rec;
+
+    len += snprintf(buf + len, size - len, "pid vec eip      cr2      error\n");
+    for (i = first; i < crash_total; i++) {
+        rec = &crash_ring[i % CRASH_RING_SIZE];
+        len += snprintf(buf + len, size - len, "%-3u %-3u %08x %08x %x\n",
+                        rec->pid, rec->vec, rec->eip, rec->cr2, rec->error);
+    }
+    return len;
+}
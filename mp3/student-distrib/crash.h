@@ -0,0 +1,28 @@
+/* crash.h - Ring of recent exceptions that killed a process
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _CRASH_H
+#define _CRASH_H
+
+#include "types.h"
+
+#define CRASH_RING_SIZE     16
+
+typedef struct crash_rec {
+    uint32_t pid;
+    uint32_t vec;           // exception number
+    uint32_t eip;
+    uint32_t cr2;           // faulting address of a page fault
+    uint32_t error;         // error code, 0 for exceptions without one
+} crash_rec_t;
+
+/* Records an exception of the running process. Cheap enough for the
+ * fault path: a few stores, no output. */
+void crash_record(uint32_t vec, uint32_t eip, uint32_t error);
+
+/* Writes the ring as text into buf, oldest first, for the crashlog
+ * pseudo file */
+int32_t crashlog_show(int8_t* buf, int32_t size);
+
+#endif /* _CRASH_H */
@@ -0,0 +1,146 @@
+/* elf.c - ELF32 program loader
+ * vim:ts=4 noexpandtab
+ *
+ * Programs are linked to run in the 4MB user page at 128MB. Each PT_LOAD
+ * segment gets its own 4KB pages. Read-only segments (text) come from the
+ * page cache and are shared by every process running the program. Data is
+ * copied into private pages. Pages that hold only bss, and the stack above
+ * the image, are mapped on the first fault and zero filled then.
+ */
+
+#include "elf.h"
+#include "fs_driver.h"
+#include "paging.h"
+#include "page_cache.h"
+#include "lib.h"
+
+/* int32_t elf_read(uint32_t inode, elf_image_t* image);
+ * Inputs: inode = inode of the file to run
+ *         image = filled in with the file's headers
+ * Return Value: 0 if the file is a program we can run, -1 otherwise
+ * Function: Reads the file and program headers and validates them. Runs
+ *           before execute commits to anything. */
+int32_t elf_read(uint32_t inode, elf_image_t* image) {
+    inode_t* inode_block;
+    uint32_t phdrs_size;
+
+    inode_block = fs_inode(inode);
+    if (inode_block == NULL)
+        return -1;
+    image->inode = inode;
+    image->length = inode_block->length;
+    if (image->length < sizeof(elf_hdr_t))
+        return -1;
+    if (read_data(inode, 0, (uint8_t*)&image->hdr, sizeof(elf_hdr_t)) != sizeof(elf_hdr_t))
+        return -1;
+
+    /* Enough of the header to read the program headers safely */
+    if (strncmp((int8_t*)image->hdr.ident, ELF_MAGIC, ELF_MAGIC_LEN) != 0 ||
+        image->hdr.phentsize != sizeof(elf_phdr_t) ||
+        image->hdr.phnum == 0 || image->hdr.phnum > ELF_MAX_PHDRS)
+        return -1;
+
+    phdrs_size = image->hdr.phnum * sizeof(elf_phdr_t);
+    if (image->hdr.phoff > image->length || phdrs_size > image->length - image->hdr.phoff)
+        return -1;
+    if (read_data(inode, image->hdr.phoff, (uint8_t*)image->phdrs, phdrs_size) != phdrs_size)
+        return -1;
+
+    return elf_validate(image);
+}
+
+/* int32_t elf_validate(const elf_image_t* image);
+ * Inputs: image = headers read from the file
+ * Return Value: 0 if the program can be loaded, -1 otherwise
+ * Function: Checks that this is a 32-bit little endian i386 executable, that
+ *           every loadable segment lies inside the file and inside the user
+ *           page with room left for the stack, and that the entry point is
+ *           in an executable segment */
+int32_t elf_validate(const elf_image_t* image) {
+    const elf_hdr_t* hdr = &image->hdr;
+    const elf_phdr_t* ph;
+    uint32_t user_end = USER_MEM + PAGE_4MB - USER_STACK_MIN;
+    int32_t entry_ok = 0;
+    int32_t loads = 0;
+    uint32_t i;
+
+    if (strncmp((int8_t*)hdr->ident, ELF_MAGIC, ELF_MAGIC_LEN) != 0 ||
+        hdr->ident[EI_CLASS] != ELFCLASS32 || hdr->ident[EI_DATA] != ELFDATA2LSB ||
+        hdr->type != ET_EXEC || hdr->machine != EM_386 || hdr->version != EV_CURRENT ||
+        hdr->phentsize != sizeof(elf_phdr_t) ||
+        hdr->phnum == 0 || hdr->phnum > ELF_MAX_PHDRS)
+        return -1;
+
+    for (i = 0; i < hdr->phnum; i++) {
+        ph = &image->phdrs[i];
+        if (ph->type != PT_LOAD)
+            continue;
+
+        if (ph->filesz > ph->memsz)
+            return -1;
+        if (ph->offset > image->length || ph->filesz > image->length - ph->offset)
+            return -1;
+        if (ph->vaddr < USER_MEM || ph->vaddr >= user_end || ph->memsz > user_end - ph->vaddr)
+            return -1;
+
+        if ((ph->flags & PF_X) && hdr->entry >= ph->vaddr && hdr->entry - ph->vaddr < ph->filesz)
+            entry_ok = 1;
+        loads++;
+    }
+
+    if (loads == 0 || !entry_ok)
+        return -1;
+    return 0;
+}
+
+/* int32_t elf_load(const elf_image_t* image, uint32_t pid);
+ * Inputs: image = headers that passed elf_validate
+ *         pid = process being loaded, whose page table is the active one
+ * Return Value: 0, -1 if a page could not be had or the file not read. The
+ *               pages mapped so far stay for user_paging_reset to free.
+ * Function: Maps each segment with its own permissions. Read-only pages are
+ *           shared through the page cache, writable ones get the file bytes
+ *           copied in. Pages past the file bytes and the stack are left to
+ *           be zero filled when first touched. */
+int32_t elf_load(const elf_image_t* image, uint32_t pid) {
+    const elf_phdr_t* ph;
+    uint32_t file_end;
+    uint32_t mem_end;
+    uint32_t image_end = USER_MEM;
+    uint32_t vaddr;
+    uint32_t ppn;
+    uint32_t i;
+
+    user_paging_reset(pid);
+
+    for (i = 0; i < image->hdr.phnum; i++) {
+        ph = &image->phdrs[i];
+        if (ph->type != PT_LOAD)
+            continue;
+
+        file_end = ph->vaddr + ph->filesz;
+        mem_end = ph->vaddr + ph->memsz;
+
+        if (!(ph->flags & PF_W)) {
+            for (vaddr = ph->vaddr & ~(ALIGN_4KB - 1); vaddr < mem_end; vaddr += ALIGN_4KB) {
+                ppn = page_cache_get(image, ph, vaddr);
+                if (ppn == 0)
+                    return -1;
+                user_map_frame(pid, vaddr, ppn);
+            }
+        } else {
+            /* Pages holding file bytes now, whole bss pages on demand */
+            if (user_map_range(pid, ph->vaddr, file_end, USER_MAP_WRITE) == -1 ||
+                user_map_range(pid, file_end, mem_end, USER_MAP_WRITE | USER_MAP_LAZY) == -1)
+                return -1;
+            if (read_data(image->inode, ph->offset, (uint8_t*)ph->vaddr, ph->filesz) != (int32_t)ph->filesz)
+                return -1;
+        }
+
+        if (mem_end > image_end)
+            image_end = mem_end;
+    }
+
+    /* Everything above the image is stack, as before */
+    return user_map_range(pid, image_end, USER_MEM + PAGE_4MB, USER_MAP_WRITE | USER_MAP_LAZY);
+}
@@ -0,0 +1,77 @@
+/* elf.h - ELF32 program loader
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+
+#define ELF_MAGIC       "\177ELF"
+#define ELF_MAGIC_LEN   4
+
+#define EI_NIDENT       16
+#define EI_CLASS        4
+#define EI_DATA         5
+#define ELFCLASS32      1
+#define ELFDATA2LSB     1
+#define ET_EXEC         2
+#define EM_386          3
+#define EV_CURRENT      1
+
+#define PT_LOAD         1
+#define PF_X            0x1
+#define PF_W            0x2
+
+#define ELF_MAX_PHDRS   8       // more than any of our programs use
+#define USER_STACK_MIN  0x1000  // user page space kept free for the stack
+
+/* ELF file header */
+typedef struct __attribute__((packed)) elf_hdr {
+    uint8_t  ident[EI_NIDENT];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} elf_hdr_t;
+
+/* ELF program header */
+typedef struct __attribute__((packed)) elf_phdr {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} elf_phdr_t;
+
+/* Everything execute needs to know about a program before loading it */
+typedef struct elf_image {
+    uint32_t inode;
+    uint32_t length;                    // file size in bytes
+    elf_hdr_t hdr;
+    elf_phdr_t phdrs[ELF_MAX_PHDRS];
+} elf_image_t;
+
+/* Reads and checks the headers of an executable */
+int32_t elf_read(uint32_t inode, elf_image_t* image);
+
+/* Checks headers already in image against the file length */
+int32_t elf_validate(const elf_image_t* image);
+
+/* Maps and loads the segments into the current user address space, -1
+ * if memory ran out or the file could not be read */
+int32_t elf_load(const elf_image_t* image, uint32_t pid);
+
+#endif /* _ELF_H */
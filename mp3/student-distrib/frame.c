@@ -0,0 +1,148 @@
+/* frame.c - Physical page frames for user memory
+ * vim:ts=4 noexpandtab
+ *
+ * Frames are only taken and released from process context (execute, halt
+ * and page faults), never from interrupt handlers, so no locking is needed
+ * on this single CPU kernel.
+ */
+
+#include "frame.h"
+#include "page_cache.h"
+#include "lib.h"
+
+extern uint32_t pid_array[];
+
+/* Reference count of every frame in the pool, 0 when free */
+static uint16_t frame_ref[NUM_FRAMES_MAX];
+static uint32_t frames_total = (FRAME_POOL_DEFAULT_END - FRAME_POOL_START) / ALIGN_4KB;
+static uint32_t frame_first_ppn = FRAME_POOL_START / ALIGN_4KB;
+static uint32_t frames_used;
+static uint32_t frame_next;         // where the next search starts
+
+/* static uint32_t frame_index(uint32_t ppn);
+ * Inputs: ppn = physical page number of a pool frame
+ * Return Value: index of the frame in frame_ref */
+static uint32_t frame_index(uint32_t ppn) {
+    return ppn - frame_first_ppn;
+}
+
+/* void frame_init(uint32_t mem_end, uint32_t reserved_end);
+ * Inputs: mem_end = physical end of RAM, 0 if the boot loader did not say
+ *         reserved_end = end of the boot modules, which must be kept
+ * Return Value: none
+ * Function: Sets the pool to the memory between the kernel page and the end
+ *           of RAM, capped at FRAME_POOL_MAX_END. Runs before any frame is
+ *           taken. */
+void frame_init(uint32_t mem_end, uint32_t reserved_end) {
+    uint32_t start = FRAME_POOL_START;
+
+    if (mem_end == 0)
+        mem_end = FRAME_POOL_DEFAULT_END;
+    if (mem_end > FRAME_POOL_MAX_END)
+        mem_end = FRAME_POOL_MAX_END;
+    if (reserved_end > start)
+        start = (reserved_end + ALIGN_4KB - 1) & ~(ALIGN_4KB - 1);
+
+    frame_first_ppn = start / ALIGN_4KB;
+    frames_total = (mem_end > start) ? (mem_end - start) / ALIGN_4KB : 0;
+}
+
+/* uint32_t frame_alloc(void);
+ * Inputs: none
+ * Return Value: physical page number of the frame, 0 if none is left
+ * Function: Finds a free frame, dropping unused page cache pages if
+ *           memory is full. The frame's contents are not cleared. */
+uint32_t frame_alloc(void) {
+    uint32_t i;
+    uint32_t index;
+
+    do {
+        for (i = 0; i < frames_total; i++) {
+            index = (frame_next + i) % frames_total;
+            if (frame_ref[index] == 0) {
+                frame_ref[index] = 1;
+                frames_used++;
+                frame_next = (index + 1) % frames_total;
+                return frame_first_ppn + index;
+            }
+        }
+    } while (page_cache_evict() == 0);
+
+    return 0;
+}
+
+/* void frame_get(uint32_t ppn);
+ * Inputs: ppn = frame gaining a user
+ * Return Value: none
+ * Function: adds a reference */
+void frame_get(uint32_t ppn) {
+    frame_ref[frame_index(ppn)]++;
+}
+
+/* void frame_put(uint32_t ppn);
+ * Inputs: ppn = frame losing a user
+ * Return Value: none
+ * Function: drops a reference and frees the frame with the last one */
+void frame_put(uint32_t ppn) {
+    uint32_t index = frame_index(ppn);
+
+    if (frame_ref[index] == 0)
+        return;
+    if (--frame_ref[index] == 0)
+        frames_used--;
+}
+
+/* uint32_t frame_refs(uint32_t ppn);
+ * Inputs: ppn = frame to look at
+ * Return Value: number of references, 0 if free */
+uint32_t frame_refs(uint32_t ppn) {
+    return frame_ref[frame_index(ppn)];
+}
+
+/* void* kmap(uint32_t ppn, uint32_t slot);
+ * Inputs: ppn = frame to reach
+ *         slot = window slot to use, below KMAP_SLOTS
+ * Return Value: kernel address of the frame
+ * Function: maps the frame at KMAP_ADDR + slot * 4kB */
+void* kmap(uint32_t ppn, uint32_t slot) {
+    uint32_t vaddr = KMAP_ADDR + slot * ALIGN_4KB;
+
+    map_page(vaddr, ppn * ALIGN_4KB, PG_WRITE);
+    return (void*)vaddr;
+}
+
+/* void kunmap(uint32_t slot);
+ * Inputs: slot = window slot to clear
+ * Return Value: none */
+void kunmap(uint32_t slot) {
+    unmap_page(KMAP_ADDR + slot * ALIGN_4KB);
+}
+
+/* int32_t meminfo_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written
+ * Function: Frame pool and page cache totals, then the pages each running
+ *           process has resident and how many of them it shares */
+int32_t meminfo_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t cached, cached_mapped;
+    uint32_t resident, shared;
+    uint32_t pid;
+
+    page_cache_usage(&cached, &cached_mapped);
+
+    len += snprintf(buf + len, size - len, "frames:     %u total, %u used, %u free (4kB)\n",
+                    frames_total, frames_used, frames_total - frames_used);
+    len += snprintf(buf + len, size - len, "page cache: %u pages, %u mapped\n",
+                    cached, cached_mapped);
+    len += snprintf(buf + len, size - len, "pid  resident  shared  private kB\n");
+    for (pid = 0; pid < USER_PID_MAX; pid++) {
+        if (!pid_array[pid])
+            continue;
+        user_pages_count(pid, &resident, &shared);
+        len += snprintf(buf + len, size - len, "%-5u%-10u%-8u%u\n",
+                        pid, resident, shared, (resident - shared) * (ALIGN_4KB / 1024));
+    }
+    return len;
+}
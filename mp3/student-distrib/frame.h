@@ -0,0 +1,44 @@
+/* frame.h - Physical page frames for user memory
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "paging.h"
+
+/* User pages come from all the memory above the kernel's 4MB-8MB page
+ * that multiboot reports, up to FRAME_POOL_MAX_END. Without memory
+ * information the pool is the 32MB the per-process 4MB blocks used to
+ * take up. */
+#define FRAME_POOL_START    0x800000
+#define FRAME_POOL_MAX_END  0x10000000  // 256MB
+#define FRAME_POOL_DEFAULT_END  (FRAME_POOL_START + USER_PID_MAX * PAGE_4MB)
+#define NUM_FRAMES_MAX      ((FRAME_POOL_MAX_END - FRAME_POOL_START) / ALIGN_4KB)
+
+/* Kernel window for reaching frames that are not mapped anywhere else */
+#define KMAP_ADDR           0x800000    // in the 8MB-12MB directory entry
+#define KMAP_SLOTS          2
+
+/* Sizes the pool from the end of RAM, leaving out anything below
+ * reserved_end (the boot modules) */
+void frame_init(uint32_t mem_end, uint32_t reserved_end);
+
+/* Takes a free frame with one reference. Returns its physical page number,
+ * 0 if memory is full. */
+uint32_t frame_alloc(void);
+
+/* Adds/drops a reference, the frame is freed when the last one goes */
+void frame_get(uint32_t ppn);
+void frame_put(uint32_t ppn);
+uint32_t frame_refs(uint32_t ppn);
+
+/* Maps a frame into one of the kernel window slots and returns its address */
+void* kmap(uint32_t ppn, uint32_t slot);
+void kunmap(uint32_t slot);
+
+/* Memory accounting text for the meminfo pseudo file */
+int32_t meminfo_show(int8_t* buf, int32_t size);
+
+#endif /* _FRAME_H */
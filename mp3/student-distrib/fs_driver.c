@@ -1,6 +1,62 @@
 #include "fs_driver.h"
 #include "syscall.h"
+#include "proc.h"
+#include "serial.h"
+#include "lz4.h"
+#include "ata.h"
+#include "bcache.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+#define FS_CACHE_EMPTY 0xFFFFFFFF
+
+/* One decompressed 4kB piece of a compressed file */
+typedef struct fs_cache_slot {
+  uint32_t inode;     // FS_CACHE_EMPTY if the slot holds nothing
+  uint32_t piece;
+  uint32_t length;    // bytes of data, less than a block for the last piece
+  uint8_t data[BLOCK_SIZE];
+} fs_cache_slot_t;
+
+// 1 for the inodes of LZ_FTYPE files, set up by file_system_init
+static uint8_t inode_lz[FS_LZ_MAX_INODES];
+// Direct mapped on inode and piece. Only reached from system calls and
+// program loading, which the timer never preempts, so no lock.
+static fs_cache_slot_t fs_cache[FS_CACHE_SLOTS];
+static uint8_t lz_buf[BLOCK_SIZE];
+
+uint32_t fs_on_disk = 0;
+// With the image on disk the boot block is kept here, the rest is read
+// through the buffer cache
+static boot_block_t fs_boot_block;
+
+
+/* fs_disk_init
+ * Inputs: None
+ * Return Value: 0 if the disk holds a file system image, -1 otherwise
+ * Function: Copies the disk's boot block in and points boot_block_ptr at it.
+ *           inode_ptr and data_block_ptr are left NULL, fs_block reads
+ *           everything after the boot block on demand.
+ */
+static int32_t fs_disk_init(){
+  boot_block_t* boot;
+  uint32_t blocks;
 
+  if(!ata_present)
+    return -1;
+  bcache_flush();
+  boot = (boot_block_t*)bcache_get(0);
+  if(boot == NULL || boot->num_dentries > BOOT_DENTRY_NUM)
+    return -1;
+  blocks = 1 + boot->num_inodes + boot->num_data_blocks;
+  if(blocks < boot->num_inodes || blocks > ata_sectors / (BLOCK_SIZE / ATA_SECTOR_SIZE))
+    return -1;
+  memcpy(&fs_boot_block, boot, sizeof(fs_boot_block));
+  boot_block_ptr = &fs_boot_block;
+  inode_ptr = NULL;
+  data_block_ptr = NULL;
+  return 0;
+}
 
 /* file_sys_init 
  * Inputs: None
@@ -10,12 +66,80 @@ void file_system_init() {
   
   // Initialize the file system pointers
   boot_block_ptr = (boot_block_t*)(FILE_SYS_BASE_ADDR);
+  if(fs_on_disk && fs_disk_init() == -1) {
+    printf("No file system on the disk, using the boot module\n");
+    fs_on_disk = 0;
+  }
   uint32_t num_inodes = boot_block_ptr->num_inodes;
   dentry_ptr = boot_block_ptr->dentry;
-  inode_ptr = (inode_t* )(boot_block_ptr + 1); 
-  data_block_ptr = (uint8_t*)(inode_ptr + num_inodes); 
+  if(!fs_on_disk) {
+    inode_ptr = (inode_t* )(boot_block_ptr + 1); 
+    data_block_ptr = (uint8_t*)(inode_ptr + num_inodes); 
+  }
+
+  // Note which inodes hold compressed files, read_data only sees the inode
+  uint32_t i;
+  for(i = 0; i < boot_block_ptr->num_dentries && i < BOOT_DENTRY_NUM; i++) {
+    if(dentry_ptr[i].ftype == LZ_FTYPE && dentry_ptr[i].inode_num < FS_LZ_MAX_INODES)
+      inode_lz[dentry_ptr[i].inode_num] = 1;
+  }
+  fs_cache_flush();
 
+}
 
+/* fs_name_hash
+ * Inputs: fname - file name, NULL terminated or MAX_FILENAME long
+ * Return Value: 32 bit FNV-1a hash of the name
+ * Function: Same hash as fstools/createfs puts in the dentries.
+ */
+uint32_t fs_name_hash(const uint8_t* fname){
+  uint32_t hash = FNV_OFFSET;
+  int i;
+  for(i = 0; i < MAX_FILENAME && fname[i] != '\0'; i++)
+    hash = (hash ^ fname[i]) * FNV_PRIME;
+  return hash;
+}
+
+/* dentry_name_match
+ * Inputs: fname - file name to search
+ *         fname_len - its length
+ *         i - dentry index
+ * Return Value: 1 if dentry i has the name fname, 0 otherwise
+ */
+static int dentry_name_match(const uint8_t* fname, int fname_len, int i){
+  int dentry_name_len = strlen((int8_t*)dentry_ptr[i].fname);
+  if(dentry_name_len > MAX_FILENAME){
+    dentry_name_len = MAX_FILENAME;
+  }
+  return fname_len == dentry_name_len &&
+         !strncmp((int8_t*) fname, (int8_t*)dentry_ptr[i].fname, MAX_FILENAME);
+}
+
+/* hash_lookup
+ * Inputs: fname - file name to search
+ *         fname_len - its length
+ * Return Value: dentry index, -1 if the name is not in the table,
+ *               -2 if the image has no table
+ * Function: Walks the one chain the name hashes to. The stored hashes
+ *           are compared first so most other names cost no strncmp.
+ */
+static int hash_lookup(const uint8_t* fname, int fname_len){
+  uint8_t* table = boot_block_ptr->reserved;
+  uint32_t hash;
+  uint32_t next;
+  if(*(uint32_t*)table != FS_HASH_MAGIC || table[FS_HASH_OFF_BUCKETS] != FS_HASH_BUCKETS)
+    return -2;
+
+  hash = fs_name_hash(fname);
+  next = table[FS_HASH_OFF_HEADS + hash % FS_HASH_BUCKETS];
+  // Chains only hold boot block entries, a bad link ends the walk
+  while(next != 0 && next <= boot_block_ptr->num_dentries && next <= BOOT_DENTRY_NUM) {
+    if(*(uint32_t*)dentry_ptr[next - 1].reserved == hash &&
+       dentry_name_match(fname, fname_len, next - 1))
+      return next - 1;
+    next = dentry_ptr[next - 1].reserved[FS_HASH_OFF_NEXT];
+  }
+  return -1;
 }
 
 /* read_dentry_by_name
@@ -24,19 +148,20 @@ void file_system_init() {
  * Return Value: 0 if success, -1 otherwise.
  * Function: Find the file with name given as the input in the file system. 
  *           Copy the file name, file type and inode number into the dentry object given as input.
+ *           Images built with a name hash table are searched through it,
+ *           others by going through every dentry.
  */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
   int fname_len = strlen((int8_t*) fname);
-  int dentry_name_len;
-  // Iterate through the boot block to find file name "fname" parameter
-  int i;
-  for(i = 0; i <BOOT_BLOCK_SIZE; i++) {
-    dentry_name_len = strlen((int8_t*)dentry_ptr[i].fname);
-    if(dentry_name_len > MAX_FILENAME){
-      dentry_name_len = MAX_FILENAME;
-    } 
-    if(fname_len == dentry_name_len) {
-      if( !(strncmp((int8_t*) fname, (int8_t*)dentry_ptr[i].fname, MAX_FILENAME))) {
+  int i = hash_lookup(fname, fname_len);
+  if(i >= 0) {
+    read_dentry_by_index(i, dentry);
+    return 0;
+  }
+  // Without a table, iterate through the boot block to find file name "fname" parameter
+  if(i == -2) {
+    for(i = 0; i <BOOT_BLOCK_SIZE; i++) {
+      if(dentry_name_match(fname, fname_len, i)) {
         // If file with given argument "fname" is found, copy everything into dentry object
         read_dentry_by_index(i, dentry);
         // Success. Return 0 and leave function.
@@ -44,8 +169,10 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
       }
     }
   }
-  // Failed to find file with given argument in "fname".
-  return -1;
+  // Not in the boot block, it may be one of the pseudo files or a device.
+  if(proc_lookup(fname, dentry) == 0)
+    return 0;
+  return serial_lookup(fname, dentry);
 }
 
 /* read_dentry_by_index
@@ -69,55 +196,199 @@ int32_t read_dentry_by_index (uint8_t idx, dentry_t* dentry){
   return -1;
 }
 
+/* fs_block
+ * Inputs:  n - block of the image, 0 is the boot block, then the inodes, then the data
+ * Return Value: pointer to the block's contents, NULL if it could not be read
+ * Function: From the disk the pointer is only good until the buffer cache
+ *           has handed out BCACHE_SIZE - 1 other blocks.
+ */
+static uint8_t* fs_block(uint32_t n){
+  if(fs_on_disk)
+    return bcache_get(n);
+  return (uint8_t*)boot_block_ptr + BLOCK_SIZE * n;
+}
+
+/* fs_inode
+ * Inputs:  inode - inode number
+ * Return Value: the inode block, NULL if inode is out of range or unreadable
+ */
+inode_t* fs_inode(uint32_t inode){
+  if(inode >= boot_block_ptr->num_inodes)
+    return NULL;
+  return (inode_t*)fs_block(1 + inode);
+}
+
+/* read_raw
+ * Inputs:  inode - inode number of the file, already checked
+ *          offset - offset in the stored data to start from
+ *          buf - buf to copy data into
+ *          length - how much data to copy, already checked against the file length
+ * Return Value: length if success. -1 if a data block number is bad or a block
+ *               could not be read.
+ * Function: copies the stored bytes of a file, a block at a time. The inode
+ *           is looked up again for every block, so that on disk it stays
+ *           the most recently used block in the cache.
+ */
+static int32_t read_raw(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    uint32_t N = boot_block_ptr->num_inodes;
+    uint32_t D = boot_block_ptr->num_data_blocks;
+    uint32_t data_block_index = offset / BLOCK_SIZE;        /* beginning number of data block */
+    uint32_t byte_index = offset % BLOCK_SIZE;              /* beginning index within data block */
+    uint32_t block_num;                                     /* data block number */
+    uint32_t bytes_read = 0;
+    inode_t* inode_block_ptr;
+    uint8_t* block_ptr;
+    uint32_t n;
+
+    while(bytes_read < length){
+      inode_block_ptr = fs_inode(inode);
+      if(inode_block_ptr == NULL || data_block_index >= INODE_DATA_BLOCK_NUM){
+        return -1;
+      }
+      block_num = inode_block_ptr->data_blocks_num[data_block_index];
+      if(block_num >= D){
+        return -1;
+      }
+      block_ptr = fs_block(1 + N + block_num);
+      if(block_ptr == NULL){
+        return -1;
+      }
+      n = BLOCK_SIZE - byte_index;
+      if(n > length - bytes_read){
+        n = length - bytes_read;
+      }
+      memcpy(buf + bytes_read, block_ptr + byte_index, n);
+      bytes_read += n;
+      byte_index = 0;
+      data_block_index++;
+    }
+    return bytes_read;
+}
+
+/* fs_cache_flush
+ * Inputs: None
+ * Return Value: None
+ * Function: Empties the cache of decompressed pieces.
+ */
+void fs_cache_flush(void){
+  int i;
+  for(i = 0; i < FS_CACHE_SLOTS; i++){
+    fs_cache[i].inode = FS_CACHE_EMPTY;
+  }
+}
+
+/* lz_piece
+ * Inputs:  inode - inode number of a compressed file
+ *          piece - which 4kB piece of the file
+ * Return Value: cache slot holding the piece, NULL if the stored data is bad
+ * Function: Decompresses the piece into its cache slot unless it is there
+ *           already. The file length must have been checked by the caller.
+ */
+static fs_cache_slot_t* lz_piece(uint32_t inode, uint32_t piece){
+    fs_cache_slot_t* slot = &fs_cache[(inode + piece) % FS_CACHE_SLOTS];
+    inode_t* inode_block_ptr;
+    uint32_t file_length;
+    uint32_t pieces;
+    uint32_t range[2];                                      /* start and end of the piece */
+    uint32_t length;
+
+    if(slot->inode == inode && slot->piece == piece){
+      return slot;
+    }
+
+    inode_block_ptr = fs_inode(inode);
+    if(inode_block_ptr == NULL){
+      return NULL;
+    }
+    file_length = inode_block_ptr->length;
+    pieces = (file_length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if(pieces > INODE_DATA_BLOCK_NUM){
+      return NULL;
+    }
+    /* the first piece starts right after the table of end offsets */
+    if(piece == 0){
+      range[0] = pieces * sizeof(uint32_t);
+      if(read_raw(inode, 0, (uint8_t*)&range[1], sizeof(uint32_t)) == -1){
+        return NULL;
+      }
+    }else if(read_raw(inode, (piece - 1) * sizeof(uint32_t), (uint8_t*)range, sizeof(range)) == -1){
+      return NULL;
+    }
+    length = file_length - piece * BLOCK_SIZE;
+    if(length > BLOCK_SIZE){
+      length = BLOCK_SIZE;
+    }
+    if(range[1] < range[0] || range[1] - range[0] > length ||
+       range[1] > INODE_DATA_BLOCK_NUM * BLOCK_SIZE){
+      return NULL;
+    }
+
+    slot->inode = FS_CACHE_EMPTY;
+    if(range[1] - range[0] == length){
+      /* stored as is, compression did not help */
+      if(read_raw(inode, range[0], slot->data, length) == -1){
+        return NULL;
+      }
+    }else if(read_raw(inode, range[0], lz_buf, range[1] - range[0]) == -1 ||
+             lz4_decompress(lz_buf, range[1] - range[0], slot->data, BLOCK_SIZE) != length){
+      return NULL;
+    }
+    slot->inode = inode;
+    slot->piece = piece;
+    slot->length = length;
+    return slot;
+}
+
 /* read_data
  * Inputs:  inode - inode number that points to inode block
  *          offset - offset from beginnging to start reading count  
  *          buf - buf to copy data into
  *          length - how much data to read 
- * Return Value: 0 is success. -1 otherwise.
- * Function: read data from file given inode number.
+ * Return Value: number of bytes read if success. -1 otherwise.
+ * Function: read data from file given inode number. Compressed files are
+ *           read a decompressed piece at a time through fs_cache.
  */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
-    int i;
-    inode_t* inode_block_ptr = (inode_t*)(inode_ptr+inode); /* pointer to current inode block*/
-    uint32_t* block_ptr;                                    /* pointer to data block*/
-    uint32_t block_num;                                     /* data block number */
+    inode_t* inode_block_ptr;                               /* pointer to current inode block*/
+    fs_cache_slot_t* slot;
     uint32_t bytes_read = 0;                                
-    uint32_t file_length = inode_block_ptr->length;           
+    uint32_t file_length;
     uint32_t N = boot_block_ptr->num_inodes;
-    uint32_t D = boot_block_ptr->num_data_blocks;
-    uint32_t data_block_index = offset / BLOCK_SIZE;        /* beginning number of data block */
-    uint32_t byte_index = offset % BLOCK_SIZE;              /* beginning index within data block */
+    uint32_t n;
 
+    if(inode >= N){        
+      return -1;
+    }
+    inode_block_ptr = fs_inode(inode);
+    if(inode_block_ptr == NULL){
+      return -1;
+    }
+    file_length = inode_block_ptr->length;
     if(offset >= file_length){                
       return 0; 
     }
-    if(inode >= N || inode < 0){        
-      return -1;
+    if(length > file_length - offset){
+      length = file_length - offset;
     }
 
-    /* go though each byte and copy data into buf */
-    for(i=0 ; i<length; i++, byte_index++, bytes_read++,buf++){
-
-      if((i+offset) >= file_length){
-        return bytes_read;
-      }
+    if(inode >= FS_LZ_MAX_INODES || !inode_lz[inode]){
+      return read_raw(inode, offset, buf, length);
+    }
 
-      /* set byte index and data block index accordingly*/
-      if(byte_index >= BLOCK_SIZE){
-        byte_index = 0;
-        data_block_index++;
-      }
-      /* based on byte index and data block index, set pointer to data block */
-      block_num = inode_block_ptr->data_blocks_num[data_block_index];
-      if(block_num >= D){
+    while(bytes_read < length){
+      slot = lz_piece(inode, offset / BLOCK_SIZE);
+      if(slot == NULL){
         return -1;
       }
-      block_ptr = (uint32_t*)(data_block_ptr + (BLOCK_SIZE)*block_num + byte_index);
-
-      memcpy(buf, block_ptr,1);
+      n = BLOCK_SIZE - offset % BLOCK_SIZE;
+      if(n > length - bytes_read){
+        n = length - bytes_read;
+      }
+      memcpy(buf + bytes_read, slot->data + offset % BLOCK_SIZE, n);
+      bytes_read += n;
+      offset += n;
     }
-
     return bytes_read;
 }
 
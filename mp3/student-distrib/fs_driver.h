@@ -19,6 +19,25 @@
 #define BOOT_DENTRY_NUM       63
 #define INODE_DATA_BLOCK_NUM  1023  
 
+// Name hash table that fstools/createfs -H keeps in the reserved bytes.
+// Boot block: magic, bucket count, then one chain head per bucket.
+// Dentry: FNV-1a hash of the name, then the next dentry in its chain.
+// Chain links are dentry index + 1, 0 ends a chain.
+#define FS_HASH_MAGIC     0x3154484E  // "NHT1"
+#define FS_HASH_BUCKETS   32
+#define FS_HASH_OFF_BUCKETS 4         // offsets into boot_block_t.reserved
+#define FS_HASH_OFF_HEADS   5
+#define FS_HASH_OFF_NEXT    4         // offset into dentry_t.reserved
+
+// Regular file stored compressed (fstools/createfs -z). Its inode length is
+// the uncompressed length, and its data blocks hold one stream: a uint32_t
+// end offset (from the start of the stream) for each 4kB piece of the
+// file, then the pieces, each an LZ4 block. A piece whose compressed size
+// equals its uncompressed size is stored as is.
+#define LZ_FTYPE          5
+#define FS_LZ_MAX_INODES  256         // inodes past this can not be compressed
+#define FS_CACHE_SLOTS    8           // decompressed 4kB pieces kept
+
 // typedef struct {
 //   uint32_t file_op_table_ptr; // To implement in later checkpoints, when we implement wrap drivers around a unified file system call interface (like the POSIX API)
 //   uint32_t inode;
@@ -54,6 +73,10 @@ uint32_t counter;
 // Base address of file system. Declared and defined in kernel.c
 extern unsigned int FILE_SYS_BASE_ADDR;
 
+// Set before file_system_init to read the image from the ATA disk instead
+// of the boot module ("disk" on the kernel command line)
+extern uint32_t fs_on_disk;
+
 // File system data structure pointers. Needed in read_data func.
 inode_t* inode_ptr;
 uint8_t* data_block_ptr;
@@ -89,6 +112,9 @@ int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes);
 /* Directory read() read files filename by filename, including “.”*/
 int32_t dir_read();
 
+/* FNV-1a hash of a file name, over at most MAX_FILENAME characters */
+uint32_t fs_name_hash(const uint8_t* fname);
+
 /*Find the file with name given as the input in the file system. 
  *           Copy the file name, file type and inode number into the dentry object given as input. 
  * */
@@ -99,9 +125,16 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
  * */
 int32_t read_dentry_by_index (uint8_t index, dentry_t* dentry);
 
+/* Inode block of an inode number, NULL if there is no such inode or it
+ * can not be read. From the disk it is only good until the next call. */
+inode_t* fs_inode(uint32_t inode);
+
 /*  read data from file given inode number. */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
+/* Drops every decompressed piece, so the next reads decompress again */
+void fs_cache_flush(void);
+
 
 
 #endif 
@@ -4,6 +4,10 @@
 // wrappers for interrupt handler functions 
 extern void KEYBOARD_WRAPPER();
 extern void RTC_WRAPPER();
+extern void PIT_WRAPPER();
+extern void SERIAL_WRAPPER();
+extern void LAPIC_TIMER_WRAPPER();
+extern void LAPIC_SPURIOUS_WRAPPER();
 
 
 #endif 
@@ -4,6 +4,8 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
+#include "ioapic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask = MASK_INIT; /* IRQs 0-7  */
@@ -42,6 +44,10 @@ void enable_irq(uint32_t irq_num) {
     if(irq_num > MAX_IRQ_NUM){             /* check range of irq_num */
         return;
     }
+    if(irq_ioapic){
+        ioapic_enable_irq(irq_num);
+        return;
+    }
 
     if(irq_num < 8){                            /* irq less than 8, master */
         master_mask &= ~(1 << irq_num);
@@ -62,6 +68,10 @@ void enable_irq(uint32_t irq_num) {
     if(irq_num > MAX_IRQ_NUM){             /* check range of irq_num */
         return;
     }
+    if(irq_ioapic){
+        ioapic_disable_irq(irq_num);
+        return;
+    }
 
     if(irq_num < MAX_MASTER_IRQ_NUM){                            /* irq less than 8, master */
         master_mask |= 1 << irq_num;
@@ -82,6 +92,10 @@ void send_eoi(uint32_t irq_num) {
     if(irq_num > MAX_IRQ_NUM){             /* check range of irq_num */
         return;
     }
+    if(irq_ioapic){                        /* one register write ends any IRQ */
+        lapic_eoi();
+        return;
+    }
 
     if(irq_num < MAX_MASTER_IRQ_NUM){                                   /* irq less than 8, master */
         outb(EOI | irq_num, MASTER_8259_CMD_PORT);       
@@ -90,3 +104,17 @@ void send_eoi(uint32_t irq_num) {
     outb(EOI | (irq_num-MAX_MASTER_IRQ_NUM), SLAVE_8259_CMD_PORT);     /* irq bigger than 8, slave */                                     
     outb(EOI | SLAVE_IRQ_NUM, MASTER_8259_CMD_PORT);      
 }
+
+/* uint16_t i8259_disable(void);
+ * Inputs: void
+ * Return Value: bit n set for every IRQ n that was enabled
+ * Function:  Masks every IRQ on both PICs, for when the IO APIC takes over */
+uint16_t i8259_disable(void) {
+    uint16_t enabled = ~(master_mask | (slave_mask << MAX_MASTER_IRQ_NUM));
+
+    master_mask = MASK_INIT;
+    slave_mask = MASK_INIT;
+    outb(master_mask, MASTER_8259_DATA_PORT);
+    outb(slave_mask, SLAVE_8259_DATA_PORT);
+    return enabled;
+}
@@ -4,6 +4,12 @@
 #include "lib.h"
 #include "handlers.h"
 #include "syscall.h"
+#include "paging.h"
+#include "signal.h"
+#include "crash.h"
+#include "apic.h"
+
+#define USER_RPL    0x3     //privilege bits of a user code selector
 
 static char* exception_names[] = {
     "divide_error",
@@ -77,36 +83,60 @@ void idt_init(void) {
     SET_IDT_ENTRY(idt[SYSCALL_VEC_NUM], syscall_handler);
     idt[SYSCALL_VEC_NUM].dpl = 0x3;     // Specify userspace callable
     idt[SYSCALL_VEC_NUM].present = 0x1;
+    idt[SYSCALL_VEC_NUM].reserved3 = 0x1;   // Trap gate, syscalls run with interrupts on
 
     // Register device interrupts
     idt[KEYBOARD_VEC_NUM].present = 1;
     idt[RTC_VEC_NUM].present = 1;
+    idt[PIT_VEC_NUM].present = 1;
+    idt[SERIAL_VEC_NUM].present = 1;
     idt[KEYBOARD_VEC_NUM].reserved3 = 0x1;
     idt[RTC_VEC_NUM].reserved3 = 0x1;
+    idt[PIT_VEC_NUM].reserved3 = 0x1;
+    idt[SERIAL_VEC_NUM].reserved3 = 0x1;
     SET_IDT_ENTRY(idt[KEYBOARD_VEC_NUM], KEYBOARD_WRAPPER);
     SET_IDT_ENTRY(idt[RTC_VEC_NUM], RTC_WRAPPER);
+    SET_IDT_ENTRY(idt[PIT_VEC_NUM], PIT_WRAPPER);
+    SET_IDT_ENTRY(idt[SERIAL_VEC_NUM], SERIAL_WRAPPER);
+
+    // Local APIC vectors, only the APs take these
+    idt[LAPIC_TIMER_VEC_NUM].present = 1;
+    idt[LAPIC_SPURIOUS_VEC_NUM].present = 1;
+    SET_IDT_ENTRY(idt[LAPIC_TIMER_VEC_NUM], LAPIC_TIMER_WRAPPER);
+    SET_IDT_ENTRY(idt[LAPIC_SPURIOUS_VEC_NUM], LAPIC_SPURIOUS_WRAPPER);
 
 
     lidt(idt_desc_ptr);
 }
 
-void exception_handler(uint32_t id, struct x86_regs regs, uint32_t flags, uint32_t error) {
-    uint32_t cs;
-    asm("\t movl %%cs, %0" : "=r"(cs));
-
-    clear();
-    printf("    .--.\n   |o_o |\n   |:_/ |\n  //   \\ \\\n (|     | )\n/'\\_   _/`\\\n\\___)=(___/  \n\n");
-
-    if(id < NUM_EXCEPTIONS)
-        printf("Caught exception: %s (%d)\n\n", exception_names[id], id);
-
-    printf("ESP: %#x \t ESI: %#x\n", regs.esp, regs.esi);
-    printf("EBP: %#x \t EDI: %#x\n", regs.ebp, regs.edi);
-    printf("EAX: %#x \t EBX: %#x\n", regs.eax, regs.ebx);
-    printf("ECX: %#x \t EDX: %#x\n", regs.ecx, regs.edx);
-    printf("EFLAGS: %#x\n", flags);
-    printf("\nERROR: %#x\n", error);
-    
-    
-    halt(255); // Kill responsible process with error code -1
+void exception_handler(uint32_t id, struct x86_regs regs, uint32_t flags, uint32_t error, uint32_t eip, uint32_t cs) {
+    //Faults on bss and stack pages that have not been touched yet, and on
+    //writes to pages fork shares
+    if(id == E14 && page_fault_resolve(error))
+        return;
+
+    //A user program with a handler gets a signal, delivered on the way out
+    if((cs & USER_RPL) == USER_RPL && signal_fault(id == E0 ? DIV_ZERO : SEGFAULT))
+        return;
+
+    crash_record(id, eip, error);
+
+    //A faulting program just goes, the record is in the crashlog file. A
+    //fault in the kernel is a bug worth a full dump before the process
+    //it was working for is killed.
+    if((cs & USER_RPL) != USER_RPL){
+        printf("    .--.\n   |o_o |\n   |:_/ |\n  //   \\ \\\n (|     | )\n/'\\_   _/`\\\n\\___)=(___/  \n\n");
+
+        if(id < NUM_EXCEPTIONS)
+            printf("Caught exception: %s (%d) at %#x\n\n", exception_names[id], id, eip);
+
+        printf("ESP: %#x \t ESI: %#x\n", regs.esp, regs.esi);
+        printf("EBP: %#x \t EDI: %#x\n", regs.ebp, regs.edi);
+        printf("EAX: %#x \t EBX: %#x\n", regs.eax, regs.ebx);
+        printf("ECX: %#x \t EDX: %#x\n", regs.ecx, regs.edx);
+        printf("EFLAGS: %#x\n", flags);
+        printf("\nERROR: %#x\n", error);
+    }
+
+    process_exit(EXCEPTION_STATUS);
 }
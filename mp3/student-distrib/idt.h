@@ -1,14 +1,18 @@
 #ifndef IDT_H
 #define IDT_H
 
+#define SYSCALL_VEC_NUM     (0x80)
+#define RTC_VEC_NUM         (40)
+#define PIT_VEC_NUM         (32)
+#define KEYBOARD_VEC_NUM    (33)
+#define SERIAL_VEC_NUM      (36)
+#define MAX_SYSCALL_NUM     (18)
+
 #ifndef ASM
 
 #include "lib.h"
 
 #define NUM_EXCEPTIONS      (21)
-#define SYSCALL_VEC_NUM     (0x80)
-#define RTC_VEC_NUM         (40)
-#define KEYBOARD_VEC_NUM    (33)
 
 #define E0     (0)     
 #define E1     (1)
@@ -48,7 +52,7 @@
  } __attribute__ (( packed ));
 
 void idt_init(void);
-void exception_handler(uint32_t id, struct x86_regs regs, uint32_t flags, uint32_t error);
+void exception_handler(uint32_t id, struct x86_regs regs, uint32_t flags, uint32_t error, uint32_t eip, uint32_t cs);
 void general_interrupt(void);
 
 #endif /* ASM */
@@ -0,0 +1,151 @@
+/* ioapic.c - IO APIC routing of the ISA interrupts
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ioapic.h"
+#include "apic.h"
+#include "smp.h"
+#include "i8259.h"
+#include "lib.h"
+
+#define IOAPIC_REGSEL       0x00        // register index
+#define IOAPIC_WIN          0x10        // data window onto the selected register
+#define IOAPIC_VER          0x01
+#define IOAPIC_REDIR        0x10        // two registers per pin from here
+#define VER_PINS_SHIFT      16
+#define VER_PINS_MASK       0xFF
+
+#define REDIR_LOW_POLARITY  0x00002000
+#define REDIR_LEVEL         0x00008000
+#define REDIR_MASKED        0x00010000
+#define REDIR_DEST_SHIFT    24
+
+#define MP_POLARITY_LOW     0x3         // MP interrupt entry flag bits 1:0
+#define MP_TRIGGER_SHIFT    2
+#define MP_TRIGGER_LEVEL    0x3         // MP interrupt entry flag bits 3:2
+
+#define IMCR_INDEX          0x22
+#define IMCR_DATA           0x23
+#define IMCR_SELECT         0x70
+#define IMCR_APIC           0x01        // INTR goes through the APIC, not straight to the CPU
+
+uint32_t irq_ioapic = 0;
+
+static volatile uint32_t* ioapic_base = NULL;
+static uint32_t ioapic_imcr = 0;
+
+/* Pin and MP flags of every ISA IRQ, identity unless the MP table says
+ * otherwise (the timer usually sits on pin 2) */
+static uint8_t irq_pin[ISA_IRQS] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+static uint16_t irq_flags[ISA_IRQS];
+
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic_base[IOAPIC_REGSEL / 4] = reg;
+    return ioapic_base[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+    ioapic_base[IOAPIC_REGSEL / 4] = reg;
+    ioapic_base[IOAPIC_WIN / 4] = value;
+}
+
+/* void ioapic_found(uint32_t addr, uint32_t imcr);
+ * Inputs: addr - physical address of the IO APIC registers
+ *         imcr - 1 if the IMCR has to be switched to APIC mode
+ * Return Value: none
+ * Function: only the first IO APIC is used, the ISA IRQs all sit on it */
+void ioapic_found(uint32_t addr, uint32_t imcr) {
+    if (ioapic_base)
+        return;
+    ioapic_base = (volatile uint32_t*)addr;
+    ioapic_imcr = imcr;
+}
+
+/* void ioapic_set_route(uint32_t irq, uint32_t pin, uint32_t flags);
+ * Inputs: irq - ISA IRQ number
+ *         pin - IO APIC input it is wired to
+ *         flags - polarity and trigger mode from the MP table
+ * Return Value: none */
+void ioapic_set_route(uint32_t irq, uint32_t pin, uint32_t flags) {
+    if (irq >= ISA_IRQS)
+        return;
+    irq_pin[irq] = pin;
+    irq_flags[irq] = flags;
+}
+
+/* static uint32_t ioapic_redir(uint32_t irq_num);
+ * Inputs: irq_num - ISA IRQ
+ * Return Value: low word of the redirection entry, unmasked
+ * Function: fixed delivery to the same vector the 8259s used for the IRQ */
+static uint32_t ioapic_redir(uint32_t irq_num) {
+    uint32_t redir = ICW2_MASTER + irq_num;
+
+    if ((irq_flags[irq_num] & MP_POLARITY_LOW) == MP_POLARITY_LOW)
+        redir |= REDIR_LOW_POLARITY;
+    if (((irq_flags[irq_num] >> MP_TRIGGER_SHIFT) & MP_TRIGGER_LEVEL) == MP_TRIGGER_LEVEL)
+        redir |= REDIR_LEVEL;
+    return redir;
+}
+
+/* void ioapic_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Masks every pin, takes the 8259s out of the way and then moves
+ *           over the IRQs the drivers enabled on them. Runs before sti, so
+ *           no interrupt is lost in between. */
+void ioapic_init(void) {
+    uint32_t pins, pin, irq;
+    uint16_t enabled;
+
+    if (!ioapic_base)
+        return;
+
+    pins = ((ioapic_read(IOAPIC_VER) >> VER_PINS_SHIFT) & VER_PINS_MASK) + 1;
+    for (pin = 0; pin < pins; pin++) {
+        ioapic_write(IOAPIC_REDIR + 2 * pin, REDIR_MASKED);
+        ioapic_write(IOAPIC_REDIR + 2 * pin + 1, cpus[0].apic_id << REDIR_DEST_SHIFT);
+    }
+
+    enabled = i8259_disable();
+    if (ioapic_imcr) {
+        outb(IMCR_SELECT, IMCR_INDEX);
+        outb(IMCR_APIC, IMCR_DATA);
+    }
+    lapic_enable();
+    irq_ioapic = 1;
+
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        if (irq != SLAVE_IRQ_NUM && (enabled & (1 << irq)))
+            ioapic_enable_irq(irq);
+    }
+}
+
+/* void ioapic_enable_irq(uint32_t irq_num);
+ * Inputs: irq_num - ISA IRQ to unmask
+ * Return Value: none
+ * Function: rewrites the low word of its redirection entry unmasked */
+void ioapic_enable_irq(uint32_t irq_num) {
+    uint32_t flags;
+
+    if (irq_num >= ISA_IRQS)
+        return;
+    cli_and_save(flags);
+    ioapic_write(IOAPIC_REDIR + 2 * irq_pin[irq_num], ioapic_redir(irq_num));
+    restore_flags(flags);
+}
+
+/* void ioapic_disable_irq(uint32_t irq_num);
+ * Inputs: irq_num - ISA IRQ to mask
+ * Return Value: none
+ * Function: rewrites the low word of its redirection entry masked */
+void ioapic_disable_irq(uint32_t irq_num) {
+    uint32_t flags;
+
+    if (irq_num >= ISA_IRQS)
+        return;
+    cli_and_save(flags);
+    ioapic_write(IOAPIC_REDIR + 2 * irq_pin[irq_num], ioapic_redir(irq_num) | REDIR_MASKED);
+    restore_flags(flags);
+}
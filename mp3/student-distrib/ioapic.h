@@ -0,0 +1,33 @@
+/* ioapic.h - IO APIC routing of the ISA interrupts
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IOAPIC_H
+#define _IOAPIC_H
+
+#include "types.h"
+
+#define ISA_IRQS            16
+
+/* Set once ioapic_init has taken the IRQs over from the 8259s. From then
+ * on enable_irq, disable_irq and send_eoi go to the APICs. */
+extern uint32_t irq_ioapic;
+
+/* Records the IO APIC the MP table lists. imcr is set if the board boots
+ * with the PICs wired straight to the CPU and needs the IMCR switched. */
+void ioapic_found(uint32_t addr, uint32_t imcr);
+
+/* Records an MP table interrupt entry: ISA irq arrives on IO APIC pin
+ * with the MP polarity and trigger flags. Unlisted IRQs use pin = irq. */
+void ioapic_set_route(uint32_t irq, uint32_t pin, uint32_t flags);
+
+/* Masks the 8259s and routes every IRQ they had enabled through the IO
+ * APIC to the bootstrap processor. Does nothing without an IO APIC, which
+ * leaves the 8259s in charge. Call with interrupts off. */
+void ioapic_init(void);
+
+/* Unmask / mask the pin an ISA IRQ is routed to */
+void ioapic_enable_irq(uint32_t irq_num);
+void ioapic_disable_irq(uint32_t irq_num);
+
+#endif /* _IOAPIC_H */
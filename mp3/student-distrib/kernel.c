@@ -10,37 +10,44 @@
 #include "tests.h"
 #include "idt.h"
 #include "rtc.h"
+#include "pit.h"
 #include "keyboard.h"
 #include "paging.h"
+#include "frame.h"
 
 #include "fs_driver.h"
+#include "ata.h"
 #include "syscall.h"
-#define RUN_TESTS
+#include "smp.h"
+#include "ioapic.h"
+#include "ktest.h"
+#include "serial.h"
+#include "bootprof.h"
+
+/* Define RUN_TESTS to run the tests on every boot. Otherwise they only
+ * run with "tests" or "ktest" on the kernel command line. */
+//#define RUN_TESTS
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
-// Base address of file system
-unsigned int FILE_SYS_BASE_ADDR;
+/* Where the memory multiboot's mem_upper counts starts */
+#define MEM_UPPER_START         0x100000
 
-/* Check if MAGIC is valid and print the Multiboot information structure
-   pointed by ADDR. */
-void entry(unsigned long magic, unsigned long addr) {
+/* Runs one init function and stamps the end of its stage */
+#define BOOT_STAGE(init)        \
+do {                            \
+    init();                     \
+    bootprof_mark(#init);       \
+} while (0)
 
-    multiboot_info_t *mbi;
-
-    /* Clear the screen. */
-    clear();
+// Base address of file system
+unsigned int FILE_SYS_BASE_ADDR;
 
-    /* Am I booted by a Multiboot-compliant boot loader? */
-    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
-        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
-        return;
-    }
-
-    /* Set MBI to the address of the Multiboot information structure. */
-    mbi = (multiboot_info_t *) addr;
+/* Print the Multiboot information structure pointed by MBI, only done
+   with "verbose" on the command line since printing it is slow. */
+static void multiboot_dump(multiboot_info_t *mbi) {
 
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
@@ -63,7 +70,6 @@ void entry(unsigned long magic, unsigned long addr) {
         module_t* mod = (module_t*)mbi->mods_addr;
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
-            FILE_SYS_BASE_ADDR = (unsigned int)mod->mod_start;
             printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
             printf("First few bytes of module:\n");
             for (i = 0; i < 16; i++) {
@@ -74,12 +80,6 @@ void entry(unsigned long magic, unsigned long addr) {
             mod++;
         }
     }
-    /* Bits 4 and 5 are mutually exclusive! */
-    if (CHECK_FLAG(mbi->flags, 4) && CHECK_FLAG(mbi->flags, 5)) {
-        printf("Both bits 4 and 5 are set.\n");
-        return;
-    }
-
     /* Is the section header table of ELF valid? */
     if (CHECK_FLAG(mbi->flags, 5)) {
         elf_section_header_table_t *elf_sec = &(mbi->elf_sec);
@@ -104,6 +104,68 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
     }
+}
+
+/* Check if MAGIC is valid, take the command line and the file system
+   module from the Multiboot information structure pointed by ADDR, and
+   bring the kernel up to the shell. */
+void entry(unsigned long magic, unsigned long addr) {
+
+    multiboot_info_t *mbi;
+    int8_t* cmdline = NULL;
+    int32_t boot_verbose = 0;
+    int32_t run_tests = 0;
+    uint32_t mem_end = 0;
+    uint32_t mods_end = 0;
+
+    bootprof_mark("entry");
+
+    /* Clear the screen. */
+    clear();
+
+    /* Am I booted by a Multiboot-compliant boot loader? */
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
+        return;
+    }
+
+    /* Set MBI to the address of the Multiboot information structure. */
+    mbi = (multiboot_info_t *) addr;
+
+    /* Bits 4 and 5 are mutually exclusive! */
+    if (CHECK_FLAG(mbi->flags, 4) && CHECK_FLAG(mbi->flags, 5)) {
+        printf("Both bits 4 and 5 are set.\n");
+        return;
+    }
+
+    /* Is the command line passed? */
+    if (CHECK_FLAG(mbi->flags, 2))
+        cmdline = (int8_t*)mbi->cmdline;
+    ktest_parse_cmdline(cmdline);
+    serial_console = cmdline_has(cmdline, "serial");
+    fs_on_disk = cmdline_has(cmdline, "disk");
+    boot_verbose = cmdline_has(cmdline, "verbose");
+    run_tests = cmdline_has(cmdline, "tests") || ktest_mode;
+#ifdef RUN_TESTS
+    run_tests = 1;
+#endif
+
+    /* The file system is the (last) module */
+    if (CHECK_FLAG(mbi->flags, 3) && mbi->mods_count > 0) {
+        module_t* mod = (module_t*)mbi->mods_addr;
+        FILE_SYS_BASE_ADDR = (unsigned int)mod[mbi->mods_count - 1].mod_start;
+        mods_end = mod[mbi->mods_count - 1].mod_end;
+    }
+
+    /* User page frames take the RAM above the kernel, mem_upper counts
+       the kB above 1MB */
+    if (CHECK_FLAG(mbi->flags, 0))
+        mem_end = MEM_UPPER_START + mbi->mem_upper * 1024;
+    frame_init(mem_end, mods_end);
+
+    if (boot_verbose)
+        multiboot_dump(mbi);
+    bootprof_mark("multiboot");
 
     /* Construct an LDT entry in the GDT */
     {
@@ -145,32 +207,59 @@ void entry(unsigned long magic, unsigned long addr) {
         tss.esp0 = 0x800000;
         ltr(KERNEL_TSS);
     }
+    bootprof_mark("descriptors");
+
+    /* Pick the string/memory routines for this CPU */
+    BOOT_STAGE(lib_init);
 
     /* Fill the IDT with entries */
-    idt_init();
+    BOOT_STAGE(idt_init);
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
-    i8259_init();
-    keyboard_init();
-    rtc_init();
-    paging_init();
+    BOOT_STAGE(i8259_init);
+    BOOT_STAGE(keyboard_init);
+    BOOT_STAGE(rtc_init);
+    BOOT_STAGE(pit_init);
+    BOOT_STAGE(serial_init);
+    BOOT_STAGE(smp_scan);
+    BOOT_STAGE(paging_init);
+    /* Route the IRQs through the IO APIC if smp_scan found one */
+    BOOT_STAGE(ioapic_init);
 
-    file_system_init();
-    fop_init();
+    /* The file system comes from the IDE disk when booted with "disk" */
+    BOOT_STAGE(ata_init);
+    BOOT_STAGE(file_system_init);
+    BOOT_STAGE(fop_init);
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
      * IDT correctly otherwise QEMU will triple fault and simple close
      * without showing you any output */
-    printf("Enabling Interrupts\n");
+    if (boot_verbose)
+        printf("Enabling Interrupts\n");
     sti();
 
-#ifdef RUN_TESTS
-    /* Run tests */
-    launch_tests();
-#endif
-    printf("Got past tests!\n");
+    /* This CPU holds the kernel lock until the first program starts, the
+     * others only get to schedule once there is something to run */
+    kernel_lock();
+
+    /* Start the other processors, the startup IPIs are timed by the PIT */
+    BOOT_STAGE(smp_init);
+
+    /* Run tests when asked to, always when booted with "ktest". Then the
+     * boot stamps and benchmarks are sent and QEMU exits with the
+     * result, see ktest.sh. */
+    if (run_tests) {
+        launch_tests();
+        printf("Got past tests!\n");
+    }
+    if (ktest_mode) {
+        bootprof_report();
+        launch_benches();
+        ktest_finish();
+    }
+    bootprof_mark("shell");
     /* Execute the first program ("shell") ... */
     //execute("  testprint");
     execute((const uint8_t*) "shell");
@@ -2,54 +2,72 @@
 #include "i8259.h"
 #include "lib.h"
 #include "terminal.h"
+#include "spinlock.h"
+#include "sched.h"
+#include "signal.h"
 
 /* keyboard irq number */
 #define KEYBOARD_IRQ_NUM    1
 
 #define KEYBOARD_DATA_PORT  (0x60)
 #define KEYBOARD_CMD_PORT   (0x64)
-#define SCANCODES_SIZE      (58)
+#define SCANCODES_SIZE      (84)
 #define RELEASE_OFFSET      (0x80)
 
-#define BUFFER_MAX         (127)
+// Decode tables are indexed by the make code, with extended (0xE0 prefixed)
+// keys placed in the upper half of the table
+#define SCANCODE_TABLE_SIZE (256)
+#define EXTENDED_PREFIX     (0xE0)
+#define EXTENDED_OFFSET     (0x80)
+#define SCANCODE_MASK       (0x7F)
 
 #define LEFT_SHIFT_PRESS    (0x2A)
-#define LEFT_SHIFT_RELEASE  (0xAA)
 #define RIGHT_SHIFT_PRESS   (0x36)
-#define RIGHT_SHIFT_RELEASE (0xB6)
 #define CTRL_PRESS          (0x1D)
-#define CTRL_RELEASE        (0x9D)
+#define ALT_PRESS           (0x38)
 #define CAPS_PRESS          (0x3A)
 
 #define BCKSPACE            (0x08)
 #define ENTER               (0x0A)
-//Regions containing letter characters
-#define Q_UP_LIMIT          (0x10)
-#define P_LOW_LIMIT         (0x19)
-#define A_UP_LIMIT          (0x1E)
-#define L_LOW_LIMIT         (0x26)
-#define Z_UP_LIMIT          (0x2C)
-#define M_LOW_LIMIT         (0x32)
-
-// Flags for modifier keys
-uint8_t l_shift_flag  = 0;
-uint8_t r_shift_flag  = 0;
-uint8_t ctrl_flag   = 0;    //Can be up to two (for the right and left)
-uint8_t caps_flag   = 0;
-
-// Count to keep track of the available number of backspaces
-int num_char    = 0;
-
-// Check for modifiers and return 1 if a modifier was pressed
-uint8_t check_for_modifier(uint8_t scan_code);
+
+// Modifier bits kept in mod_flags
+#define MOD_L_SHIFT         (0x01)
+#define MOD_R_SHIFT         (0x02)
+#define MOD_L_CTRL          (0x04)
+#define MOD_R_CTRL          (0x08)
+#define MOD_L_ALT           (0x10)
+#define MOD_R_ALT           (0x20)
+#define MOD_CAPS            (0x40)
+#define MOD_SHIFT           (MOD_L_SHIFT | MOD_R_SHIFT)
+#define MOD_CTRL            (MOD_L_CTRL | MOD_R_CTRL)
+#define MOD_ALT             (MOD_L_ALT | MOD_R_ALT)
+
+// One decode table per shift/caps combination
+#define MAP_PLAIN           (0)
+#define MAP_SHIFT           (1)
+#define MAP_CAPS            (2)
+#define MAP_SHIFT_CAPS      (3)
+#define NUM_KEYMAPS         (4)
+
+// Currently held modifiers and caps lock state
+uint8_t mod_flags   = 0;
+// Set to EXTENDED_OFFSET when the previous byte was the 0xE0 prefix
+static uint8_t extended = 0;
+// Guards the decoder state above
+static spinlock_t keyboard_lock = SPINLOCK_INIT("keyboard");
+
+// Update modifier state and return 1 if a modifier was pressed or released
+uint8_t check_for_modifier(uint8_t index, uint8_t released);
+// Act on a decoded key
+static void handle_key(char key);
 
 /*
 * Store every key on the keyboard and its alternate function in a lookup table
 * This was generated by pressing every key and then pressing shift + the key
 * This took forever to type
 */
-char scan_to_ascii[SCANCODES_SIZE][2] = {
-    {0x0, 0x0}, {0x0, 0x0},     // Nothing, Nothing
+static const char scan_to_ascii[SCANCODES_SIZE][2] = {
+    {0x0, 0x0}, {0x0, 0x0},     // Nothing, Escape
     {'1', '!'}, {'2', '@'},
     {'3', '#'}, {'4', '$'},
     {'5', '%'}, {'6', '^'},
@@ -76,17 +94,83 @@ char scan_to_ascii[SCANCODES_SIZE][2] = {
     {'b', 'B'}, {'n', 'N'},
     {'m', 'M'}, {',', '<'},
     {'.', '>'}, {'/', '?'},
-    {0x0, 0x0}, {0x0, 0x0},     // Right Shift, Nothing
-    {0x0, 0x0}, {' ', ' '},     // Nothing
+    {0x0, 0x0}, {'*', '*'},     // Right Shift, Keypad *
+    {0x0, 0x0}, {' ', ' '},     // Left Alt, Space
+    {0x0, 0x0}, {0x0, 0x0},     // Caps Lock, F1
+    {0x0, 0x0}, {0x0, 0x0},     // F2, F3
+    {0x0, 0x0}, {0x0, 0x0},     // F4, F5
+    {0x0, 0x0}, {0x0, 0x0},     // F6, F7
+    {0x0, 0x0}, {0x0, 0x0},     // F8, F9
+    {0x0, 0x0}, {0x0, 0x0},     // F10, Num Lock
+    {0x0, 0x0}, {'7', '7'},     // Scroll Lock, Keypad 7
+    {'8', '8'}, {'9', '9'},     // Keypad (treated as if num lock is on)
+    {'-', '-'}, {'4', '4'},
+    {'5', '5'}, {'6', '6'},
+    {'+', '+'}, {'1', '1'},
+    {'2', '2'}, {'3', '3'},
+    {'0', '0'}, {'.', '.'},
+};
 
+/* Keys that arrive behind the 0xE0 prefix. These are the same in every
+ * modifier state. */
+static const uint8_t extended_to_ascii[][2] = {
+    {0x1C, ENTER},              // Keypad Enter
+    {0x35, '/'},                // Keypad /
+    {0x47, KEY_HOME},
+    {0x48, KEY_UP},
+    {0x4B, KEY_LEFT},
+    {0x4D, KEY_RIGHT},
+    {0x4F, KEY_END},
+    {0x50, KEY_DOWN},
+    {0x53, KEY_DELETE},
 };
 
+/* Modifier bit owned by each table index, 0 for ordinary keys */
+static uint8_t modifier_map[SCANCODE_TABLE_SIZE];
+
+/* Precomputed decode tables, one per shift/caps combination. Built once in
+ * keyboard_init so the interrupt handler only does a single indexed load. */
+static char keymap[NUM_KEYMAPS][SCANCODE_TABLE_SIZE];
+
+/* Decode table matching the current shift/caps state */
+static const char* active_map = keymap[MAP_PLAIN];
+
 
 /* void keyboard_init(void);
  * Inputs: void
  * Return Value: none
- * Function: initialize keyboard by enabling irq 1 in pic */
+ * Function: build the decode tables and initialize keyboard by enabling irq 1 in pic */
 void keyboard_init(void) {
+    int i;
+    char base, shifted;
+    uint8_t is_letter;
+
+    for(i = 0; i < SCANCODES_SIZE; ++i) {
+        base = scan_to_ascii[i][0];
+        shifted = scan_to_ascii[i][1];
+        //Caps lock only affects letters, and shift undoes it
+        is_letter = (base >= 'a') && (base <= 'z');
+        keymap[MAP_PLAIN][i] = base;
+        keymap[MAP_SHIFT][i] = shifted;
+        keymap[MAP_CAPS][i] = is_letter ? shifted : base;
+        keymap[MAP_SHIFT_CAPS][i] = is_letter ? base : shifted;
+    }
+
+    for(i = 0; i < sizeof(extended_to_ascii) / sizeof(extended_to_ascii[0]); ++i) {
+        keymap[MAP_PLAIN][EXTENDED_OFFSET | extended_to_ascii[i][0]] = extended_to_ascii[i][1];
+        keymap[MAP_SHIFT][EXTENDED_OFFSET | extended_to_ascii[i][0]] = extended_to_ascii[i][1];
+        keymap[MAP_CAPS][EXTENDED_OFFSET | extended_to_ascii[i][0]] = extended_to_ascii[i][1];
+        keymap[MAP_SHIFT_CAPS][EXTENDED_OFFSET | extended_to_ascii[i][0]] = extended_to_ascii[i][1];
+    }
+
+    modifier_map[LEFT_SHIFT_PRESS] = MOD_L_SHIFT;
+    modifier_map[RIGHT_SHIFT_PRESS] = MOD_R_SHIFT;
+    modifier_map[CTRL_PRESS] = MOD_L_CTRL;
+    modifier_map[EXTENDED_OFFSET | CTRL_PRESS] = MOD_R_CTRL;
+    modifier_map[ALT_PRESS] = MOD_L_ALT;
+    modifier_map[EXTENDED_OFFSET | ALT_PRESS] = MOD_R_ALT;
+    modifier_map[CAPS_PRESS] = MOD_CAPS;
+
     enable_irq(KEYBOARD_IRQ_NUM);
 }
 
@@ -97,111 +181,86 @@ void keyboard_init(void) {
  *           and terminal_read's buffer.
  */
 extern void keyboard_handler(void) {
+    uint8_t scan_code;
+    uint8_t index;
+    char key;
+    uint32_t flags;
+
     // Start critical section
-    cli();
+    spin_lock_irqsave(&keyboard_lock, flags);
 
-    uint8_t scan_code = inb(KEYBOARD_DATA_PORT);    // take input from keyboard
+    scan_code = inb(KEYBOARD_DATA_PORT);    // take input from keyboard
 
-    if(check_for_modifier(scan_code)) {
+    //Remember the prefix, the key itself comes in the next interrupt
+    if(scan_code == EXTENDED_PREFIX) {
+        extended = EXTENDED_OFFSET;
         send_eoi(KEYBOARD_IRQ_NUM);
-        sti();
+        spin_unlock_irqrestore(&keyboard_lock, flags);
         return;
     }
 
-    if((scan_code < SCANCODES_SIZE) && (scan_code > 1)) {                // ignore released output from keyboard
-        //Outputs new line and clears the backspace counter.
-        if(scan_to_ascii[scan_code][0] == '\n'){
-            num_char = 0;
-            putc(scan_to_ascii[scan_code][0]);
-            get_char(scan_to_ascii[scan_code][0]);
-        //Ctrl-l for clearing the screen
-        } else if((ctrl_flag > 0) && (scan_to_ascii[scan_code][0] == 'l')){
-            clear();
-        //Deterimes if there are still enough characters for a backspace.
-        } else if(scan_to_ascii[scan_code][0] == BCKSPACE){
-            if(num_char > 0){
-                putc(scan_to_ascii[scan_code][0]);
-                get_char(scan_to_ascii[scan_code][0]);
-                --num_char;
-            }
-        //Outputs the shifted versions of the keys pressed.
-    } else if((l_shift_flag || r_shift_flag) && (num_char < BUFFER_MAX)) {
-            //If CAPS is active the letters are made to be lower case
-            if(caps_flag &&
-               (((scan_code >= Q_UP_LIMIT) && (scan_code <= P_LOW_LIMIT)) ||
-               ((scan_code >= A_UP_LIMIT) && (scan_code <= L_LOW_LIMIT)) ||
-               ((scan_code >= Z_UP_LIMIT) && (scan_code <= M_LOW_LIMIT))) ){
-                putc(scan_to_ascii[scan_code][0]);
-                get_char(scan_to_ascii[scan_code][0]);
-                ++num_char;
-            }
-            //Otherwise the shifted versions are outputted
-            else{
-                putc(scan_to_ascii[scan_code][1]);
-                get_char(scan_to_ascii[scan_code][1]);
-                ++num_char;
-            }
-        //Prints out the captialized version if necessary to the screen
-    } else if(caps_flag && (num_char < BUFFER_MAX)){
-            if(((scan_code >= Q_UP_LIMIT) && (scan_code <= P_LOW_LIMIT)) ||
-               ((scan_code >= A_UP_LIMIT) && (scan_code <= L_LOW_LIMIT)) ||
-               ((scan_code >= Z_UP_LIMIT) && (scan_code <= M_LOW_LIMIT))){
-                putc(scan_to_ascii[scan_code][1]);
-                get_char(scan_to_ascii[scan_code][1]);
-                ++num_char;
-            }
-            //If it is not a letter it is printed as is.
-            else{
-                putc(scan_to_ascii[scan_code][0]);
-                get_char(scan_to_ascii[scan_code][0]);
-                ++num_char;
-            }
-        } else if(num_char < BUFFER_MAX){
-            putc(scan_to_ascii[scan_code][0]);
-            get_char(scan_to_ascii[scan_code][0]);
-            ++num_char;
-        }
+    index = extended | (scan_code & SCANCODE_MASK);
+    extended = 0;
+
+    if(!check_for_modifier(index, scan_code & RELEASE_OFFSET) &&
+       !(scan_code & RELEASE_OFFSET)) {             // ignore released output from keyboard
+        key = active_map[index];
+        if(key != 0x0)
+            handle_key(key);
     }
 
     send_eoi(KEYBOARD_IRQ_NUM);
-    sti();
+    spin_unlock_irqrestore(&keyboard_lock, flags);
+}
+
+/* static void handle_key(char key);
+ * Inputs: key - decoded character or KEY_* code
+ * Return Value: none
+ * Function: handle keyboard shortcuts and pass everything else to the terminal,
+ *           which does the echo and line editing */
+static void handle_key(char key) {
+    uint32_t pid;
+
+    //Ctrl-l for clearing the screen
+    if((mod_flags & MOD_CTRL) && (key == 'l' || key == 'L')){
+        clear();
+        return;
+    }
+    //Ctrl-c interrupts the foreground program, never the base shell. It
+    //dies the next time it heads back to user mode.
+    if((mod_flags & MOD_CTRL) && (key == 'c' || key == 'C')){
+        pid = sched_foreground();
+        if(pid != 0){
+            puts("^C\n");
+            signal_send(pid, INTERRUPT);
+        }
+        return;
+    }
+    get_char(key);
 }
 
-/* uint8_t check_for_modifier(uint8_t scan_code)
- * Inputs: scan_code - Index of scan code sent from keyboard
+/* uint8_t check_for_modifier(uint8_t index, uint8_t released)
+ * Inputs: index    - decode table index (make code, extended keys offset by 0x80)
+ *         released - nonzero if this was a break code
  * Return Value: 1 if modifier found, 0 otherwise
- * Function: Check if scan_code is a modifier key and update global flags */
-uint8_t check_for_modifier(uint8_t scan_code) {
-    switch(scan_code)
-    {
-    //For both shift cases (uses different codes)
-    case LEFT_SHIFT_PRESS:
-        l_shift_flag = 1;
-        return 1;
-    case LEFT_SHIFT_RELEASE:
-        l_shift_flag = 0;
-        return 1;
-    case RIGHT_SHIFT_PRESS:
-        r_shift_flag = 1;
-        return 1;
-    case RIGHT_SHIFT_RELEASE:
-        r_shift_flag = 0;
-        return 1;
-    //Accounts for both right and left (uses same scan code)
-    case CTRL_PRESS:
-        ctrl_flag += 1;
-        return 1;
-    case CTRL_RELEASE:
-        ctrl_flag -= 1;
-        return 1;
-    //For when the caps key is on or off.
-    case CAPS_PRESS:
-        if(caps_flag == 1)
-          caps_flag = 0;
-        else
-          caps_flag = 1;
-        return 1;
-    default:
+ * Function: Check if index is a modifier key, update mod_flags and select the decode table */
+uint8_t check_for_modifier(uint8_t index, uint8_t released) {
+    uint8_t bit = modifier_map[index];
+
+    if(bit == 0)
         return 0;
+
+    //Caps lock toggles on press, everything else follows the key
+    if(bit == MOD_CAPS) {
+        if(!released)
+            mod_flags ^= MOD_CAPS;
+    } else if(released) {
+        mod_flags &= ~bit;
+    } else {
+        mod_flags |= bit;
     }
+
+    active_map = keymap[((mod_flags & MOD_SHIFT) ? MAP_SHIFT : MAP_PLAIN) |
+                        ((mod_flags & MOD_CAPS) ? MAP_CAPS : MAP_PLAIN)];
+    return 1;
 }
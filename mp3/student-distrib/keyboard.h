@@ -8,6 +8,16 @@
 
 #include "types.h"
 
+/* Key codes handed to the terminal for keys that have no printable character.
+ * They sit in the unused C0 control range so they fit in a char buffer. */
+#define KEY_UP              (0x11)
+#define KEY_DOWN            (0x12)
+#define KEY_LEFT            (0x13)
+#define KEY_RIGHT           (0x14)
+#define KEY_HOME            (0x15)
+#define KEY_END             (0x16)
+#define KEY_DELETE          (0x7F)
+
 /* initialize keyboard by enabling irq 1 in pic */
 void keyboard_init(void);
 
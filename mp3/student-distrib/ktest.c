@@ -0,0 +1,129 @@
+/* ktest.c - Test and benchmark results in a form a script can read
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ktest.h"
+#include "lib.h"
+#include "serial.h"
+
+#define KTEST_LINE_SIZE     160
+#define KTEST_WORD          "ktest"
+
+uint32_t ktest_mode = 0;
+
+static uint32_t ktest_tests = 0;
+static uint32_t ktest_failed = 0;
+static uint32_t ktest_samples[KTEST_MAX_ITERS];
+
+/* static void ktest_send(const int8_t* line);
+ * Inputs: line - NULL terminated JSON object, without the newline
+ * Return Value: none
+ * Function: writes the line and a newline to the debug port. Without a
+ *           debug console behind it the port just ignores the bytes. With
+ *           the serial console on the line goes out on ttyS0 as well. */
+static void ktest_send(const int8_t* line) {
+    const int8_t* c;
+
+    for (c = line; *c != '\0'; c++)
+        outb(*c, KTEST_PORT);
+    outb('\n', KTEST_PORT);
+    if (serial_console) {
+        serial_write(line, c - line);
+        serial_write("\n", 1);
+    }
+}
+
+/* void ktest_parse_cmdline(const int8_t* cmdline);
+ * Inputs: cmdline - kernel command line, space separated words
+ * Return Value: none */
+void ktest_parse_cmdline(const int8_t* cmdline) {
+    ktest_mode = cmdline_has(cmdline, KTEST_WORD);
+}
+
+/* void ktest_result(const int8_t* name, int32_t pass);
+ * Inputs: name - test name, used as is inside the JSON string
+ *         pass - nonzero if the test passed
+ * Return Value: none */
+void ktest_result(const int8_t* name, int32_t pass) {
+    int8_t line[KTEST_LINE_SIZE];
+
+    printf("[TEST %s] Result = %s\n", name, pass ? "PASS" : "FAIL");
+    ktest_tests++;
+    if (!pass)
+        ktest_failed++;
+
+    snprintf(line, sizeof(line), "{\"type\":\"test\",\"name\":\"%s\",\"result\":\"%s\"}",
+             name, pass ? "pass" : "fail");
+    ktest_send(line);
+}
+
+/* void ktest_bench(const int8_t* name, ktest_bench_fn fn, uint32_t iters, uint32_t warmup);
+ * Inputs: name - benchmark name, used as is inside the JSON string
+ *         fn - one iteration
+ *         iters - timed iterations
+ *         warmup - untimed iterations run first, to fill caches and TLB
+ * Return Value: none
+ * Function: The median is what a regression check should compare, one
+ *           interrupt landing in an iteration only moves the max. */
+void ktest_bench(const int8_t* name, ktest_bench_fn fn, uint32_t iters, uint32_t warmup) {
+    int8_t line[KTEST_LINE_SIZE];
+    uint32_t i, j, start, sample;
+
+    if (iters == 0)
+        return;
+    if (iters > KTEST_MAX_ITERS)
+        iters = KTEST_MAX_ITERS;
+
+    for (i = 0; i < warmup; i++)
+        fn();
+    for (i = 0; i < iters; i++) {
+        start = rdtsc();
+        fn();
+        ktest_samples[i] = rdtsc() - start;
+    }
+
+    //Insertion sort, a few hundred samples at most
+    for (i = 1; i < iters; i++) {
+        sample = ktest_samples[i];
+        for (j = i; j > 0 && ktest_samples[j - 1] > sample; j--)
+            ktest_samples[j] = ktest_samples[j - 1];
+        ktest_samples[j] = sample;
+    }
+
+    printf("[BENCH %s] median %u cycles\n", name, ktest_samples[iters / 2]);
+    snprintf(line, sizeof(line),
+             "{\"type\":\"bench\",\"name\":\"%s\",\"iters\":%u,\"warmup\":%u,"
+             "\"min\":%u,\"median\":%u,\"max\":%u}",
+             name, iters, warmup, ktest_samples[0], ktest_samples[iters / 2],
+             ktest_samples[iters - 1]);
+    ktest_send(line);
+}
+
+/* void ktest_boot(const int8_t* stage, uint32_t cycles, uint32_t us);
+ * Inputs: stage - stage name, used as is inside the JSON string
+ *         cycles - TSC cycles the stage took
+ *         us - microseconds from entry() to the end of the stage
+ * Return Value: none */
+void ktest_boot(const int8_t* stage, uint32_t cycles, uint32_t us) {
+    int8_t line[KTEST_LINE_SIZE];
+
+    snprintf(line, sizeof(line), "{\"type\":\"boot\",\"stage\":\"%s\",\"cycles\":%u,\"us\":%u}",
+             stage, cycles, us);
+    ktest_send(line);
+}
+
+/* void ktest_finish(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: QEMU exits with (value << 1) | 1 on a write to the exit port.
+ *           Outside ktest_mode, or without the device, the kernel goes on. */
+void ktest_finish(void) {
+    int8_t line[KTEST_LINE_SIZE];
+
+    snprintf(line, sizeof(line), "{\"type\":\"done\",\"tests\":%u,\"failed\":%u}",
+             ktest_tests, ktest_failed);
+    ktest_send(line);
+    serial_flush();
+    if (ktest_mode)
+        outb(ktest_failed ? 1 : 0, KTEST_EXIT_PORT);
+}
@@ -0,0 +1,41 @@
+/* ktest.h - Test and benchmark results in a form a script can read
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _KTEST_H
+#define _KTEST_H
+
+#include "types.h"
+
+#define KTEST_PORT          0xE9    // QEMU -debugcon, one byte per outb
+#define KTEST_EXIT_PORT     0xF4    // QEMU -device isa-debug-exit,iobase=0xf4
+#define KTEST_MAX_ITERS     256     // samples kept per benchmark
+
+/* Set when the kernel command line holds the word "ktest": the tests and
+ * benchmarks run at boot and QEMU exits when they are done */
+extern uint32_t ktest_mode;
+
+/* One benchmark iteration, timed as a whole */
+typedef void (*ktest_bench_fn)(void);
+
+/* Sets ktest_mode from the multiboot command line, NULL if there is none */
+void ktest_parse_cmdline(const int8_t* cmdline);
+
+/* Prints a test's result on screen and sends it as a JSON line:
+ * {"type":"test","name":...,"result":"pass"|"fail"} */
+void ktest_result(const int8_t* name, int32_t pass);
+
+/* Runs fn warmup times untimed, then iters times (at most KTEST_MAX_ITERS)
+ * under rdtsc, and sends the cycle counts as a JSON line:
+ * {"type":"bench","name":...,"iters":n,"warmup":n,"min":n,"median":n,"max":n} */
+void ktest_bench(const int8_t* name, ktest_bench_fn fn, uint32_t iters, uint32_t warmup);
+
+/* Sends one boot stage as {"type":"boot","stage":...,"cycles":n,"us":n},
+ * us being the time from entry() to the end of the stage */
+void ktest_boot(const int8_t* stage, uint32_t cycles, uint32_t us);
+
+/* Sends {"type":"done","tests":n,"failed":n} and, in ktest_mode, exits
+ * QEMU with status 1 if every test passed and 3 otherwise */
+void ktest_finish(void);
+
+#endif /* _KTEST_H */
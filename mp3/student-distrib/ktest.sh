@@ -0,0 +1,108 @@
+#!/bin/bash
+# Boots ./bootimg headless in QEMU with "ktest" on the kernel command line
+# and collects the JSON lines the kernel writes to port 0xE9 (see ktest.h).
+#
+# usage: ./ktest.sh [-b baseline.jsonl] [-t percent] [-o results.jsonl]
+#
+#   -b  compare every benchmark's median, and the boot time, with the
+#       same numbers in a results file saved by an earlier run
+#   -t  allowed slowdown against the baseline, default 10 percent
+#   -o  where to keep the results, default ktest.jsonl
+#
+# Exits 1 if a test failed, the kernel never finished, or a benchmark
+# regressed. QEMU, its timeout and extra options come from $QEMU,
+# $KTEST_TIMEOUT (seconds) and $QEMU_ARGS, e.g. QEMU_ARGS="-smp 4".
+# $KTEST_CMDLINE adds kernel command line words: KTEST_CMDLINE=serial
+# with QEMU_ARGS="-serial file:serial.log" also captures the console.
+# KTEST_CMDLINE=disk with QEMU_ARGS="-hda filesys_img" runs everything with
+# the file system read from the IDE disk.
+
+QEMU=${QEMU:-qemu-system-i386}
+KTEST_TIMEOUT=${KTEST_TIMEOUT:-120}
+BASELINE=
+PERCENT=10
+RESULTS=ktest.jsonl
+
+while getopts "b:t:o:" opt; do
+    case $opt in
+        b) BASELINE=$OPTARG ;;
+        t) PERCENT=$OPTARG ;;
+        o) RESULTS=$OPTARG ;;
+        *) echo "usage: $0 [-b baseline.jsonl] [-t percent] [-o results.jsonl]"
+           exit 1 ;;
+    esac
+done
+
+if [ ! -f ./bootimg ] || [ ! -f ./filesys_img ]; then
+    echo "ktest: run make first, bootimg and filesys_img are needed"
+    exit 1
+fi
+
+rm -f "$RESULTS"
+# The filesystem goes in as the first multiboot module, like GRUB loads it
+timeout "$KTEST_TIMEOUT" "$QEMU" -kernel ./bootimg -append "ktest $KTEST_CMDLINE" \
+    -initrd ./filesys_img -m 256 -display none -no-reboot \
+    -debugcon file:"$RESULTS" \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04 $QEMU_ARGS
+status=$?
+
+# isa-debug-exit makes QEMU exit with (value << 1) | 1
+if ! grep -q '"type":"done"' "$RESULTS" 2>/dev/null; then
+    echo "ktest: the kernel did not finish (qemu exit status $status)"
+    exit 1
+fi
+
+awk -v baseline="$BASELINE" -v percent="$PERCENT" '
+    function field(line, key,    m) {
+        if (match(line, "\"" key "\":\"?[^\",}]*")) {
+            m = substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 3)
+            sub(/^"/, "", m)
+            return m
+        }
+        return ""
+    }
+    BEGIN {
+        if (baseline != "") {
+            while ((getline line < baseline) > 0) {
+                if (field(line, "type") == "bench")
+                    base[field(line, "name")] = field(line, "median") + 0
+                if (field(line, "type") == "boot")
+                    base_boot = field(line, "us") + 0
+            }
+        }
+        bad = 0
+    }
+    field($0, "type") == "test" && field($0, "result") != "pass" {
+        print "FAIL   " field($0, "name")
+        bad = 1
+    }
+    field($0, "type") == "bench" {
+        name = field($0, "name")
+        median = field($0, "median") + 0
+        if (name in base && median > base[name] * (100 + percent) / 100) {
+            printf "SLOWER %s: %d cycles, baseline %d\n", name, median, base[name]
+            bad = 1
+        } else {
+            printf "bench  %s: %d cycles\n", name, median
+        }
+    }
+    # The last stage stamped before the tests is the end of the boot
+    field($0, "type") == "boot" {
+        boot_stage = field($0, "stage")
+        boot_us = field($0, "us") + 0
+    }
+    field($0, "type") == "done" {
+        printf "%d tests, %d failed\n", field($0, "tests"), field($0, "failed")
+    }
+    END {
+        if (boot_stage != "") {
+            if (base_boot && boot_us > base_boot * (100 + percent) / 100) {
+                printf "SLOWER boot: %d us to %s, baseline %d\n", boot_us, boot_stage, base_boot
+                bad = 1
+            } else {
+                printf "boot   %d us to %s\n", boot_us, boot_stage
+            }
+        }
+        exit bad
+    }
+' "$RESULTS"
@@ -2,22 +2,75 @@
  * vim:ts=4 noexpandtab */
 
 #include "lib.h"
+#include "spinlock.h"
+#include "serial.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #define ATTRIB      0x7
 
+#define WORD_SIZE   4
+#define WORD_MASK   (WORD_SIZE - 1)
+/* Nonzero if any byte of the 32-bit word x is zero */
+#define HAS_ZERO_BYTE(x)    (((x) - 0x01010101) & ~(x) & 0x80808080)
+
+#define CPUID_FXSR      0x01000000  /* CPUID 1 EDX: fxsave/fxrstor */
+#define CPUID_SSE2      0x04000000  /* CPUID 1 EDX: SSE2 */
+#define CR0_MP          0x00000002
+#define CR0_EM          0x00000004
+#define CR4_OSFXSR      0x00000200
+#define CR4_OSXMMEXCPT  0x00000400
+#define SSE2_COPY_MIN   512         /* smaller copies stay on rep movsl */
+
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
 
+/* Guards screen_x/screen_y and video memory. Output comes from both
+ * syscalls and the keyboard interrupt. */
+static spinlock_t console_lock = SPINLOCK_INIT("console");
+
+static void console_putc(uint8_t c);
+
+/* Set by lib_init once the CPU is set up to run SSE2 instructions */
+static uint32_t sse2_enabled;
+
+/* void lib_init(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: Picks the memcpy used for large copies. If CPUID reports SSE2,
+ *           turns on SSE in CR0/CR4 and lets memcpy use it. */
+void lib_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t cr;
+
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(1)
+    );
+    if ((edx & (CPUID_FXSR | CPUID_SSE2)) != (CPUID_FXSR | CPUID_SSE2))
+        return;
+
+    asm volatile ("movl %%cr0, %0" : "=r"(cr));
+    cr = (cr & ~CR0_EM) | CR0_MP;
+    asm volatile ("movl %0, %%cr0" : : "r"(cr));
+    asm volatile ("movl %%cr4, %0" : "=r"(cr));
+    cr |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile ("movl %0, %%cr4" : : "r"(cr));
+
+    sse2_enabled = 1;
+}
+
 /* void clear(void);
  * Inputs: void
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
     int32_t i;
+    uint32_t flags;
+
+    spin_lock_irqsave(&console_lock, flags);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
         *(uint8_t *)(video_mem + (i << 1)) = ' ';
         *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
@@ -25,6 +78,7 @@ void clear(void) {
     screen_x = 0;
     screen_y = 0;
     update_cursor();
+    spin_unlock_irqrestore(&console_lock, flags);
 }
 
 /* void update_cursor(void);
@@ -43,92 +97,151 @@ void update_cursor(void) {
     outb((uint8_t) (pos & 0xFF), 0x3D5);
 }
 
-/* Standard printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output. */
-int32_t printf(int8_t *format, ...) {
+/* void move_cursor(int32_t offset);
+ * Inputs: offset = number of character cells to move, negative moves back
+ * Return Value: none
+ * Function: Moves the print location without printing anything, wrapping
+ * between rows. The location is kept on the screen. */
+void move_cursor(int32_t offset) {
+    int32_t pos;
+    uint32_t flags;
+
+    spin_lock_irqsave(&console_lock, flags);
+    pos = screen_y * NUM_COLS + screen_x + offset;
+
+    if(pos < 0)
+        pos = 0;
+    if(pos >= NUM_ROWS * NUM_COLS)
+        pos = NUM_ROWS * NUM_COLS - 1;
+
+    screen_x = pos % NUM_COLS;
+    screen_y = pos / NUM_COLS;
+    update_cursor();
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
+/* Where the formatter sends its characters. printf flushes the buffer
+ * to the console whenever it fills, snprintf drops what does not fit. */
+typedef struct fmt_out {
+    int8_t* buf;
+    int32_t size;               /* characters buf can take */
+    int32_t pos;                /* characters in buf now */
+    int32_t total;              /* characters produced so far */
+    int32_t to_console;         /* flush to the console instead of dropping */
+} fmt_out_t;
+
+#define PRINTF_BUF_SIZE 256     /* on the stack, so keep it modest */
+#define CONSOLE_CHUNK   128     /* console_write's stack copy */
+
+/* static void fmt_putc(fmt_out_t* out, int8_t c);
+ * Inputs: out = destination
+ *         c = character to add
+ * Return Value: none
+ * Function: Adds one character to the output buffer */
+static void fmt_putc(fmt_out_t* out, int8_t c) {
+    if (out->pos == out->size) {
+        if (!out->to_console)
+            return;
+        console_write(out->buf, out->pos);
+        out->pos = 0;
+    }
+    out->buf[out->pos++] = c;
+    out->total++;
+}
+
+/* static void fmt_field(fmt_out_t* out, const int8_t* s, int32_t width,
+ *                       int32_t left, int8_t pad);
+ * Inputs: out = destination
+ *         s = converted text
+ *         width = minimum field width
+ *         left = nonzero to left-justify
+ *         pad = fill character for right-justified fields
+ * Return Value: none
+ * Function: Adds s padded out to width characters */
+static void fmt_field(fmt_out_t* out, const int8_t* s, int32_t width, int32_t left, int8_t pad) {
+    int32_t len = strlen(s);
+
+    if (!left) {
+        /* Zero padding goes after the sign */
+        if (pad == '0' && *s == '-') {
+            fmt_putc(out, *s++);
+            width--;
+            len--;
+        }
+        for (; width > len; width--)
+            fmt_putc(out, pad);
+    }
+    while (*s != '\0')
+        fmt_putc(out, *s++);
+    for (; width > len; width--)
+        fmt_putc(out, ' ');
+}
+
+/* static void fmt_format(fmt_out_t* out, int8_t* format, int32_t* esp);
+ * Inputs: out = destination
+ *         format = format string, see printf
+ *         esp = first argument after the format string on the stack
+ * Return Value: none
+ * Function: The formatter shared by printf and snprintf */
+static void fmt_format(fmt_out_t* out, int8_t* format, int32_t* esp) {
 
     /* Pointer to the format string */
     int8_t* buf = format;
 
-    /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
-
     while (*buf != '\0') {
         switch (*buf) {
             case '%':
                 {
                     int32_t alternate = 0;
+                    int32_t left = 0;
+                    int32_t width = 0;
+                    int8_t pad = ' ';
+                    int8_t conv_buf[36];
                     buf++;
 
-format_char_switch:
+                    /* Flags, then an optional field width */
+                    for (;; buf++) {
+                        if (*buf == '#')
+                            alternate = 1;
+                        else if (*buf == '-')
+                            left = 1;
+                        else if (*buf == '0')
+                            pad = '0';
+                        else
+                            break;
+                    }
+                    for (; *buf >= '0' && *buf <= '9'; buf++)
+                        width = width * 10 + (*buf - '0');
+
                     /* Conversion specifiers */
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            fmt_putc(out, '%');
                             break;
 
-                        /* Use alternate formatting */
-                        case '#':
-                            alternate = 1;
-                            buf++;
-                            /* Yes, I know gotos are bad.  This is the
-                             * most elegant and general way to do this,
-                             * IMHO. */
-                            goto format_char_switch;
-
                         /* Print a number in hexadecimal form */
                         case 'x':
-                            {
-                                int8_t conv_buf[64];
-                                if (alternate == 0) {
-                                    itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
-                                } else {
-                                    int32_t starting_index;
-                                    int32_t i;
-                                    itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-                                    i = starting_index = strlen(&conv_buf[8]);
-                                    while(i < 8) {
-                                        conv_buf[i] = '0';
-                                        i++;
-                                    }
-                                    puts(&conv_buf[starting_index]);
-                                }
-                                esp++;
+                            itoa(*((uint32_t *)esp), conv_buf, 16);
+                            if (alternate) {
+                                width = 8;
+                                pad = '0';
+                                left = 0;
                             }
+                            fmt_field(out, conv_buf, width, left, pad);
+                            esp++;
                             break;
 
                         /* Print a number in unsigned int form */
                         case 'u':
-                            {
-                                int8_t conv_buf[36];
-                                itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
-                                esp++;
-                            }
+                            itoa(*((uint32_t *)esp), conv_buf, 10);
+                            fmt_field(out, conv_buf, width, left, pad);
+                            esp++;
                             break;
 
                         /* Print a number in signed int form */
                         case 'd':
                             {
-                                int8_t conv_buf[36];
                                 int32_t value = *((int32_t *)esp);
                                 if(value < 0) {
                                     conv_buf[0] = '-';
@@ -136,24 +249,29 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                fmt_field(out, conv_buf, width, left, pad);
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            conv_buf[0] = (int8_t) *((int32_t *)esp);
+                            conv_buf[1] = '\0';
+                            fmt_field(out, conv_buf, width, left, ' ');
                             esp++;
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            fmt_field(out, *((int8_t **)esp), width, left, ' ');
                             esp++;
                             break;
 
                         default:
+                            /* Don't walk off the end of the format */
+                            if (*buf == '\0')
+                                buf--;
                             break;
                     }
 
@@ -161,12 +279,69 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                fmt_putc(out, *buf);
                 break;
         }
         buf++;
     }
-    return (buf - format);
+}
+
+/* Standard printf().
+ * Only supports the following format strings:
+ * %%  - print a literal '%' character
+ * %x  - print a number in hexadecimal
+ * %u  - print a number as an unsigned integer
+ * %d  - print a number as a signed integer
+ * %c  - print a character
+ * %s  - print a string
+ * %#x - print a number in 32-bit aligned hexadecimal, i.e.
+ *       print 8 hexadecimal digits, zero-padded on the left.
+ *       For example, the hex number "E" would be printed as
+ *       "0000000E".
+ *       Note: This is slightly different than the libc specification
+ *       for the "#" modifier (this implementation doesn't add a "0x" at
+ *       the beginning), but I think it's more flexible this way.
+ *       Also note: %x is the only conversion specifier that can use
+ *       the "#" modifier to alter output.
+ * A field width may come before the conversion, e.g. %8u. It can be
+ * preceded by '-' to left-justify or '0' to pad numbers with zeros.
+ *
+ * The text is built in a buffer on the stack and written to the console
+ * in one go, so the cursor is only moved once per call. */
+int32_t printf(int8_t *format, ...) {
+    int8_t buf[PRINTF_BUF_SIZE];
+    fmt_out_t out = { buf, PRINTF_BUF_SIZE, 0, 0, 1 };
+
+    /* Stack pointer for the other parameters */
+    int32_t* esp = (void *)&format;
+    esp++;
+
+    fmt_format(&out, format, esp);
+    console_write(buf, out.pos);
+    return out.total;
+}
+
+/* int32_t snprintf(int8_t* buf, int32_t size, int8_t* format, ...);
+ * Inputs: buf = destination for the text
+ *         size = size of buf, including room for the NULL
+ *         format = format string, as for printf
+ * Return Value: number of characters stored, not counting the NULL
+ * Function: printf into a buffer. Output that does not fit is dropped and
+ *           buf is always NULL terminated when size > 0. Unlike the libc
+ *           version the return value never exceeds size - 1, so calls can
+ *           be chained with len += snprintf(buf + len, size - len, ...). */
+int32_t snprintf(int8_t* buf, int32_t size, int8_t* format, ...) {
+    fmt_out_t out = { buf, size - 1, 0, 0, 0 };
+
+    /* Stack pointer for the other parameters */
+    int32_t* esp = (void *)&format;
+    esp++;
+
+    if (size <= 0)
+        return 0;
+    fmt_format(&out, format, esp);
+    buf[out.pos] = '\0';
+    return out.pos;
 }
 
 /* int32_t puts(int8_t* s);
@@ -174,12 +349,44 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
+    int32_t len = strlen(s);
+    console_write(s, len);
+    return len;
+}
+
+/* void console_write(const int8_t* s, int32_t n);
+ * Inputs: s = characters to print, may be a user buffer
+ *         n = number of characters
+ * Return Value: none
+ * Function: Prints n characters, CONSOLE_CHUNK at a time. Each chunk is
+ *           copied to the stack first with interrupts on, so a user page
+ *           can fault in, and then printed under one hold of the console
+ *           lock, so interrupts are only held off for a short chunk. The
+ *           cursor moves once per chunk. NULL characters are skipped. */
+void console_write(const int8_t* s, int32_t n) {
+    int8_t chunk[CONSOLE_CHUNK];
+    int32_t len;
+    int32_t i;
+    uint32_t flags;
+
+    while (n > 0) {
+        len = 0;
+        for (i = 0; i < n && i < CONSOLE_CHUNK; i++) {
+            if (s[i] != '\0')
+                chunk[len++] = s[i];
+        }
+        s += i;
+        n -= i;
+
+        spin_lock_irqsave(&console_lock, flags);
+        for (i = 0; i < len; i++)
+            console_putc(chunk[i]);
+        update_cursor();
+        spin_unlock_irqrestore(&console_lock, flags);
+
+        if (serial_console)
+            serial_write(chunk, len);
     }
-    return index;
 }
 
 /* void putc(uint8_t c);
@@ -187,6 +394,23 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  * Function: Output a character to the console */
 void putc(uint8_t c) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&console_lock, flags);
+    console_putc(c);
+    update_cursor();    //Put the cursor at the next print location.
+    spin_unlock_irqrestore(&console_lock, flags);
+
+    if (serial_console)
+        serial_write((int8_t*)&c, 1);
+}
+
+/* static void console_putc(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ * Return Value: void
+ * Function: Puts a character on the screen and scrolls if needed. The
+ *           caller holds console_lock and updates the cursor. */
+static void console_putc(uint8_t c) {
     if(c == '\n' || c == '\r') {    //Scrolling with newline
         //For scrolling when at the bottom of the screen.
         if(screen_y == (NUM_ROWS - 1)) {
@@ -255,8 +479,6 @@ void putc(uint8_t c) {
         screen_x %= NUM_COLS;
         screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
     }
-
-    update_cursor();    //Put the cursor at the next print location.
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -319,12 +541,20 @@ int8_t* strrev(int8_t* s) {
 /* uint32_t strlen(const int8_t* s);
  * Inputs: const int8_t* s = string to take length of
  * Return Value: length of string s
- * Function: return length of string s */
+ * Function: return length of string s. Once s is aligned it is scanned a
+ *           word at a time; an aligned word never crosses a page, so the
+ *           bytes read past the terminator are always mapped. */
 uint32_t strlen(const int8_t* s) {
-    register uint32_t len = 0;
-    while (s[len] != '\0')
-        len++;
-    return len;
+    const int8_t* p = s;
+    const uint32_t* w;
+
+    for (; ((uint32_t)p & WORD_MASK) != 0; p++) {
+        if (*p == '\0')
+            return p - s;
+    }
+    for (w = (const uint32_t*)p; !HAS_ZERO_BYTE(*w); w++);
+    for (p = (const int8_t*)w; *p != '\0'; p++);
+    return p - s;
 }
 
 /* void* memset(void* s, int32_t c, uint32_t n);
@@ -410,13 +640,13 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
     return s;
 }
 
-/* void* memcpy(void* dest, const void* src, uint32_t n);
+/* static void memcpy_rep(void* dest, const void* src, uint32_t n);
  * Inputs:      void* dest = destination of copy
  *         const void* src = source of copy
  *              uint32_t n = number of byets to copy
- * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
-void* memcpy(void* dest, const void* src, uint32_t n) {
+ * Return Value: none
+ * Function: copy n bytes of src to dest with rep movsl once dest is aligned */
+static void memcpy_rep(void* dest, const void* src, uint32_t n) {
     asm volatile ("                 \n\
             .memcpy_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -452,6 +682,74 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
             : "S"(src), "D"(dest), "c"(n)
             : "eax", "edx", "memory", "cc"
     );
+}
+
+/* static void memcpy_sse2(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy, at least SSE2_COPY_MIN
+ * Return Value: none
+ * Function: copy 64 bytes per iteration through xmm0-xmm3 with aligned
+ *           stores. Nothing saves the xmm registers on a switch, so the ones
+ *           used are saved and restored here, with interrupts off so that a
+ *           handler's memcpy cannot clobber them halfway through. */
+static void memcpy_sse2(void* dest, const void* src, uint32_t n) {
+    uint8_t xmm_save[64];
+    uint32_t head = (-(uint32_t)dest) & 0xF;
+    uint32_t blocks;
+    uint32_t flags;
+
+    memcpy_rep(dest, src, head);
+    dest = (uint8_t*)dest + head;
+    src = (const uint8_t*)src + head;
+    n -= head;
+    blocks = n >> 6;
+
+    cli_and_save(flags);
+    asm volatile ("                         \n\
+            movdqu  %%xmm0, 0(%3)           \n\
+            movdqu  %%xmm1, 16(%3)          \n\
+            movdqu  %%xmm2, 32(%3)          \n\
+            movdqu  %%xmm3, 48(%3)          \n\
+            .memcpy_sse2_top:               \n\
+            movdqu  0(%1), %%xmm0           \n\
+            movdqu  16(%1), %%xmm1          \n\
+            movdqu  32(%1), %%xmm2          \n\
+            movdqu  48(%1), %%xmm3          \n\
+            movdqa  %%xmm0, 0(%0)           \n\
+            movdqa  %%xmm1, 16(%0)          \n\
+            movdqa  %%xmm2, 32(%0)          \n\
+            movdqa  %%xmm3, 48(%0)          \n\
+            addl    $64, %1                 \n\
+            addl    $64, %0                 \n\
+            subl    $1, %2                  \n\
+            jnz     .memcpy_sse2_top        \n\
+            movdqu  0(%3), %%xmm0           \n\
+            movdqu  16(%3), %%xmm1          \n\
+            movdqu  32(%3), %%xmm2          \n\
+            movdqu  48(%3), %%xmm3          \n\
+            "
+            : "+r"(dest), "+r"(src), "+r"(blocks)
+            : "r"(xmm_save)
+            : "memory", "cc"
+    );
+    restore_flags(flags);
+
+    memcpy_rep(dest, src, n & 0x3F);
+}
+
+/* void* memcpy(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest, using SSE2 for large copies when
+ *           lib_init found it */
+void* memcpy(void* dest, const void* src, uint32_t n) {
+    if (sse2_enabled && n >= SSE2_COPY_MIN)
+        memcpy_sse2(dest, src, n);
+    else
+        memcpy_rep(dest, src, n);
     return dest;
 }
 
@@ -463,20 +761,32 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
  * Return Value: pointer to dest
  * Function: move n bytes of src to dest */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    uint32_t edi, esi, ecx;
+
+    /* Copying forward is safe unless dest starts inside src */
+    if ((uint32_t)dest <= (uint32_t)src || (uint32_t)dest >= (uint32_t)src + n)
+        return memcpy(dest, src, n);
+
+    /* Backward: the odd tail bytes first, then whole words. The direction
+     * flag must be clear again before returning to C code. */
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
-            cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
+            movl    %%ecx, %%edx                \n\
+            andl    $0x3, %%ecx                 \n\
+            shrl    $2, %%edx                   \n\
             std                                 \n\
-            .memmove_go:                        \n\
             rep     movsb                       \n\
+            subl    $3, %%esi                   \n\
+            subl    $3, %%edi                   \n\
+            movl    %%edx, %%ecx                \n\
+            rep     movsl                       \n\
+            cld                                 \n\
             "
-            :
-            : "D"(dest), "S"(src), "c"(n)
+            : "=&D"(edi), "=&S"(esi), "=&c"(ecx)
+            : "0"(dest), "1"(src), "2"(n)
             : "edx", "memory", "cc"
     );
     return dest;
@@ -494,8 +804,23 @@ void* memmove(void* dest, const void* src, uint32_t n) {
  *               indicates the opposite.
  * Function: compares string 1 and string 2 for equality */
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
-    int32_t i;
-    for (i = 0; i < n; i++) {
+    uint32_t i = 0;
+
+    /* Skip equal words while both strings are aligned the same way. The
+     * byte loop below sorts out the word that differs or ends. */
+    if ((((uint32_t)s1 ^ (uint32_t)s2) & WORD_MASK) == 0) {
+        for (; i < n && (((uint32_t)s1 + i) & WORD_MASK) != 0; i++) {
+            if ((s1[i] != s2[i]) || (s1[i] == '\0'))
+                return s1[i] - s2[i];
+        }
+        for (; n - i >= WORD_SIZE; i += WORD_SIZE) {
+            uint32_t w = *(const uint32_t*)(s1 + i);
+            if (w != *(const uint32_t*)(s2 + i) || HAS_ZERO_BYTE(w))
+                break;
+        }
+    }
+
+    for (; i < n; i++) {
         if ((s1[i] != s2[i]) || (s1[i] == '\0') /* || s2[i] == '\0' */) {
 
             /* The s2[i] == '\0' is unnecessary because of the short-circuit
@@ -515,7 +840,21 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
  * Return Value: pointer to dest
  * Function: copy the source string into the destination string */
 int8_t* strcpy(int8_t* dest, const int8_t* src) {
-    int32_t i = 0;
+    uint32_t i = 0;
+
+    /* Align src, then move whole words until one holds the terminator.
+     * x86 allows the unaligned stores to dest. */
+    for (; (((uint32_t)src + i) & WORD_MASK) != 0; i++) {
+        if ((dest[i] = src[i]) == '\0')
+            return dest;
+    }
+    for (;; i += WORD_SIZE) {
+        uint32_t w = *(const uint32_t*)(src + i);
+        if (HAS_ZERO_BYTE(w))
+            break;
+        *(uint32_t*)(dest + i) = w;
+    }
+
     while (src[i] != '\0') {
         dest[i] = src[i];
         i++;
@@ -531,18 +870,51 @@ int8_t* strcpy(int8_t* dest, const int8_t* src) {
  * Return Value: pointer to dest
  * Function: copy n bytes of the source string into the destination string */
 int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
-    int32_t i = 0;
-    while (src[i] != '\0' && i < n) {
+    uint32_t i = 0;
+
+    while (i < n && (((uint32_t)src + i) & WORD_MASK) != 0 && src[i] != '\0') {
         dest[i] = src[i];
         i++;
     }
-    while (i < n) {
-        dest[i] = '\0';
+    /* src is aligned here unless the copy is already over */
+    if (i < n && src[i] != '\0') {
+        for (; n - i >= WORD_SIZE; i += WORD_SIZE) {
+            uint32_t w = *(const uint32_t*)(src + i);
+            if (HAS_ZERO_BYTE(w))
+                break;
+            *(uint32_t*)(dest + i) = w;
+        }
+    }
+    while (i < n && src[i] != '\0') {
+        dest[i] = src[i];
         i++;
     }
+    memset(dest + i, '\0', n - i);
     return dest;
 }
 
+/* int32_t cmdline_has(const int8_t* cmdline, const int8_t* word);
+ * Inputs: cmdline = space separated words, may be NULL
+ *         word = word to look for
+ * Return Value: 1 if word is one of the words, 0 otherwise
+ * Function: Whole words only, "serial" does not match "serial=1" */
+int32_t cmdline_has(const int8_t* cmdline, const int8_t* word) {
+    uint32_t len = strlen(word);
+
+    if (cmdline == NULL)
+        return 0;
+    while (*cmdline != '\0') {
+        if (!strncmp(cmdline, word, len) &&
+            (cmdline[len] == ' ' || cmdline[len] == '\0'))
+            return 1;
+        while (*cmdline != ' ' && *cmdline != '\0')
+            cmdline++;
+        while (*cmdline == ' ')
+            cmdline++;
+    }
+    return 0;
+}
+
 /* void test_interrupts(void)
  * Inputs: void
  * Return Value: void
@@ -8,13 +8,17 @@
 #include "types.h"
 
 int32_t printf(int8_t *format, ...);
+int32_t snprintf(int8_t* buf, int32_t size, int8_t* format, ...);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
+void console_write(const int8_t* s, int32_t n);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
 void clear(void);
 void update_cursor(void);
+void move_cursor(int32_t offset);
+void lib_init(void);
 
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
@@ -24,6 +28,7 @@ void* memmove(void* dest, const void* src, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
+int32_t cmdline_has(const int8_t* cmdline, const int8_t* word);
 
 /* Userspace address-check functions */
 void test_interrupts(void);
@@ -97,7 +102,7 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
@@ -155,4 +160,26 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Read time stamp counter
+ * Returns the low 32 bits of the TSC, which is enough to time anything
+ * shorter than a second */
+static inline uint32_t rdtsc(void) {
+    uint32_t low;
+    asm volatile ("rdtsc"
+            : "=a"(low)
+            :
+            : "edx"
+    );
+    return low;
+}
+
+/* Read the whole time stamp counter, for spans longer than rdtsc covers */
+static inline uint64_t rdtsc64(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc"
+            : "=A"(tsc)
+    );
+    return tsc;
+}
+
 #endif /* _LIB_H */
@@ -0,0 +1,88 @@
+/* lz4.c - LZ4 block decompression for compressed files
+ * vim:ts=4 noexpandtab
+ */
+
+#include "lz4.h"
+#include "lib.h"
+
+#define LZ4_RUN_MASK    0x0F        // a nibble of 15 continues in the next bytes
+#define LZ4_EXT_MAX     255         // an extra length byte of 255 continues too
+
+/* static int32_t lz4_length(const uint8_t** ip, const uint8_t* end, uint32_t len);
+ * Inputs: ip - position in the input, moved past the extra length bytes
+ *         end - end of the input
+ *         len - length from the token nibble
+ * Return Value: the full length, -1 if the input ends inside it */
+static int32_t lz4_length(const uint8_t** ip, const uint8_t* end, uint32_t len) {
+    uint32_t b;
+
+    if (len != LZ4_RUN_MASK)
+        return len;
+    do {
+        if (*ip >= end)
+            return -1;
+        b = *(*ip)++;
+        len += b;
+    } while (b == LZ4_EXT_MAX);
+    return len;
+}
+
+/* int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+ * Inputs: src - compressed block
+ *         src_len - its size
+ *         dst - where the data goes
+ *         dst_len - room in dst
+ * Return Value: bytes written to dst, -1 on a malformed block
+ * Function: Each sequence is a token, literals, then a 2 byte offset back
+ *           into the output and a match to copy from there. The last
+ *           sequence stops after its literals. Every length and offset is
+ *           checked, so a corrupt image cannot write outside dst. */
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len) {
+    const uint8_t* ip = src;
+    const uint8_t* end = src + src_len;
+    uint8_t* op = dst;
+    uint8_t* op_end = dst + dst_len;
+    const uint8_t* match;
+    int32_t len, n;
+    uint32_t token, offset;
+
+    while (ip < end) {
+        token = *ip++;
+
+        len = lz4_length(&ip, end, token >> 4);
+        if (len < 0 || len > end - ip || len > op_end - op)
+            return -1;
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return -1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst)
+            return -1;
+
+        len = lz4_length(&ip, end, token & LZ4_RUN_MASK);
+        if (len < 0)
+            return -1;
+        len += LZ4_MIN_MATCH;
+        if (len > op_end - op)
+            return -1;
+        //A match closer than its length overlaps what it is producing.
+        //Copying everything from the match start up to op each pass keeps
+        //source and destination apart, and the piece doubles every time.
+        match = op - offset;
+        while (len > 0) {
+            n = op - match;
+            if (n > len)
+                n = len;
+            memcpy(op, match, n);
+            op += n;
+            len -= n;
+        }
+    }
+    return op - dst;
+}
@@ -0,0 +1,17 @@
+/* lz4.h - LZ4 block decompression for compressed files
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _LZ4_H
+#define _LZ4_H
+
+#include "types.h"
+
+#define LZ4_MIN_MATCH   4           // a match length nibble of 0 means 4 bytes
+
+/* Decodes one LZ4 block (the raw block format, no frame header) from src
+ * into dst. Returns the number of bytes written, or -1 if the block is
+ * malformed or would not fit in dst_len bytes. */
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+
+#endif /* _LZ4_H */
@@ -0,0 +1,143 @@
+/* page_cache.c - Shared read-only program pages
+ * vim:ts=4 noexpandtab
+ *
+ * Text pages are keyed by the program's inode and the page's virtual
+ * address, which together fix the page's contents since the file system
+ * is read-only. Every process running the program maps the same frame.
+ * The cache keeps one reference of its own, so pages stay around after
+ * the last process exits until their frames are needed.
+ */
+
+#include "page_cache.h"
+#include "frame.h"
+#include "fs_driver.h"
+#include "lib.h"
+
+typedef struct page_cache_entry {
+    uint32_t inode;
+    uint32_t vaddr;
+    uint32_t ppn;                   // 0 when the entry is unused
+    uint32_t last_use;
+} page_cache_entry_t;
+
+static page_cache_entry_t page_cache[PAGE_CACHE_SIZE];
+static uint32_t page_cache_clock;   // ordering for last_use
+
+/* static void page_cache_fill(uint32_t ppn, const elf_image_t* image,
+ *                             const elf_phdr_t* ph, uint32_t vaddr);
+ * Inputs: ppn = frame to fill
+ *         image, ph = program and segment the page belongs to
+ *         vaddr = page aligned address of the page
+ * Return Value: none
+ * Function: zeroes the frame and copies in the part of the segment's file
+ *           bytes that falls in this page */
+static void page_cache_fill(uint32_t ppn, const elf_image_t* image,
+                            const elf_phdr_t* ph, uint32_t vaddr) {
+    uint8_t* page = kmap(ppn, 0);
+    uint32_t start = (ph->vaddr > vaddr) ? ph->vaddr : vaddr;
+    uint32_t end = ph->vaddr + ph->filesz;
+
+    if (end > vaddr + ALIGN_4KB)
+        end = vaddr + ALIGN_4KB;
+
+    memset(page, 0, ALIGN_4KB);
+    if (start < end)
+        read_data(image->inode, ph->offset + (start - ph->vaddr), page + (start - vaddr), end - start);
+    kunmap(0);
+}
+
+/* uint32_t page_cache_get(const elf_image_t* image, const elf_phdr_t* ph, uint32_t vaddr);
+ * Inputs: image = program being loaded
+ *         ph = its read-only segment containing vaddr
+ *         vaddr = any address in the page wanted
+ * Return Value: physical page number with a reference for the caller,
+ *               0 if memory is full
+ * Function: looks the page up and fills a new entry on a miss. With the
+ *           table full, the least recently used page nobody maps is
+ *           replaced; if every page is mapped the frame is returned
+ *           uncached. */
+uint32_t page_cache_get(const elf_image_t* image, const elf_phdr_t* ph, uint32_t vaddr) {
+    page_cache_entry_t* entry;
+    page_cache_entry_t* slot = NULL;
+    uint32_t ppn;
+    uint32_t i;
+
+    vaddr &= ~(ALIGN_4KB - 1);
+    page_cache_clock++;
+
+    for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+        entry = &page_cache[i];
+        if (entry->ppn != 0 && entry->inode == image->inode && entry->vaddr == vaddr) {
+            entry->last_use = page_cache_clock;
+            frame_get(entry->ppn);
+            return entry->ppn;
+        }
+    }
+
+    ppn = frame_alloc();
+    if (ppn == 0)
+        return 0;
+    page_cache_fill(ppn, image, ph, vaddr);
+
+    /* Free entry, or else the oldest one only the cache holds */
+    for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+        entry = &page_cache[i];
+        if (entry->ppn == 0) {
+            slot = entry;
+            break;
+        }
+        if (frame_refs(entry->ppn) == 1 && (slot == NULL || entry->last_use < slot->last_use))
+            slot = entry;
+    }
+    if (slot == NULL)
+        return ppn;
+
+    if (slot->ppn != 0)
+        frame_put(slot->ppn);
+    slot->inode = image->inode;
+    slot->vaddr = vaddr;
+    slot->ppn = ppn;
+    slot->last_use = page_cache_clock;
+    frame_get(ppn);                 // the cache's own reference
+    return ppn;
+}
+
+/* int32_t page_cache_evict(void);
+ * Inputs: none
+ * Return Value: 0 if a page was freed, -1 if every cached page is mapped
+ * Function: gives the least recently used unmapped page back to the frame
+ *           pool */
+int32_t page_cache_evict(void) {
+    page_cache_entry_t* victim = NULL;
+    uint32_t i;
+
+    for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+        page_cache_entry_t* entry = &page_cache[i];
+        if (entry->ppn != 0 && frame_refs(entry->ppn) == 1 &&
+            (victim == NULL || entry->last_use < victim->last_use))
+            victim = entry;
+    }
+    if (victim == NULL)
+        return -1;
+
+    frame_put(victim->ppn);
+    victim->ppn = 0;
+    return 0;
+}
+
+/* void page_cache_usage(uint32_t* cached, uint32_t* mapped);
+ * Inputs: cached, mapped = filled in with the counts
+ * Return Value: none */
+void page_cache_usage(uint32_t* cached, uint32_t* mapped) {
+    uint32_t i;
+
+    *cached = 0;
+    *mapped = 0;
+    for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+        if (page_cache[i].ppn == 0)
+            continue;
+        (*cached)++;
+        if (frame_refs(page_cache[i].ppn) > 1)
+            (*mapped)++;
+    }
+}
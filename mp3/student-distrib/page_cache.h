@@ -0,0 +1,24 @@
+/* page_cache.h - Shared read-only program pages
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PAGE_CACHE_H
+#define _PAGE_CACHE_H
+
+#include "types.h"
+#include "elf.h"
+
+#define PAGE_CACHE_SIZE     64      // pages kept, mapped or not
+
+/* Returns the frame holding a read-only segment's page at vaddr, reading
+ * it from the file on a miss. The caller gets its own reference. Returns
+ * 0 if no frame could be had. */
+uint32_t page_cache_get(const elf_image_t* image, const elf_phdr_t* ph, uint32_t vaddr);
+
+/* Frees one cached page nobody maps. Returns 0 if one was freed. */
+int32_t page_cache_evict(void);
+
+/* Number of cached pages, and how many of those are mapped right now */
+void page_cache_usage(uint32_t* cached, uint32_t* mapped);
+
+#endif /* _PAGE_CACHE_H */
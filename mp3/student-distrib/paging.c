@@ -1,99 +1,502 @@
 #include "paging.h"
+#include "frame.h"
+#include "lib.h"
+#include "smp.h"
 
 extern void enable(int directory);
+extern void flush_tlb();
 
+#define PF_PRESENT    0x1         //Page fault error code: page was present
+#define PF_WRITE      0x2         //Page fault error code: access was a write
 
+#define USER_INVLPG_MAX 64        //Past this many user pages one CR3 load beats invlpg
+
+
+/* Fixed mappings paging_init sets up, identity mapped. PG_LARGE regions
+ * take whole 4MB directory entries, the rest get 4kB pages through
+ * map_page. Everything here is the same in every address space, so it is
+ * all global and survives the CR3 loads of a process switch. The APs'
+ * directories share these entries. */
+typedef struct paging_region{
+  uint32_t addr;
+  uint32_t size;
+  uint32_t flags;
+}paging_region_t;
+
+static const paging_region_t kernel_regions[] = {
+  { VIDMEM_ADDR,   ALIGN_4KB, PG_WRITE | PG_GLOBAL },                     //Text mode video memory
+  { AP_BOOT_ADDR,  ALIGN_4KB, PG_WRITE | PG_GLOBAL },                     //Page smp_init copies the AP entry code into
+  { KERNEL_ADDR,   PAGE_4MB,  PG_WRITE | PG_GLOBAL | PG_LARGE },          //Kernel
+  { APIC_MAP_ADDR, PAGE_4MB,  PG_WRITE | PG_GLOBAL | PG_LARGE | PG_PCD | PG_PWT },  //APIC registers, never cached
+};
+
+//Physical page each process sees at VM_VIDEO: video memory, a back page of
+//its own for vflip, or 0 for none
+static uint32_t user_vidmap_page[USER_PID_MAX];
+
+//Tables behind the 4kB kernel mappings, taken in order by paging_table
+static table_entry_desc_t kernel_tables[KERNEL_TABLES][MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
+static uint32_t kernel_tables_used;
+
+//Directories of the APs, handed out in order by paging_ap_init
+static dir_entry_desc_t ap_directory[SMP_MAX_CPUS - 1][MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
+static uint32_t ap_directory_used;
+
+/* static inline void invlpg(uint32_t vaddr);
+ * Inputs: vaddr - virtual address whose page table entry changed
+ * Return Value: none
+ * Function: drops the TLB entry for that page only */
+static inline void invlpg(uint32_t vaddr){
+  asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+}
+
+/* void paging_init();
+ * Inputs: none
+ * Return Value: none
+ * Function: builds the directory from kernel_regions, points the user
+ *           program page at process 0's table and turns paging on */
 void paging_init(){
-  //Loop variables
-  unsigned int j;
-  unsigned int i;
-
-  //Setup the first 4MB of memory with 4 kB tables
-  page_directory[0].present       = 1;
-  page_directory[0].read_write    = 1;
-  page_directory[0].user          = 0;
-  page_directory[0].write_through = 0;  //Not sure
-  page_directory[0].cache_disable = 0;  //Not sure
-  page_directory[0].accessed      = 0;
-  page_directory[0].size          = 0;  //4 kB tables
-  page_directory[0].reserved      = 0;
-  //Aligned value for the table address
-  page_directory[0].table_addr_31_12 = ((int)page_table)/ALIGN_4KB;
-
-  //Sets up the rest as 4MB pages
-  for(i = 1; i < MAX_SPACES; ++i){
-    if(i == 1){
-      //Bit setup for kernel memory.
-      page_directory[i].present     = 1;
-      page_directory[i].user        = 0;
-      page_directory[i].table_addr_31_12 = KERNEL_ADDR/ALIGN_4KB;
-    }
-    else if(i == USER_INDEX){
-      //Bit setup for User virtual memory
-      page_directory[i].present = 1;
-      page_directory[i].user    = 1;
-      page_directory[i].table_addr_31_12 = USER_MEM/ALIGN_4KB;
+  const paging_region_t* region;
+  uint32_t addr;
+  uint32_t i;
+
+  cpus[0].dir = page_directory;
+  for(i = 0; i < sizeof(kernel_regions) / sizeof(kernel_regions[0]); ++i){
+    region = &kernel_regions[i];
+    for(addr = region->addr; addr - region->addr < region->size;
+        addr += (region->flags & PG_LARGE) ? PAGE_4MB : ALIGN_4KB){
+      if(region->flags & PG_LARGE)
+        page_directory[addr / PAGE_4MB].val = addr | region->flags | PG_PRESENT;
+      else
+        map_page(addr, addr, region->flags);
     }
-    else{
-      //Bit setup for the rest of memory
-      page_directory[i].present     = 0;
-      page_directory[i].user        = 0;
+  }
+
+  //User program page, filled in by execute
+  page_directory[USER_INDEX].val = (uint32_t)page_table_user[0] | PG_USER | PG_WRITE | PG_PRESENT;
+
+  //Sets up the control registers for paging
+  enable((int)page_directory);
+}
+
+/* dir_entry_desc_t* paging_ap_init();
+ * Inputs: none
+ * Return Value: a page directory for the next AP
+ * Function: Copies the 4MB kernel entries and the low table of
+ *           kernel_regions. The kmap window, VM_VIDEO and the user program
+ *           page get tables of the AP's own the first time it maps them. */
+dir_entry_desc_t* paging_ap_init(){
+  dir_entry_desc_t* dir = ap_directory[ap_directory_used++];
+  uint32_t i;
+
+  for(i = 0; i < MAX_SPACES; ++i){
+    if(page_directory[i].present && (page_directory[i].size || i == 0))
+      dir[i] = page_directory[i];
+  }
+  return dir;
+}
+
+/* static table_entry_desc_t* paging_table(uint32_t vaddr, uint32_t flags);
+ * Inputs: vaddr - address to be mapped with a 4kB page
+ *         flags - PG_* flags of the page, PG_USER opens the directory entry
+ * Return Value: the page table covering vaddr, NULL if it is a 4MB page or
+ *               no table is left
+ * Function: finds the table, giving the directory entry one the first time */
+static table_entry_desc_t* paging_table(uint32_t vaddr, uint32_t flags){
+  dir_entry_desc_t* dir = &smp_this_cpu()->dir[vaddr / PAGE_4MB];
+  table_entry_desc_t* table;
+
+  if(dir->present){
+    if(dir->size)
+      return NULL;
+    if(flags & PG_USER)
+      dir->user = 1;
+    return (table_entry_desc_t*)(dir->val & PG_ADDR_MASK);
+  }
+  if(kernel_tables_used == KERNEL_TABLES)
+    return NULL;
+  table = kernel_tables[kernel_tables_used++];
+  dir->val = (uint32_t)table | (flags & PG_USER) | PG_WRITE | PG_PRESENT;
+  return table;
+}
+
+/* int32_t map_page(uint32_t vaddr, uint32_t paddr, uint32_t flags);
+ * Inputs: vaddr - virtual address of the page
+ *         paddr - physical address it maps to
+ *         flags - PG_WRITE, PG_USER, PG_GLOBAL, PG_PCD, PG_PWT
+ * Return Value: 0 on success, -1 if vaddr is inside a 4MB page or no page
+ *               table is left for it
+ * Function: Maps a 4kB page and invalidates only that page's TLB entry.
+ *           Not for the user program page, see user_map_range. */
+int32_t map_page(uint32_t vaddr, uint32_t paddr, uint32_t flags){
+  table_entry_desc_t* table = paging_table(vaddr, flags);
+
+  if(table == NULL)
+    return -1;
+  table[(vaddr / ALIGN_4KB) % MAX_SPACES].val = (paddr & PG_ADDR_MASK) |
+      (flags & (PG_WRITE | PG_USER | PG_PWT | PG_PCD | PG_GLOBAL)) | PG_PRESENT;
+  invlpg(vaddr);
+  return 0;
+}
+
+/* void unmap_page(uint32_t vaddr);
+ * Inputs: vaddr - page map_page mapped
+ * Return Value: none
+ * Function: marks the page not present and drops its TLB entry */
+void unmap_page(uint32_t vaddr){
+  dir_entry_desc_t* dir = &smp_this_cpu()->dir[vaddr / PAGE_4MB];
+  table_entry_desc_t* table;
+
+  if(!dir->present || dir->size)
+    return;
+  table = (table_entry_desc_t*)(dir->val & PG_ADDR_MASK);
+  table[(vaddr / ALIGN_4KB) % MAX_SPACES].val = 0;
+  invlpg(vaddr);
+}
+
+/* static int32_t user_table_active(uint32_t pid);
+ * Inputs: pid - process to look at
+ * Return Value: 1 if this CPU's user directory entry points at the
+ *               process's table, the only one its TLB can hold user pages
+ *               from */
+static int32_t user_table_active(uint32_t pid){
+  return (smp_this_cpu()->dir[USER_INDEX].val & PG_ADDR_MASK) == (uint32_t)page_table_user[pid];
+}
+
+/* static void user_tlb_drop(uint32_t pid);
+ * Inputs: pid - process whose table is active
+ * Return Value: none
+ * Function: Drops the TLB entries of the process's present pages. Only
+ *           present pages get cached, so these are all the user entries.
+ *           The kernel's are global and stay either way, which makes one
+ *           CR3 load the cheaper choice past USER_INVLPG_MAX pages. The
+ *           first invlpg also drops the cached directory entry. */
+static void user_tlb_drop(uint32_t pid){
+  uint32_t present = 0;
+  uint32_t i;
+
+  for(i = 0; i < MAX_SPACES; ++i){
+    if(page_table_user[pid][i].present)
+      ++present;
+  }
+  if(present > USER_INVLPG_MAX){
+    flush_tlb();
+    return;
+  }
+  invlpg(USER_MEM);
+  for(i = 0; i < MAX_SPACES && present > 0; ++i){
+    if(page_table_user[pid][i].present){
+      invlpg(USER_MEM + i * ALIGN_4KB);
+      --present;
     }
-    page_directory[i].read_write    = 1;
-    page_directory[i].write_through = 0;  //Not sure
-    page_directory[i].cache_disable = 0;  //Not sure
-    page_directory[i].accessed      = 0;
-    page_directory[i].size          = 1;  //4MB memory
-    page_directory[i].reserved      = 0;
   }
+}
 
+/* static int32_t user_vidmap_owned(uint32_t pid);
+ * Inputs: pid - process to look at
+ * Return Value: 1 if its VM_VIDEO page is a back page frame, 0 otherwise */
+static int32_t user_vidmap_owned(uint32_t pid){
+  return user_vidmap_page[pid] != 0 && user_vidmap_page[pid] != VIDMEM_ADDR;
+}
 
-  //Fill in the page table for the first 4MB
-  for(j = 0; j < MAX_SPACES; ++j){
-    //Setup video memory page
-    if(j * ALIGN_4KB == VIDMEM_ADDR){
-      page_table[j].present     = 1;
+/* static int32_t user_vidmap_load(uint32_t pid);
+ * Inputs: pid - process whose table is active
+ * Return Value: 0 on success, -1 if there is no page table for VM_VIDEO
+ * Function: puts the process's page at VM_VIDEO, dropping only that TLB entry */
+static int32_t user_vidmap_load(uint32_t pid){
+  if(user_vidmap_page[pid] == 0){
+    unmap_page(VM_VIDEO);
+    return 0;
+  }
+  return map_page(VM_VIDEO, user_vidmap_page[pid], PG_USER | PG_WRITE);
+}
+
+/* int32_t user_vidmap(uint32_t pid, int32_t buffered);
+ * Inputs: pid - process asking, its table must be the active one
+ *         buffered - 0 to draw straight into video memory, 1 for a back
+ *                    page that only vflip copies to the screen
+ * Return Value: 0 on success, -1 if memory is full
+ * Function: Maps the process's page at VM_VIDEO. A new back page starts as
+ *           a copy of the screen; one the process already has is kept. */
+int32_t user_vidmap(uint32_t pid, int32_t buffered){
+  uint32_t ppn;
+
+  if(buffered && !user_vidmap_owned(pid)){
+    ppn = frame_alloc();
+    if(ppn == 0)
+      return -1;
+    memcpy(kmap(ppn, 0), (void*)VIDMEM_ADDR, ALIGN_4KB);
+    kunmap(0);
+    user_vidmap_page[pid] = ppn * ALIGN_4KB;
+  }
+  else if(!buffered){
+    if(user_vidmap_owned(pid))
+      frame_put(user_vidmap_page[pid] / ALIGN_4KB);
+    user_vidmap_page[pid] = VIDMEM_ADDR;
+  }
+  return user_vidmap_load(pid);
+}
+
+/* int32_t user_vidmap_buffered(uint32_t pid);
+ * Inputs: pid - process to look at
+ * Return Value: 1 if the process draws into a back page, 0 otherwise */
+int32_t user_vidmap_buffered(uint32_t pid){
+  return user_vidmap_owned(pid);
+}
+
+/* void user_paging_reset(uint32_t pid);
+ * Inputs: pid - process whose user page table is cleared
+ * Return Value: none
+ * Function: drops the process's reference on every frame it maps, its
+ *           vidmap back page included, and marks every page not present,
+ *           ready for a new program */
+void user_paging_reset(uint32_t pid){
+  uint32_t i;
+
+  if(user_table_active(pid))
+    user_tlb_drop(pid);
+  for(i = 0; i < MAX_SPACES; ++i){
+    if(page_table_user[pid][i].present)
+      frame_put(page_table_user[pid][i].page_addr_31_12);
+  }
+  memset(page_table_user[pid], 0, sizeof(page_table_user[pid]));
+
+  //A new program has to ask for vidmap again
+  if(user_vidmap_owned(pid))
+    frame_put(user_vidmap_page[pid] / ALIGN_4KB);
+  user_vidmap_page[pid] = 0;
+  if(user_table_active(pid))
+    unmap_page(VM_VIDEO);
+}
+
+/* static int32_t user_page_fill(table_entry_desc_t* entry, uint32_t vaddr);
+ * Inputs: entry - page table entry of the page
+ *         vaddr - address of the page in the active address space
+ * Return Value: 0 on success, -1 if memory is full
+ * Function: backs the page with a new frame and zeroes it */
+static int32_t user_page_fill(table_entry_desc_t* entry, uint32_t vaddr){
+  uint32_t ppn = frame_alloc();
+
+  if(ppn == 0)
+    return -1;
+  //Zeroed through the kernel window, the page may be read-only
+  memset(kmap(ppn, 0), 0, ALIGN_4KB);
+  kunmap(0);
+  entry->page_addr_31_12 = ppn;
+  entry->present = 1;
+  entry->avail_11_9 &= ~PTE_ZERO_FILL;
+  invlpg(vaddr);
+  return 0;
+}
+
+/* static int32_t user_page_private(table_entry_desc_t* entry, uint32_t vaddr);
+ * Inputs: entry - present page table entry of a shared page
+ *         vaddr - address of the page in the active address space
+ * Return Value: 0 on success, -1 if memory is full
+ * Function: gives the process its own copy of the page */
+static int32_t user_page_private(table_entry_desc_t* entry, uint32_t vaddr){
+  uint32_t old_ppn = entry->page_addr_31_12;
+  uint32_t ppn = frame_alloc();
+
+  if(ppn == 0)
+    return -1;
+  memcpy(kmap(ppn, 0), kmap(old_ppn, 1), ALIGN_4KB);
+  kunmap(0);
+  kunmap(1);
+  entry->page_addr_31_12 = ppn;
+  invlpg(vaddr);
+  frame_put(old_ppn);
+  return 0;
+}
+
+/* int32_t user_map_range(uint32_t pid, uint32_t start, uint32_t end, uint32_t flags);
+ * Inputs: pid - process whose table is changed, must be the active one
+ *  start, end - user virtual addresses, end is exclusive
+ *       flags - USER_MAP_WRITE and/or USER_MAP_LAZY
+ * Return Value: 0 on success, -1 if memory ran out, pages before the one
+ *               that failed stay mapped
+ * Function: Maps every page touching the range. New pages get a zero filled
+ *           frame, now or on first touch with USER_MAP_LAZY. A page that is
+ *           already mapped keeps its contents, and is copied first if it is
+ *           shared and needs to become writable. */
+int32_t user_map_range(uint32_t pid, uint32_t start, uint32_t end, uint32_t flags){
+  uint32_t index;
+  uint32_t vaddr;
+  table_entry_desc_t* entry;
+
+  if(end <= start)
+    return 0;
+
+  for(vaddr = start & ~(ALIGN_4KB - 1); vaddr < end; vaddr += ALIGN_4KB){
+    index = (vaddr - USER_MEM) / ALIGN_4KB;
+    entry = &page_table_user[pid][index];
+
+    if(entry->present){
+      if((flags & USER_MAP_WRITE) && !entry->read_write &&
+         frame_refs(entry->page_addr_31_12) > 1 && user_page_private(entry, vaddr) == -1)
+        return -1;
     }
-    //Set up for unused 4kB pages
-    else{
-      page_table[j].present     = 0;
+    else if(!(entry->avail_11_9 & PTE_ZERO_FILL)){
+      entry->user = 1;
+      entry->avail_11_9 = PTE_ZERO_FILL;
     }
-    page_table[j].read_write    = 1;
-    page_table[j].user          = 0;
-    page_table[j].write_through = 0;    //Not sure
-    page_table[j].cache_disable = 0;    //Not sure
-    page_table[j].accessed      = 0;
-    page_table[j].dirty         = 0;
-    page_table[j].reserved      = 0;
-    page_table[j].global        = 0;    //Not sure
-    page_table[j].page_addr_31_12 = j;
+
+    if(flags & USER_MAP_WRITE){
+      entry->read_write = 1;
+      entry->avail_11_9 &= ~PTE_COW;
+    }
+    if(!entry->present && !(flags & USER_MAP_LAZY) && user_page_fill(entry, vaddr) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/* void user_map_frame(uint32_t pid, uint32_t vaddr, uint32_t ppn);
+ * Inputs: pid - process whose table is changed, must be the active one
+ *       vaddr - user address of the page
+ *         ppn - frame to map, the caller's reference passes to the mapping
+ * Return Value: none
+ * Function: maps a shared read-only page. If the page is already mapped the
+ *           existing page wins and the reference is dropped. */
+void user_map_frame(uint32_t pid, uint32_t vaddr, uint32_t ppn){
+  table_entry_desc_t* entry = &page_table_user[pid][(vaddr - USER_MEM) / ALIGN_4KB];
+
+  if(entry->present){
+    frame_put(ppn);
+    return;
   }
+  entry->user = 1;
+  entry->read_write = 0;
+  entry->avail_11_9 = 0;
+  entry->page_addr_31_12 = ppn;
+  entry->present = 1;
+  invlpg(vaddr & ~(ALIGN_4KB - 1));
+}
+
+/* void user_pages_count(uint32_t pid, uint32_t* resident, uint32_t* shared);
+ * Inputs: pid - process to look at
+ *    resident - filled in with the number of present pages
+ *      shared - filled in with the present pages other mappings also hold
+ * Return Value: none */
+void user_pages_count(uint32_t pid, uint32_t* resident, uint32_t* shared){
+  uint32_t i;
 
-for(j = 0; j < MAX_SPACES; ++j){
-    //Setup video memory page
-    page_table_vidmap[j].present     = 0;
-    page_table_vidmap[j].read_write    = 1;
-    page_table_vidmap[j].user          = 0;
-    page_table_vidmap[j].write_through = 0;    //Not sure
-    page_table_vidmap[j].cache_disable = 1;    //Not sure
-    page_table_vidmap[j].accessed      = 0;
-    page_table_vidmap[j].dirty         = 0;
-    page_table_vidmap[j].reserved      = 0;
-    page_table_vidmap[j].global        = 0;    //Not sure
-    page_table_vidmap[j].page_addr_31_12 = j;
+  *resident = 0;
+  *shared = 0;
+  for(i = 0; i < MAX_SPACES; ++i){
+    if(!page_table_user[pid][i].present)
+      continue;
+    ++*resident;
+    if(frame_refs(page_table_user[pid][i].page_addr_31_12) > 1)
+      ++*shared;
   }
+}
 
+/* void user_paging_fork(uint32_t parent, uint32_t child);
+ * Inputs: parent - process being copied
+ *          child - process getting the copy, its table must be empty
+ * Return Value: none
+ * Function: Gives the child the parent's mappings, taking a reference on
+ *           every frame. Writable pages become read-only in both tables and
+ *           are marked PTE_COW so the first write gets its own copy. Pages
+ *           not touched yet stay lazy and are filled separately. The
+ *           child also gets the parent's vidmap page. */
+void user_paging_fork(uint32_t parent, uint32_t child){
+  uint32_t i;
+  table_entry_desc_t* entry;
 
+  for(i = 0; i < MAX_SPACES; ++i){
+    entry = &page_table_user[parent][i];
+    if(entry->present){
+      if(entry->read_write){
+        entry->read_write = 0;
+        entry->avail_11_9 |= PTE_COW;
+      }
+      frame_get(entry->page_addr_31_12);
+    }
+    page_table_user[child][i] = *entry;
+  }
+  //The parent's writable pages just became read-only
+  if(user_table_active(parent))
+    user_tlb_drop(parent);
 
+  //A back page is shared, both draw into it
+  user_vidmap_page[child] = user_vidmap_page[parent];
+  if(user_vidmap_owned(child))
+    frame_get(user_vidmap_page[child] / ALIGN_4KB);
+}
 
+/* void user_paging_switch(uint32_t pid);
+ * Inputs: pid - process to run
+ * Return Value: none
+ * Function: Points the user page directory entry at the process's table
+ *           and its vidmap page at VM_VIDEO. Only the outgoing process's
+ *           pages leave the TLB, and nothing at all does if the process's
+ *           table is already the active one. With several CPUs a process
+ *           may have changed its table on another one since, so this
+ *           CPU's user pages all go. */
+void user_paging_switch(uint32_t pid){
+  dir_entry_desc_t* dir = smp_this_cpu()->dir;
+  uint32_t i;
 
+  if(smp_ncpus > 1){
+    dir[USER_INDEX].val = (uint32_t)page_table_user[pid] | PG_USER | PG_WRITE | PG_PRESENT;
+    flush_tlb();
+    user_vidmap_load(pid);
+    return;
+  }
+  if(user_table_active(pid))
+    return;
+  for(i = 0; i < USER_PID_MAX; ++i){
+    if(user_table_active(i))
+      break;
+  }
+  dir[USER_INDEX].val = (uint32_t)page_table_user[pid] | PG_USER | PG_WRITE | PG_PRESENT;
+  if(i < USER_PID_MAX)
+    user_tlb_drop(i);
+  else
+    flush_tlb();
+  if(i == USER_PID_MAX || user_vidmap_page[i] != user_vidmap_page[pid])
+    user_vidmap_load(pid);
+}
 
-  //Sets up the control registers for paging
-  enable((int)page_directory);
+/* int32_t page_fault_resolve(uint32_t error);
+ * Inputs: error - error code pushed by the page fault
+ * Return Value: 1 if the fault was handled and the access can be retried,
+ *               0 if it is a real fault
+ * Function: Zero fills bss and stack pages of the running program the first
+ *           time they are touched, and gives it its own copy of a page
+ *           shared by fork the first time it writes one */
+int32_t page_fault_resolve(uint32_t error){
+  uint32_t addr;
+  uint32_t vaddr;
+  table_entry_desc_t* entry;
 
+  asm volatile("movl %%cr2, %0" : "=r"(addr));
 
+  if(addr < USER_MEM || addr >= USER_MEM + PAGE_4MB)
+    return 0;
 
+  entry = &page_table_user[cur_pid][(addr - USER_MEM) / ALIGN_4KB];
+  vaddr = addr & ~(ALIGN_4KB - 1);
 
+  if(error & PF_PRESENT){
+    if(!(error & PF_WRITE) || !(entry->avail_11_9 & PTE_COW))
+      return 0;
+    //The last process holding the page can keep it
+    if(frame_refs(entry->page_addr_31_12) > 1 &&
+       user_page_private(entry, vaddr) == -1)
+      return 0;
+    entry->read_write = 1;
+    entry->avail_11_9 &= ~PTE_COW;
+    invlpg(vaddr);
+    return 1;
+  }
 
+  if(!(entry->avail_11_9 & PTE_ZERO_FILL))
+    return 0;
 
+  if(user_page_fill(entry, vaddr) == -1)
+    return 0;
+  return 1;
 }
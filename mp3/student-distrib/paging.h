@@ -4,6 +4,7 @@
 #ifndef ASM
 
 #include "types.h"
+#include "smp.h"
 
 #define   MAX_SPACES    1024      //Number of tables/pages in dir
 #define   ALIGN_4KB		4096			 //(2^12)
@@ -16,10 +17,40 @@
 #define   VIDEO_INDEX   34        //directory used for vidmap  
 
 #define VM_VIDEO 0x8800000
+
+#define   APIC_INDEX    1019      //4MB page at 0xFEC00000 holding the IO and local APIC registers
+#define   APIC_MAP_ADDR 0xFEC00000
+
+#define   USER_PID_MAX  8         //Processes with a user page table, syscall.h's PID_MAX and MAX_PID
+
+//Flags for user_map_range
+#define   USER_MAP_WRITE  0x1     //Page is writable from user mode
+#define   USER_MAP_LAZY   0x2     //Map on first touch and zero fill then
+
+//Kept in a page table entry's avail bits while the page is not present
+#define   PTE_ZERO_FILL   0x1
+//Kept in the avail bits of a writable page fork made read-only to share it
+#define   PTE_COW         0x2
+//Bits of a whole directory or table entry, for map_page and the .val views
+#define   PG_PRESENT    0x001
+#define   PG_WRITE      0x002
+#define   PG_USER       0x004
+#define   PG_PWT        0x008     //Write through
+#define   PG_PCD        0x010     //Cache disable
+#define   PG_LARGE      0x080     //4MB page, directory entries only
+#define   PG_GLOBAL     0x100     //Kept in the TLB over CR3 loads, needs CR4.PGE
+#define   PG_ADDR_MASK  0xFFFFF000
+
+//Page tables paging_init and map_page can hand out to kernel mappings: the
+//shared low one, and the kmap window and VM_VIDEO of each CPU
+#define   KERNEL_TABLES (1 + 2 * SMP_MAX_CPUS)
+
 //See wiki.osdev.org/Paging for information on directory and table entries.
 
 //The 32 bit entries used for the directory
-typedef struct __attribute__((packed)) dir_entry_desc{
+typedef union dir_entry_desc{
+  uint32_t val;                           //The whole entry, PG_* bits
+  struct __attribute__((packed)){
     uint32_t present            : 1;
     uint32_t read_write         : 1;
     uint32_t user               : 1;
@@ -28,13 +59,16 @@ typedef struct __attribute__((packed)) dir_entry_desc{
     uint32_t accessed           : 1;
     uint32_t reserved           : 1;
     uint32_t size               : 1;      //4MB or 4kB
-    uint32_t ignored            : 1;
+    uint32_t global             : 1;      //4MB pages only
     uint8_t  avail_11_9         : 3;
     uint32_t table_addr_31_12   : 20;
+  };
 }dir_entry_desc_t;
 
 //32 bit Entries used for the tables
-typedef struct __attribute__((packed)) table_entry_desc{
+typedef union table_entry_desc{
+  uint32_t val;                           //The whole entry, PG_* bits
+  struct __attribute__((packed)){
     uint32_t present            : 1;
     uint32_t read_write         : 1;
     uint32_t user               : 1;
@@ -46,16 +80,53 @@ typedef struct __attribute__((packed)) table_entry_desc{
     uint32_t global             : 1;
     uint8_t  avail_11_9         : 3;
     uint32_t page_addr_31_12    : 20;
+  };
 }table_entry_desc_t;
 
 //Arrays holding the 32-bit entries for directory and table
 dir_entry_desc_t page_directory[MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
-table_entry_desc_t page_table[MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
-table_entry_desc_t page_table_vidmap[MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
+//4kB pages of the user program page at 128MB, one table per process
+table_entry_desc_t page_table_user[USER_PID_MAX][MAX_SPACES] __attribute__((aligned (ALIGN_4KB)));
 
 
 // Initializes the pages
 extern void paging_init();
 
+// Builds the page directory of the next AP smp_init starts
+extern dir_entry_desc_t* paging_ap_init();
+
+// Maps one 4kB kernel or vidmap page, PG_* flags, and drops its TLB entry
+extern int32_t map_page(uint32_t vaddr, uint32_t paddr, uint32_t flags);
+
+// Unmaps a page map_page mapped and drops its TLB entry
+extern void unmap_page(uint32_t vaddr);
+
+// Unmaps every page of a process's user page table and frees its frames
+extern void user_paging_reset(uint32_t pid);
+
+// Maps the user pages covering [start, end) for a process, -1 if memory ran out
+extern int32_t user_map_range(uint32_t pid, uint32_t start, uint32_t end, uint32_t flags);
+
+// Maps a frame the caller holds a reference on at one user page, read-only
+extern void user_map_frame(uint32_t pid, uint32_t vaddr, uint32_t ppn);
+
+// Counts a process's present pages and those it shares with others
+extern void user_pages_count(uint32_t pid, uint32_t* resident, uint32_t* shared);
+
+// Shares every page of one process with another, copying on write
+extern void user_paging_fork(uint32_t parent, uint32_t child);
+
+// Maps video memory, or a private back page, at VM_VIDEO for a process
+extern int32_t user_vidmap(uint32_t pid, int32_t buffered);
+
+// Returns 1 if a process's vidmap is a back page vflip copies to the screen
+extern int32_t user_vidmap_buffered(uint32_t pid);
+
+// Makes a process's user page table the active one
+extern void user_paging_switch(uint32_t pid);
+
+// Tries to handle a page fault, returns 1 if the access can be retried
+extern int32_t page_fault_resolve(uint32_t error);
+
 #endif /* ASM */
 #endif /* PAGING_H */
@@ -0,0 +1,40 @@
+/* pit.c - Programmable interval timer, the scheduler's clock
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pit.h"
+#include "i8259.h"
+#include "lib.h"
+
+#define PIT_CHANNEL0    0x40
+#define PIT_COMMAND     0x43
+#define PIT_IRQ_NUM     0
+#define PIT_SQUARE_WAVE 0x36        // channel 0, low then high byte, mode 3
+#define PIT_BASE_FREQ   1193182     // input clock in Hz
+#define BYTE_MASK       0xFF
+#define BYTE_SHIFT      8
+
+volatile uint32_t pit_ticks = 0;
+
+/* void pit_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: programs channel 0 to interrupt PIT_HZ times a second */
+void pit_init(void) {
+    uint32_t divisor = PIT_BASE_FREQ / PIT_HZ;
+
+    outb(PIT_SQUARE_WAVE, PIT_COMMAND);
+    outb(divisor & BYTE_MASK, PIT_CHANNEL0);
+    outb((divisor >> BYTE_SHIFT) & BYTE_MASK, PIT_CHANNEL0);
+    enable_irq(PIT_IRQ_NUM);
+}
+
+/* void pit_handler(irq_frame_t* frame);
+ * Inputs: frame - where the interrupt came in, not used
+ * Return Value: none
+ * Function: Counts the tick and acknowledges it. The switch to another
+ *           process happens in the linkage afterwards (see handlers.S). */
+void pit_handler(irq_frame_t* frame) {
+    ++pit_ticks;
+    send_eoi(PIT_IRQ_NUM);
+}
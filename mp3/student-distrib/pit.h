@@ -0,0 +1,22 @@
+/* pit.h - Programmable interval timer, the scheduler's clock
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PIT_H
+#define _PIT_H
+
+#include "types.h"
+#include "prof.h"
+
+#define PIT_HZ          100         // timer interrupts per second, one time slice each
+
+/* Ticks since pit_init */
+extern volatile uint32_t pit_ticks;
+
+/* Start channel 0 at PIT_HZ and unmask IRQ 0 */
+void pit_init(void);
+
+/* Counts the tick, called from the PIT_WRAPPER linkage */
+void pit_handler(irq_frame_t* frame);
+
+#endif /* _PIT_H */
@@ -0,0 +1,109 @@
+/* proc.c - Read-only pseudo files that expose kernel state as text
+ * vim:ts=4 noexpandtab
+ */
+
+#include "proc.h"
+#include "syscall.h"
+#include "stats.h"
+#include "trace.h"
+#include "frame.h"
+#include "crash.h"
+#include "smp.h"
+#include "bcache.h"
+#include "bootprof.h"
+
+typedef struct proc_entry {
+    int8_t* name;
+    proc_show_t show;
+} proc_entry_t;
+
+/* Every pseudo file. The dentry inode number is the index in this table. */
+static proc_entry_t proc_entries[] = {
+    { "irqstat", stats_show },
+    { "syshist", syshist_show },
+    { "meminfo", meminfo_show },
+    { "crashlog", crashlog_show },
+    { "cpuinfo", cpuinfo_show },
+    { "diskstat", diskstat_show },
+    { "bootprof", bootprof_show },
+};
+
+#define NUM_PROC_ENTRIES    (sizeof(proc_entries) / sizeof(proc_entries[0]))
+
+/* Text of the file being read, regenerated on every read */
+static int8_t proc_buf[PROC_BUF_SIZE];
+
+/* proc_lookup
+ * Inputs: fname - file name to search
+ *         dentry - dentry object to copy data into
+ * Return Value: 0 if success, -1 otherwise.
+ * Function: Looks fname up in the pseudo file table. Called by
+ *           read_dentry_by_name when the boot block has no such file.
+ */
+int32_t proc_lookup(const uint8_t* fname, dentry_t* dentry) {
+    uint32_t i;
+
+    for (i = 0; i < NUM_PROC_ENTRIES; i++) {
+        if (!strncmp((int8_t*)fname, proc_entries[i].name, MAX_FILENAME)) {
+            strncpy((int8_t*)dentry->fname, proc_entries[i].name, MAX_FILENAME);
+            dentry->ftype = PROC_FTYPE;
+            dentry->inode_num = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* proc_open
+ * Inputs: fname - not used
+ * Return Value: 0
+ * Function: nothing to set up, the text is built on read
+ */
+int32_t proc_open(const uint8_t* fname) {
+    return 0;
+}
+
+/* proc_close
+ * Inputs: fd - not used
+ * Return Value: 0
+ * Function: does nothing
+ */
+int32_t proc_close(int32_t fd) {
+    return 0;
+}
+
+/* proc_read
+ * Inputs: fd - index of the file in the file descriptor array
+ *         buf - buffer to read the text into
+ *         nbytes - number of bytes to read
+ * Return Value: number of bytes read, 0 at the end of the text
+ * Function: Builds the file's text and copies it out starting at the
+ *           file position, like file_read does for regular files
+ */
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes) {
+    pcb_t* cur_pcb_ptr = get_cur_pcb();
+    file_descriptor_t* file = &cur_pcb_ptr->fd_array[fd];
+    int32_t len;
+
+    if (buf == NULL || file->inode >= NUM_PROC_ENTRIES)
+        return -1;
+
+    len = proc_entries[file->inode].show(proc_buf, PROC_BUF_SIZE);
+    if (file->file_pos >= len)
+        return 0;
+    if (nbytes > len - file->file_pos)
+        nbytes = len - file->file_pos;
+
+    memcpy(buf, &proc_buf[file->file_pos], nbytes);
+    file->file_pos += nbytes;
+    return nbytes;
+}
+
+/* proc_write
+ * Inputs: None
+ * Return Value: -1
+ * Function: pseudo files are read only
+ */
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
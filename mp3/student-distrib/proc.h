@@ -0,0 +1,27 @@
+/* proc.h - Read-only pseudo files that expose kernel state as text
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROC_H
+#define _PROC_H
+
+#include "types.h"
+#include "fs_driver.h"
+
+#define PROC_FTYPE      3           // dentry ftype used for pseudo files
+#define PROC_BUF_SIZE   BLOCK_SIZE  // largest text a pseudo file can produce
+
+/* Fills buf with the file's current text and returns its length. Show
+ * functions build the text with len += snprintf(buf + len, size - len, ...) */
+typedef int32_t (*proc_show_t)(int8_t* buf, int32_t size);
+
+/* Finds a pseudo file by name and fills in a dentry for it */
+int32_t proc_lookup(const uint8_t* fname, dentry_t* dentry);
+
+/* Pseudo file operations */
+int32_t proc_open(const uint8_t* fname);
+int32_t proc_close(int32_t fd);
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _PROC_H */
@@ -0,0 +1,107 @@
+/* prof.c - RTC driven sampling profiler
+ * vim:ts=4 noexpandtab
+ *
+ * Samples are taken from the RTC interrupt, which runs at its maximum rate
+ * for as long as the kernel is up, rather than the scheduler's PIT tick
+ * whose rate is tied to the time slice. With a single CPU the sample
+ * buffer is global.
+ */
+
+#include "prof.h"
+#include "lib.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "smp.h"
+
+static prof_sample_t prof_samples[PROF_MAX_SAMPLES];
+static uint32_t prof_head;          // next sample to hand to prof_read
+static uint32_t prof_count;
+static uint32_t prof_dropped;       // samples lost while the buffer was full
+
+static uint32_t prof_interval;      // 0 while off
+static uint32_t prof_countdown;
+
+static spinlock_t prof_lock = SPINLOCK_INIT("prof");
+
+/* void prof_tick(irq_frame_t* frame);
+ * Inputs: frame = interrupt frame of the RTC interrupt
+ * Return Value: none
+ * Function: Records where the CPU was every prof_interval ticks. Runs in
+ *           the RTC handler. */
+void prof_tick(irq_frame_t* frame) {
+    prof_sample_t* sample;
+    uint32_t flags;
+
+    if (prof_interval == 0)
+        return;
+
+    spin_lock_irqsave(&prof_lock, flags);
+    if (prof_interval != 0 && --prof_countdown == 0) {
+        prof_countdown = prof_interval;
+        if (prof_count == PROF_MAX_SAMPLES) {
+            prof_dropped++;
+        } else {
+            sample = &prof_samples[(prof_head + prof_count) % PROF_MAX_SAMPLES];
+            sample->eip = frame->eip;
+            sample->pid = cur_pid;
+            prof_count++;
+        }
+    }
+    spin_unlock_irqrestore(&prof_lock, flags);
+}
+
+/* int32_t prof_ctl(int32_t interval);
+ * Inputs: interval = RTC ticks between samples, 0 to stop
+ * Return Value: samples dropped because the buffer was full when stopping,
+ *               0 when starting, -1 on a negative interval
+ * Function: Starting throws away any samples not yet read. Stopping keeps
+ *           them for prof_read. */
+int32_t prof_ctl(int32_t interval) {
+    int32_t ret = 0;
+    uint32_t flags;
+
+    if (interval < 0)
+        return -1;
+
+    spin_lock_irqsave(&prof_lock, flags);
+    if (interval != 0) {
+        prof_head = 0;
+        prof_count = 0;
+        prof_dropped = 0;
+        prof_countdown = interval;
+    } else {
+        ret = prof_dropped;
+    }
+    prof_interval = interval;
+    spin_unlock_irqrestore(&prof_lock, flags);
+    return ret;
+}
+
+/* int32_t prof_read(void* buf, int32_t nbytes);
+ * Inputs: buf = user buffer for prof_sample_t records
+ *         nbytes = size of buf
+ * Return Value: number of bytes copied, -1 if buf is not all user memory
+ * Function: Moves the oldest samples that fit into buf, in whole records */
+int32_t prof_read(void* buf, int32_t nbytes) {
+    prof_sample_t* out = (prof_sample_t*)buf;
+    uint32_t count;
+    uint32_t i;
+    uint32_t flags;
+
+    if (nbytes < 0 || (uint32_t)buf < USER_MEM ||
+        (uint32_t)nbytes > USER_MEM + PAGE_4MB - (uint32_t)buf)
+        return -1;
+
+    spin_lock_irqsave(&prof_lock, flags);
+    count = nbytes / sizeof(prof_sample_t);
+    if (count > prof_count)
+        count = prof_count;
+    for (i = 0; i < count; i++) {
+        out[i] = prof_samples[prof_head];
+        prof_head = (prof_head + 1) % PROF_MAX_SAMPLES;
+    }
+    prof_count -= count;
+    spin_unlock_irqrestore(&prof_lock, flags);
+
+    return count * sizeof(prof_sample_t);
+}
@@ -0,0 +1,34 @@
+/* prof.h - RTC driven sampling profiler
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROF_H
+#define _PROF_H
+
+#include "types.h"
+
+#define PROF_MAX_SAMPLES    4096    // samples held until prof_read drains them
+
+/* One sample, copied out as is by prof_read */
+typedef struct prof_sample {
+    uint32_t eip;           // interrupted instruction
+    uint32_t pid;           // process that was running
+} prof_sample_t;
+
+/* Hardware part of an interrupt frame, as left by the CPU for the wrapper */
+typedef struct irq_frame {
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+} irq_frame_t;
+
+/* Take a sample if the profiler is on and this is the Nth tick */
+void prof_tick(irq_frame_t* frame);
+
+/* Start sampling every interval RTC ticks, or stop with 0 */
+int32_t prof_ctl(int32_t interval);
+
+/* Drain collected samples into a user buffer */
+int32_t prof_read(void* buf, int32_t nbytes);
+
+#endif /* _PROF_H */
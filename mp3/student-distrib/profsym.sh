@@ -0,0 +1,68 @@
+#!/bin/bash
+# Maps the "count pid eip" lines printed by the prof user program to
+# function names.
+#
+# usage: ./profsym.sh <prof output> [user program .exe]
+#
+# Kernel addresses are looked up in ./bootimg. Addresses in the 128MB user
+# page are looked up in the given program, e.g. ../syscalls/fish.exe (or
+# ../fish/fish for fish); without one they are printed as "user".
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <prof output> [user program .exe]"
+    exit 1
+fi
+
+PROFILE=$1
+USER_EXE=$2
+
+{
+    nm -n ./bootimg | awk '$2 ~ /^[Tt]$/ { print "K", $1, $3 }'
+    if [ -n "$USER_EXE" ]; then
+        nm -n "$USER_EXE" | awk '$2 ~ /^[Tt]$/ { print "U", $1, $3 }'
+    fi
+    echo "--"
+    grep -v '^#' "$PROFILE"
+} | awk '
+    function hex(s,    i, c, v) {
+        v = 0
+        s = tolower(s)
+        sub(/^0x/, "", s)
+        for (i = 1; i <= length(s); i++) {
+            c = index("0123456789abcdef", substr(s, i, 1))
+            v = v * 16 + c - 1
+        }
+        return v
+    }
+    function lookup(kind, addr,    lo, hi, mid, n) {
+        n = nsym[kind]
+        if (n == 0 || addr < symaddr[kind, 1])
+            return "?"
+        lo = 1; hi = n
+        while (lo < hi) {
+            mid = int((lo + hi + 1) / 2)
+            if (symaddr[kind, mid] <= addr) lo = mid; else hi = mid - 1
+        }
+        return symname[kind, lo]
+    }
+    !symbols_done && $0 == "--" { symbols_done = 1; next }
+    !symbols_done {
+        n = ++nsym[$1]
+        symaddr[$1, n] = hex($2)
+        symname[$1, n] = $3
+        next
+    }
+    NF == 3 {
+        addr = hex($3)
+        if (addr >= 134217728)              # 128MB, the user program page
+            name = (nsym["U"] ? lookup("U", addr) : "user")
+        else
+            name = lookup("K", addr)
+        total[name] += $1
+        all += $1
+    }
+    END {
+        for (name in total)
+            printf "%8d %5.1f%%  %s\n", total[name], 100 * total[name] / all, name
+    }
+' | sort -rn
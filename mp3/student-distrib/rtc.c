@@ -1,6 +1,10 @@
 #include "rtc.h"
 #include "i8259.h"
 #include "lib.h"
+#include "spinlock.h"
+#include "prof.h"
+#include "sched.h"
+#include "signal.h"
 
 #define RTC_INDEX       0x70
 #define RTC_CMOS        0x71
@@ -17,10 +21,13 @@
 #define MIN_FREQ        2
 
 volatile uint32_t rtc_counter = MAX_FREQ / MIN_FREQ;
-volatile uint32_t rtc_int = 0;
+volatile uint32_t rtc_ticks = 0;    // virtual interrupts so far, read by rtc_read
 uint32_t rtc_max_count = MAX_FREQ / MIN_FREQ;
 
-extern void rtc_handler(void);
+// Guards the virtual rate counters and the RTC index/data ports
+static spinlock_t rtc_lock = SPINLOCK_INIT("rtc");
+
+extern void rtc_handler(irq_frame_t* frame);
 void rtc_change_rate(int32_t frequency);
 char log2(int32_t);
 
@@ -43,22 +50,28 @@ void rtc_init(void) {
     rtc_change_rate(MAX_FREQ);          // Default to maximum rate     
 }
 
-/* void rtc_handler(void);
- * Inputs: void
+/* void rtc_handler(irq_frame_t* frame);
+ * Inputs: frame - where the interrupt came in, passed on to the profiler
  * Return Value: none
  * Function: read from register C to handle interrupts  */
-void rtc_handler(void) {
+void rtc_handler(irq_frame_t* frame) {
     unsigned char temp;
+    uint32_t flags;
+
+    spin_lock_irqsave(&rtc_lock, flags);
     outb(RTC_REGISTER_C,RTC_INDEX);     // select register C
     temp = inb(RTC_CMOS);               // just throw away contents
     (void) temp;
 
     rtc_counter--;
     if(rtc_counter == 0) {
-        rtc_int = 1;
+        ++rtc_ticks;
         rtc_counter = rtc_max_count;
     }
+    spin_unlock_irqrestore(&rtc_lock, flags);
 
+    prof_tick(frame);
+    signal_alarm_tick();
     send_eoi(RTC_IRQ_NUM);
 }
 //upon a IRQ 8,
@@ -72,6 +85,7 @@ void rtc_handler(void) {
  * Function: Write RTC interrupt rate  */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
     int32_t freq;
+    uint32_t flags;
 
     if(buf == NULL) {
         return -1;
@@ -92,9 +106,9 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
         return -1;
     }
 
-    cli();
+    spin_lock_irqsave(&rtc_lock, flags);
     rtc_max_count = MAX_FREQ / freq;
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
     return 0;
 }
 
@@ -103,7 +117,11 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
  * Return Value: positive FD number, -1 on failure
  * Function: Open and initialize RTC device  */
 int32_t rtc_open(const uint8_t* filename) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&rtc_lock, flags);
     rtc_max_count = MAX_FREQ / MIN_FREQ;
+    spin_unlock_irqrestore(&rtc_lock, flags);
     return 0;
 }
 
@@ -119,11 +137,17 @@ int32_t rtc_close(int32_t fd) {
  * Inputs:  fd      - File descriptor number
  *          buf     - Output data pointer
  *          nbytes  - Number of bytes read
- * Return Value: 0 on success, -1 on failure
- * Function: Bock until an RTC int is received  */
+ * Return Value: 0 on success, -1 if a signal arrived first
+ * Function: Bock until an RTC int is received. Waits on a tick count
+ *           rather than a flag, so every process reading wakes up. */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-    rtc_int = 0;
-    while(rtc_int == 0);
+    uint32_t start = rtc_ticks;
+
+    while(rtc_ticks == start) {
+        if(signal_pending())
+            return -1;
+        sched_yield();
+    }
     return 0;
 }
 
@@ -145,16 +169,17 @@ char log2(int32_t num) {
  * Return Value: none
  * Function: calculate rate according to input frequency and change the frequency of rtc */
 void rtc_change_rate(int32_t frequency) {
+    uint32_t flags;
     char rate = MAX_RATE - log2(frequency) + 1;       // frequency =  32768 >> (rate-1);
     rate &= RATE_MASK;
 
     if (rate < MIN_RATE){                             // fastest rate selection is 3
         return;                                       // thus if rate is less than 3, return
     }
-    cli();
+    spin_lock_irqsave(&rtc_lock, flags);
     outb(RTC_REGISTER_A, RTC_INDEX);                  // set index to register A, (disable NMI is unnecessary for interrupts are not enabled)
     char prev = inb(RTC_CMOS);                        // get initial value of register A
     outb(RTC_REGISTER_A, RTC_INDEX);                  // reset index to A
     outb((prev & PREV_MASK) | rate, RTC_CMOS);        // write only our rate to A. Note, rate is the bottom 4 bits.
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
 }
@@ -0,0 +1,243 @@
+/* sched.c - Round-robin process scheduler
+ * vim:ts=4 noexpandtab
+ *
+ * Every process has its own kernel stack. A process that is not running is
+ * parked inside context_switch (syscall_support.S) with its kernel stack
+ * pointer in pcb_t.sched_esp. The timer takes the CPU away from user mode
+ * every tick; kernel code is never preempted and gives the CPU up where it
+ * waits. With several CPUs kernel code still runs on one at a time, under
+ * the kernel lock in smp.c.
+ *
+ * Each CPU has a run queue: the runnable processes whose pcb_t.cpu names
+ * it. A CPU goes round its own queue, and one that finds it empty steals a
+ * process from the longest queue of another CPU.
+ */
+
+#include "sched.h"
+#include "syscall.h"
+#include "paging.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+#define USER_RPL    0x3         // privilege bits of a user code selector
+#define PID_NONE    MAX_PID     // sched_next found nothing to run
+
+extern uint32_t pid_array[PID_MAX];
+extern void context_switch(uint32_t* save_esp, uint32_t new_esp);
+
+/* static int32_t sched_ready(uint32_t pid);
+ * Inputs: pid - process to look at
+ * Return Value: 1 if it is runnable and no CPU runs it right now */
+static int32_t sched_ready(uint32_t pid) {
+    uint32_t i;
+
+    if (!pid_array[pid] || get_pcb(pid)->state != PROC_RUNNABLE)
+        return 0;
+    for (i = 0; i < smp_ncpus; i++) {
+        if (!cpus[i].idle && cpus[i].pid == pid)
+            return 0;
+    }
+    return 1;
+}
+
+/* static uint32_t sched_queued(uint32_t cpu);
+ * Inputs: cpu - index in cpus[]
+ * Return Value: number of processes waiting in its run queue */
+static uint32_t sched_queued(uint32_t cpu) {
+    uint32_t count = 0;
+    uint32_t pid;
+
+    for (pid = 0; pid < MAX_PID; pid++) {
+        if (sched_ready(pid) && get_pcb(pid)->cpu == cpu)
+            count++;
+    }
+    return count;
+}
+
+/* static uint32_t sched_steal(uint32_t self);
+ * Inputs: self - index of the calling CPU
+ * Return Value: a process moved from the longest other run queue to this
+ *               CPU's, PID_NONE if every other queue is empty */
+static uint32_t sched_steal(uint32_t self) {
+    uint32_t victim = self;
+    uint32_t most = 0;
+    uint32_t count;
+    uint32_t i;
+    uint32_t pid;
+
+    for (i = 0; i < smp_ncpus; i++) {
+        if (i == self)
+            continue;
+        count = sched_queued(i);
+        if (count > most) {
+            most = count;
+            victim = i;
+        }
+    }
+    if (most == 0)
+        return PID_NONE;
+    for (pid = 0; pid < MAX_PID; pid++) {
+        if (sched_ready(pid) && get_pcb(pid)->cpu == victim)
+            break;
+    }
+    get_pcb(pid)->cpu = self;
+    return pid;
+}
+
+/* static uint32_t sched_next(void);
+ * Inputs: none
+ * Return Value: the next runnable pid after cur_pid in this CPU's run
+ *               queue, or one stolen from another, PID_NONE if no process
+ *               can run */
+static uint32_t sched_next(void) {
+    uint32_t self = smp_cpu_id();
+    uint32_t i;
+    uint32_t pid;
+
+    for (i = 1; i <= MAX_PID; i++) {
+        pid = (cur_pid + i) % MAX_PID;
+        if (sched_ready(pid) && get_pcb(pid)->cpu == self)
+            return pid;
+    }
+    return sched_steal(self);
+}
+
+/* static void sched_switch(uint32_t next);
+ * Inputs: next - process to run, must not be cur_pid
+ * Return Value: none, returns when this process, or this CPU's idle loop,
+ *               is picked again
+ * Function: Switches address space, kernel stack and TSS to next.
+ *           Interrupts must be off. */
+static void sched_switch(uint32_t next) {
+    cpu_t* cpu = smp_this_cpu();
+    uint32_t* save_esp = cpu->idle ? &cpu->idle_esp : &get_cur_pcb()->sched_esp;
+    pcb_t* next_pcb_ptr = get_pcb(next);
+
+    cpu->idle = 0;
+    cur_pid = next;
+    user_paging_switch(next);
+    cpu->tss->ss0 = KERNEL_DS;
+    cpu->tss->esp0 = next_pcb_ptr->tss_esp0;
+    context_switch(save_esp, next_pcb_ptr->sched_esp);
+}
+
+/* void sched_yield(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Lets the next runnable process run, then comes back. With
+ *           nothing else to run here the other CPUs get the kernel lock
+ *           for a moment, what is waited for may need it. */
+void sched_yield(void) {
+    uint32_t flags;
+    uint32_t next;
+
+    cli_and_save(flags);
+    next = sched_next();
+    if (next != PID_NONE)
+        sched_switch(next);
+    else if (smp_ncpus > 1)
+        kernel_lock_relax();
+    restore_flags(flags);
+}
+
+/* void sched_exit(void);
+ * Inputs: none
+ * Return Value: none, the process has been marked a zombie by halt
+ * Function: Switches away for the last time. On one CPU some other process
+ *           is always runnable: whatever waits in execute does so for a
+ *           child that is either runnable itself or waiting on one. With
+ *           several, that process may be running elsewhere, and this CPU
+ *           goes to its idle loop. */
+void sched_exit(void) {
+    cpu_t* cpu;
+    uint32_t next;
+
+    cli();
+    next = sched_next();
+    if (next != PID_NONE) {
+        sched_switch(next);
+    } else {
+        cpu = smp_this_cpu();
+        cpu->idle = 1;
+        context_switch(&get_cur_pcb()->sched_esp, cpu->idle_esp);
+    }
+}
+
+/* void sched_idle(void);
+ * Inputs: none
+ * Return Value: never returns
+ * Function: Runs whatever this CPU can get from sched_next, and halts
+ *           until the next interrupt while there is nothing. It only
+ *           tries the kernel lock: spinning on it with interrupts off
+ *           would stop the local timer ticks. */
+void sched_idle(void) {
+    uint32_t next;
+
+    while (1) {
+        cli();
+        if (kernel_trylock()) {
+            while ((next = sched_next()) != PID_NONE)
+                sched_switch(next);
+            kernel_unlock();
+        }
+        asm volatile ("sti; hlt");
+    }
+}
+
+/* static void sched_idle_start(void);
+ * Inputs: none
+ * Return Value: never returns
+ * Function: first code of an idle loop sched_idle_init set up. It comes
+ *           from sched_exit, which still holds the kernel lock for the
+ *           process that left. */
+static void sched_idle_start(void) {
+    kernel_unlock();
+    sched_idle();
+}
+
+/* void sched_idle_init(cpu_t* cpu, uint32_t stack_top);
+ * Inputs: cpu - CPU whose idle loop is set up
+ *         stack_top - end of the stack it runs on
+ * Return Value: none
+ * Function: builds what context_switch pops to enter sched_idle_start,
+ *           the way fork does for fork_ret. The word above is its return
+ *           address, never used. */
+void sched_idle_init(cpu_t* cpu, uint32_t stack_top) {
+    switch_frame_t* frame = (switch_frame_t*)(stack_top - sizeof(uint32_t)) - 1;
+
+    memset(frame, 0, sizeof(switch_frame_t));
+    frame->eflags = EFLAGS_RESERVED;
+    frame->ret = (uint32_t)sched_idle_start;
+    cpu->idle_esp = (uint32_t)frame;
+}
+
+/* uint32_t sched_foreground(void);
+ * Inputs: none
+ * Return Value: pid at the end of the chain of execute calls from pid 0
+ * Function: Follows executed (not forked) children down from the base
+ *           shell. A process waiting in execute has exactly one. */
+uint32_t sched_foreground(void) {
+    uint32_t pid = 0;
+    uint32_t i;
+    pcb_t* pcb_ptr;
+
+    if (!pid_array[0])
+        return 0;
+    for (i = 1; i < MAX_PID; i++) {
+        pcb_ptr = get_pcb(i);
+        if (pid_array[i] && !pcb_ptr->forked && pcb_ptr->parent_pid == pid) {
+            pid = i;
+            i = 0;          //start over below the new process
+        }
+    }
+    return pid;
+}
+
+/* void sched_preempt(irq_frame_t* frame);
+ * Inputs: frame - interrupt frame of the timer interrupt
+ * Return Value: none
+ * Function: ends the time slice of a process interrupted in user mode */
+void sched_preempt(irq_frame_t* frame) {
+    if ((frame->cs & USER_RPL) == USER_RPL)
+        sched_yield();
+}
@@ -0,0 +1,51 @@
+/* sched.h - Round-robin process scheduler
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "types.h"
+#include "prof.h"
+#include "smp.h"
+
+/* Process states, kept in pcb_t.state while the pid is in use */
+#define PROC_RUNNABLE   1       // may be given the CPU
+#define PROC_EXECUTING  2       // waiting in execute for a child to halt
+#define PROC_ZOMBIE     3       // halted, waiting for waitpid
+
+#define EFLAGS_RESERVED 0x2     // EFLAGS bit 1 always reads as set
+
+/* What context_switch pops off a stack it resumes, lowest address first */
+typedef struct {
+    uint32_t eflags;
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebx;
+    uint32_t ebp;
+    uint32_t ret;
+} switch_frame_t;
+
+/* Gives the CPU to the next runnable process, if there is one. Kernel code
+ * that waits for something calls this in its loop. */
+void sched_yield(void);
+
+/* Leaves a halted process for good, never returns */
+void sched_exit(void);
+
+/* Runs processes on a CPU that has none, never returns. The APs start
+ * here, the bootstrap processor only comes here through sched_exit. */
+void sched_idle(void);
+
+/* Sets up a CPU's sched_idle to start on the stack ending at stack_top */
+void sched_idle_init(cpu_t* cpu, uint32_t stack_top);
+
+/* The process the keyboard belongs to: the newest program the base shell
+ * waits on through execute, 0 if the shell itself is at the prompt */
+uint32_t sched_foreground(void);
+
+/* Called by the timer linkage after every tick. Only preempts user mode;
+ * the kernel itself switches only where it calls sched_yield. */
+void sched_preempt(irq_frame_t* frame);
+
+#endif /* _SCHED_H */
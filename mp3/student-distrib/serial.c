@@ -0,0 +1,248 @@
+/* serial.c - 16550 UART on COM1, the ttyS0 device and console mirror
+ * vim:ts=4 noexpandtab
+ */
+
+#include "serial.h"
+#include "i8259.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "sched.h"
+#include "signal.h"
+
+#define COM1            0x3F8
+#define SERIAL_IRQ_NUM  4
+
+/* Register offsets from COM1 */
+#define UART_DATA       0           // THR on write, RBR on read
+#define UART_IER        1
+#define UART_IIR        2           // FCR on write
+#define UART_LCR        3
+#define UART_MCR        4
+#define UART_LSR        5
+#define UART_SCRATCH    7
+#define UART_DLL        0           // divisor latch while LCR_DLAB is set
+#define UART_DLM        1
+
+#define LCR_8N1         0x03
+#define LCR_DLAB        0x80
+#define DIVISOR_115200  1
+#define FCR_ENABLE      0xC7        // enable and clear both FIFOs, receive trigger at 14 bytes
+#define MCR_OUT2        0x0B        // DTR, RTS and OUT2, which gates the IRQ line
+#define IER_RX          0x01
+#define IER_TX          0x02        // transmit holding register empty
+#define IIR_NONE        0x01        // no interrupt pending
+#define IIR_ID_MASK     0x0E
+#define IIR_TX          0x02
+#define LSR_RX_READY    0x01
+#define LSR_TX_EMPTY    0x20        // THR and the transmit FIFO are empty
+#define SCRATCH_PROBE   0x5A
+#define UART_FIFO_SIZE  16
+
+uint32_t serial_console = 0;
+
+static uint32_t serial_present = 0;
+static uint8_t serial_ier = IER_RX;
+
+/* Free-running ring indices, the slot is the index mod the size */
+static uint8_t tx_ring[SERIAL_TX_SIZE];
+static uint32_t tx_head, tx_tail;
+static uint8_t rx_ring[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head, rx_tail;
+
+// Guards both rings and serial_ier
+static spinlock_t serial_lock = SPINLOCK_INIT("serial");
+
+/* void serial_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: checks for a UART through its scratch register, then sets the
+ *           line up. Only the receive interrupt is on until there is
+ *           something to send. */
+void serial_init(void) {
+    outb(SCRATCH_PROBE, COM1 + UART_SCRATCH);
+    if (inb(COM1 + UART_SCRATCH) != SCRATCH_PROBE)
+        return;
+
+    outb(0, COM1 + UART_IER);
+    outb(LCR_DLAB, COM1 + UART_LCR);
+    outb(DIVISOR_115200, COM1 + UART_DLL);
+    outb(0, COM1 + UART_DLM);
+    outb(LCR_8N1, COM1 + UART_LCR);
+    outb(FCR_ENABLE, COM1 + UART_IIR);
+    outb(MCR_OUT2, COM1 + UART_MCR);
+    outb(serial_ier, COM1 + UART_IER);
+
+    serial_present = 1;
+    enable_irq(SERIAL_IRQ_NUM);
+}
+
+/* static void serial_tx_fill(uint32_t max);
+ * Inputs: max - bytes the transmitter can take now
+ * Return Value: none
+ * Function: moves bytes from the ring to the UART. Called with
+ *           serial_lock held. */
+static void serial_tx_fill(uint32_t max) {
+    while (max-- > 0 && tx_tail != tx_head) {
+        outb(tx_ring[tx_tail % SERIAL_TX_SIZE], COM1 + UART_DATA);
+        tx_tail++;
+    }
+}
+
+/* static void serial_tx_poll(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: waits for the transmit FIFO to empty and refills it, for when
+ *           the interrupt cannot be waited for. Called with serial_lock
+ *           held. */
+static void serial_tx_poll(void) {
+    while (!(inb(COM1 + UART_LSR) & LSR_TX_EMPTY))
+        asm volatile ("pause");
+    serial_tx_fill(UART_FIFO_SIZE);
+}
+
+/* void serial_write(const int8_t* buf, int32_t n);
+ * Inputs: buf - bytes to send
+ *         n - number of bytes
+ * Return Value: none
+ * Function: Queues the bytes and turns the transmit interrupt on, which
+ *           fires at once if the UART is idle. Early boot output, before
+ *           interrupts are enabled, drains by polling whenever the ring
+ *           fills. */
+void serial_write(const int8_t* buf, int32_t n) {
+    uint32_t flags;
+    int32_t i;
+
+    if (!serial_present || n <= 0)
+        return;
+
+    spin_lock_irqsave(&serial_lock, flags);
+    for (i = 0; i < n; i++) {
+        if (tx_head - tx_tail == SERIAL_TX_SIZE)
+            serial_tx_poll();
+        tx_ring[tx_head % SERIAL_TX_SIZE] = buf[i];
+        tx_head++;
+    }
+    if (!(serial_ier & IER_TX)) {
+        serial_ier |= IER_TX;
+        outb(serial_ier, COM1 + UART_IER);
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+/* void serial_flush(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: sends the rest of the ring by polling and waits until the
+ *           last byte has left, e.g. before QEMU is told to exit */
+void serial_flush(void) {
+    uint32_t flags;
+
+    if (!serial_present)
+        return;
+
+    spin_lock_irqsave(&serial_lock, flags);
+    while (tx_tail != tx_head)
+        serial_tx_poll();
+    while (!(inb(COM1 + UART_LSR) & LSR_TX_EMPTY))
+        asm volatile ("pause");
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+/* void serial_handler(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Handles every cause the UART reports until none is left. A
+ *           transmit interrupt means the whole FIFO is free; once the ring
+ *           is empty the transmit interrupt is turned off again. Received
+ *           bytes that do not fit in the ring are dropped. */
+void serial_handler(void) {
+    uint32_t flags;
+    uint8_t iir;
+
+    spin_lock_irqsave(&serial_lock, flags);
+    while (!((iir = inb(COM1 + UART_IIR)) & IIR_NONE)) {
+        if ((iir & IIR_ID_MASK) == IIR_TX) {
+            serial_tx_fill(UART_FIFO_SIZE);
+            if (tx_tail == tx_head) {
+                serial_ier &= ~IER_TX;
+                outb(serial_ier, COM1 + UART_IER);
+            }
+            continue;
+        }
+        //Receive data, receive timeout and line status all end up here,
+        //reading the line status register clears the last one
+        while (inb(COM1 + UART_LSR) & LSR_RX_READY) {
+            if (rx_head - rx_tail < SERIAL_RX_SIZE)
+                rx_ring[rx_head++ % SERIAL_RX_SIZE] = inb(COM1 + UART_DATA);
+            else
+                inb(COM1 + UART_DATA);
+        }
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+    send_eoi(SERIAL_IRQ_NUM);
+}
+
+/* int32_t serial_lookup(const uint8_t* fname, dentry_t* dentry);
+ * Inputs: fname - file name to search
+ *         dentry - dentry object to copy data into
+ * Return Value: 0 if fname is the serial device, -1 otherwise */
+int32_t serial_lookup(const uint8_t* fname, dentry_t* dentry) {
+    if (strncmp((int8_t*)fname, SERIAL_NAME, MAX_FILENAME))
+        return -1;
+    strncpy((int8_t*)dentry->fname, SERIAL_NAME, MAX_FILENAME);
+    dentry->ftype = SERIAL_FTYPE;
+    dentry->inode_num = 0;
+    return 0;
+}
+
+/* int32_t serial_open(const uint8_t* fname);
+ * Inputs: fname - not used
+ * Return Value: 0, -1 if there is no UART */
+int32_t serial_open(const uint8_t* fname) {
+    return serial_present ? 0 : -1;
+}
+
+/* int32_t serial_close(int32_t fd);
+ * Inputs: fd - not used
+ * Return Value: 0 */
+int32_t serial_close(int32_t fd) {
+    return 0;
+}
+
+/* int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - not used
+ *         buf - destination for the received bytes
+ *         nbytes - most bytes to return
+ * Return Value: bytes read, -1 if a signal arrived before any
+ * Function: waits for at least one byte, then returns what has arrived */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint32_t flags;
+    int32_t i;
+
+    if (buf == NULL || nbytes <= 0)
+        return 0;
+
+    while (rx_head == rx_tail) {
+        if (signal_pending())
+            return -1;
+        sched_yield();
+    }
+
+    spin_lock_irqsave(&serial_lock, flags);
+    for (i = 0; i < nbytes && rx_tail != rx_head; i++)
+        ((uint8_t*)buf)[i] = rx_ring[rx_tail++ % SERIAL_RX_SIZE];
+    spin_unlock_irqrestore(&serial_lock, flags);
+    return i;
+}
+
+/* int32_t serial_fwrite(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - not used
+ *         buf - bytes to send
+ *         nbytes - number of bytes
+ * Return Value: nbytes, they are all queued when this returns */
+int32_t serial_fwrite(int32_t fd, const void* buf, int32_t nbytes) {
+    if (buf == NULL || nbytes < 0)
+        return -1;
+    serial_write(buf, nbytes);
+    return nbytes;
+}
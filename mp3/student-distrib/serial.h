@@ -0,0 +1,44 @@
+/* serial.h - 16550 UART on COM1, the ttyS0 device and console mirror
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "fs_driver.h"
+
+#define SERIAL_FTYPE    4           // dentry ftype of the ttyS0 device
+#define SERIAL_NAME     "ttyS0"
+#define SERIAL_TX_SIZE  4096        // bytes queued for the UART, a power of 2
+#define SERIAL_RX_SIZE  256         // bytes received and not read yet, a power of 2
+
+/* Set to copy everything printed on the console to the serial port,
+ * "serial" on the kernel command line turns it on */
+extern uint32_t serial_console;
+
+/* Sets COM1 to 115200 8N1 with FIFOs and unmasks IRQ 4. Leaves the port
+ * unused if no UART answers there. */
+void serial_init(void);
+
+/* Queues n bytes for sending. Returns once they are all queued; if the
+ * ring is full the oldest bytes are pushed out by polling first, so
+ * nothing is ever dropped. */
+void serial_write(const int8_t* buf, int32_t n);
+
+/* Polls until everything queued has left the UART */
+void serial_flush(void);
+
+/* Fills in the dentry for SERIAL_NAME, -1 for any other name */
+int32_t serial_lookup(const uint8_t* fname, dentry_t* dentry);
+
+/* Handles IRQ 4: refills the transmit FIFO and takes received bytes */
+void serial_handler(void);
+
+/* ttyS0 file operations */
+int32_t serial_open(const uint8_t* fname);
+int32_t serial_close(int32_t fd);
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t serial_fwrite(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _SERIAL_H */
@@ -0,0 +1,193 @@
+/* signal.c - Signal delivery to user programs
+ * vim:ts=4 noexpandtab
+ *
+ * Signals are bits in the pcb's pending bitmap. Nothing happens when one is
+ * sent; signal_return (signal_support.S) checks the bitmap against the mask
+ * whenever the kernel goes back to user mode and only then builds the
+ * handler's frame on the user stack.
+ */
+
+#include "signal.h"
+#include "syscall.h"
+#include "paging.h"
+#include "lib.h"
+
+#define ALARM_TICKS     (10 * 1024)     // RTC interrupts between alarms
+#define EFLAGS_IF       0x0200
+#define EFLAGS_USER     0x0DD5          // flags a user program may change: CF PF AF ZF SF TF DF OF
+
+extern uint32_t pid_array[PID_MAX];
+extern uint8_t sigreturn_tramp[];
+extern uint8_t sigreturn_tramp_end[];
+
+static uint32_t alarm_countdown = ALARM_TICKS;
+
+/* signal_return reads the bitmaps at fixed offsets, fail the build if they move */
+typedef char pcb_sig_offsets_check[
+    (__builtin_offsetof(pcb_t, sig_pending) == PCB_SIG_PENDING &&
+     __builtin_offsetof(pcb_t, sig_mask) == PCB_SIG_MASK) ? 1 : -1];
+
+/* Stack layout the handler starts with, lowest address first */
+typedef struct signal_frame {
+    uint32_t ret;                   // points at code
+    int32_t signum;
+    hw_context_t context;
+    uint8_t code[8];                // copy of sigreturn_tramp
+} signal_frame_t;
+
+/* static int32_t user_range_ok(uint32_t addr, uint32_t size);
+ * Inputs: addr, size - user memory about to be touched
+ * Return Value: 1 if it lies inside the program's 4MB, 0 if not */
+static int32_t user_range_ok(uint32_t addr, uint32_t size) {
+    return addr >= USER_MEM && addr <= USER_MEM + PAGE_4MB - size;
+}
+
+/* void signal_send(uint32_t pid, int32_t signum);
+ * Inputs: pid - process to signal
+ *         signum - signal number
+ * Return Value: none
+ * Function: sets the signal's pending bit, delivery happens the next time
+ *           the process returns to user mode */
+void signal_send(uint32_t pid, int32_t signum) {
+    pcb_t* pcb_ptr = get_pcb(pid);
+
+    asm volatile("lock btsl %1, %0"
+                 : "+m"(pcb_ptr->sig_pending)
+                 : "r"(signum)
+                 : "memory", "cc");
+}
+
+/* int32_t signal_fault(int32_t signum);
+ * Inputs: signum - DIV_ZERO or SEGFAULT
+ * Return Value: 1 if the exception will go to a handler, 0 if not
+ * Function: Sends the exception's signal to the running process if it has
+ *           a handler that can take it now. A fault inside a handler, with
+ *           every signal masked, cannot be delivered and kills. */
+int32_t signal_fault(int32_t signum) {
+    pcb_t* pcb_ptr = get_cur_pcb();
+
+    if (pcb_ptr->sig_handler[signum] == NULL || (pcb_ptr->sig_mask & (1 << signum)))
+        return 0;
+    signal_send(cur_pid, signum);
+    return 1;
+}
+
+/* int32_t signal_pending(void);
+ * Inputs: none
+ * Return Value: 1 if an unmasked pending signal will not just be ignored */
+int32_t signal_pending(void) {
+    pcb_t* pcb_ptr = get_cur_pcb();
+    uint32_t ready;
+    int32_t signum;
+
+    if (!pid_array[cur_pid])
+        return 0;
+    ready = pcb_ptr->sig_pending & ~pcb_ptr->sig_mask;
+    for (signum = 0; signum < NUM_SIGNALS; ++signum) {
+        if ((ready & (1 << signum)) &&
+           (pcb_ptr->sig_handler[signum] != NULL || (signum != ALARM && signum != USER1)))
+            return 1;
+    }
+    return 0;
+}
+
+/* void signal_deliver(hw_context_t* ctx);
+ * Inputs: ctx - user registers saved by signal_return, changed in place
+ * Return Value: none, does not return if the signal kills
+ * Function: Takes the first unmasked pending signal. Without a handler the
+ *           default action either ignores it or ends the process, like an
+ *           exception would for DIV_ZERO and SEGFAULT. With
+ *           one, the user stack gets the sigreturn code, a copy of ctx,
+ *           the signal number and a return address into that code, and
+ *           ctx is pointed at the handler. Every signal is masked until
+ *           sigreturn. */
+void signal_deliver(hw_context_t* ctx) {
+    pcb_t* pcb_ptr = get_cur_pcb();
+    signal_frame_t* frame;
+    uint32_t ready;
+    uint32_t flags;
+    int32_t signum;
+
+    cli_and_save(flags);
+    ready = pcb_ptr->sig_pending & ~pcb_ptr->sig_mask;
+    for (signum = 0; !(ready & (1 << signum)); ++signum);
+    pcb_ptr->sig_pending &= ~(1 << signum);
+    restore_flags(flags);
+
+    if (pcb_ptr->sig_handler[signum] == NULL) {
+        if (signum == ALARM || signum == USER1)
+            return;
+        process_exit(signum == INTERRUPT ? SIG_KILL_STATUS : EXCEPTION_STATUS);
+    }
+
+    frame = (signal_frame_t*)(ctx->esp - sizeof(signal_frame_t));
+    if (!user_range_ok((uint32_t)frame, sizeof(signal_frame_t)))
+        process_exit(EXCEPTION_STATUS);
+
+    memcpy(frame->code, sigreturn_tramp, sigreturn_tramp_end - sigreturn_tramp);
+    frame->context = *ctx;
+    frame->signum = signum;
+    frame->ret = (uint32_t)frame->code;
+
+    pcb_ptr->sig_saved_mask = pcb_ptr->sig_mask;
+    pcb_ptr->sig_mask = SIG_ALL;
+    ctx->esp = (uint32_t)frame;
+    ctx->eip = (uint32_t)pcb_ptr->sig_handler[signum];
+}
+
+/* void signal_alarm_tick(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: called on every RTC interrupt, which runs at 1024Hz */
+void signal_alarm_tick(void) {
+    if (--alarm_countdown != 0)
+        return;
+    alarm_countdown = ALARM_TICKS;
+    //An idle CPU's cur_pid is just the last process it ran
+    if (!smp_this_cpu()->idle && pid_array[cur_pid])
+        signal_send(cur_pid, ALARM);
+}
+
+/* int32_t set_handler(int32_t signum, void* handler_address)
+ * Inputs      : signum - signal to handle
+ *               handler_address - user function, NULL for the default action
+ * Return Value: 0 on success, -1 for a bad signal number or address */
+int32_t set_handler(int32_t signum, void* handler_address) {
+    if (signum < 0 || signum >= NUM_SIGNALS)
+        return -1;
+    if (handler_address != NULL && !user_range_ok((uint32_t)handler_address, 1))
+        return -1;
+    get_cur_pcb()->sig_handler[signum] = handler_address;
+    return 0;
+}
+
+/* int32_t sigreturn(void)
+ * Inputs      : none, called by the code a handler returns into
+ * Return Value: the interrupted program's eax, -1 if its stack is bad
+ * Function    : Copies the hw_context_t the handler was given back over the
+ *               registers this syscall returns to user mode with, and lifts
+ *               the mask set for the handler. The code and stack segments
+ *               are kept and only the arithmetic flags can change. */
+int32_t sigreturn(void) {
+    pcb_t* pcb_ptr = get_cur_pcb();
+    syscall_regs_t* regs = (syscall_regs_t*)(pcb_ptr->tss_esp0 - sizeof(syscall_regs_t));
+    hw_context_t* ctx;
+
+    //The handler's ret popped the return address, the signal number is next
+    ctx = (hw_context_t*)(regs->user_esp + sizeof(int32_t));
+    if (!user_range_ok((uint32_t)ctx, sizeof(hw_context_t)))
+        return -1;
+
+    regs->ebx = ctx->ebx;
+    regs->ecx = ctx->ecx;
+    regs->edx = ctx->edx;
+    regs->esi = ctx->esi;
+    regs->edi = ctx->edi;
+    regs->ebp = ctx->ebp;
+    regs->user_eip = ctx->eip;
+    regs->user_esp = ctx->esp;
+    regs->user_eflags = (regs->user_eflags & ~EFLAGS_USER) | (ctx->eflags & EFLAGS_USER) | EFLAGS_IF;
+
+    pcb_ptr->sig_mask = pcb_ptr->sig_saved_mask;
+    return ctx->eax;
+}
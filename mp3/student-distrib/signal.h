@@ -0,0 +1,72 @@
+/* signal.h - Signal delivery to user programs
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+/* The return-to-user check in signal_support.S finds these pcb_t fields by
+ * offset; the pcb sits at the bottom of the process's 8kB kernel stack */
+#define PCB_STACK_MASK      0xFFFFE000
+#define PCB_SIG_PENDING     0
+#define PCB_SIG_MASK        4
+
+#define SIGRETURN_NUM       10      /* syscall the handler's return runs */
+
+#ifndef ASM
+
+#include "types.h"
+
+#define DIV_ZERO        0       /* default: kill */
+#define SEGFAULT        1       /* default: kill */
+#define INTERRUPT       2       /* default: kill */
+#define ALARM           3       /* default: ignore */
+#define USER1           4       /* default: ignore */
+#define NUM_SIGNALS     5
+
+#define SIG_ALL         ((1 << NUM_SIGNALS) - 1)
+#define SIG_KILL_STATUS 255     /* halt status of a process INTERRUPT kills */
+
+/* Registers of the interrupted user program, in the order the handler
+ * finds them on its stack after the signal number (lowest address first) */
+typedef struct hw_context {
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t eax;
+    uint32_t ds;
+    uint32_t es;
+    uint32_t fs;
+    uint32_t vec;           /* not recorded, always -1 */
+    uint32_t error;         /* not recorded, always 0 */
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+    uint32_t esp;
+    uint32_t ss;
+} hw_context_t;
+
+/* Marks a signal pending for a process. Safe from interrupt handlers. */
+void signal_send(uint32_t pid, int32_t signum);
+
+/* Raises signum for an exception the running user program caused. Returns
+ * 1 if a handler will take it, 0 if the process has to be killed. */
+int32_t signal_fault(int32_t signum);
+
+/* Returns 1 if the running process has a signal waiting that will run a
+ * handler or kill it. Kernel waits give up early when this is set. */
+int32_t signal_pending(void);
+
+/* Runs the first pending signal, called from signal_support.S on the way
+ * back to user mode with the user registers saved in ctx */
+void signal_deliver(hw_context_t* ctx);
+
+/* Counts RTC interrupts and sends ALARM to the running process every
+ * ten seconds */
+void signal_alarm_tick(void);
+
+#endif /* ASM */
+#endif /* _SIGNAL_H */
@@ -0,0 +1,440 @@
+/* smp.c - Finding and starting the other processors
+ * vim:ts=4 noexpandtab
+ *
+ * Every CPU gets its own TSS, page directory and cur_pid, and runs
+ * processes from its own run queue, see sched.c. Kernel code itself runs
+ * on one CPU at a time under the kernel lock below, so the data it shares
+ * needs no locking of its own.
+ */
+
+#include "smp.h"
+#include "apic.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "pit.h"
+#include "ioapic.h"
+#include "lib.h"
+#include "sched.h"
+#include "spinlock.h"
+
+#define MP_FLOAT_SIG        0x5F504D5F  // "_MP_"
+#define MP_CONFIG_SIG       0x504D4350  // "PCMP"
+#define BDA_EBDA_SEG        0x40E       // segment of the extended BIOS data area
+#define BDA_BASE_KB         0x413       // kB of base memory
+#define BIOS_ROM_START      0xF0000
+#define BIOS_ROM_END        0x100000
+#define MP_SCAN_LEN         0x400       // first kB of the EBDA / last kB of base memory
+#define MP_ALIGN            16
+
+#define MP_ENTRY_CPU        0
+#define MP_ENTRY_BUS        1
+#define MP_ENTRY_IOAPIC     2
+#define MP_ENTRY_IOINT      3
+#define MP_CPU_LEN          20          // every other entry type is 8 bytes
+#define MP_OTHER_LEN        8
+#define MP_CPU_ENABLED      0x1
+#define MP_CPU_BSP          0x2
+#define MP_IOAPIC_ENABLED   0x1
+#define MP_INT_VECTORED     0           // IO interrupt entry for an ordinary interrupt
+#define MP_IMCR_PRESENT     0x80        // feature byte 2: PICs wired to the CPU at reset
+#define MP_BUS_ISA          "ISA"
+
+#define AP_WAIT_TICKS       10          // 100ms for an AP to report in after each startup IPI
+
+/* MP floating pointer structure, see the MultiProcessor Specification 1.4 */
+typedef struct __attribute__((packed)) mp_float {
+    uint32_t signature;
+    uint32_t config;                    // physical address of mp_config_t
+    uint8_t length;                     // in 16 byte units
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t features[5];
+} mp_float_t;
+
+typedef struct __attribute__((packed)) mp_config {
+    uint32_t signature;
+    uint16_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t oem_id[20];
+    uint32_t oem_table;
+    uint16_t oem_length;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+typedef struct __attribute__((packed)) mp_cpu {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_cpu_t;
+
+typedef struct __attribute__((packed)) mp_bus {
+    uint8_t type;
+    uint8_t bus_id;
+    int8_t bus_type[6];                 // space padded
+} mp_bus_t;
+
+typedef struct __attribute__((packed)) mp_ioapic {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t addr;
+} mp_ioapic_t;
+
+typedef struct __attribute__((packed)) mp_ioint {
+    uint8_t type;
+    uint8_t int_type;
+    uint16_t flags;                     // polarity and trigger mode
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic_id;
+    uint8_t dst_pin;
+} mp_ioint_t;
+
+/* Start and end of the real mode code copied to AP_BOOT_ADDR, and the
+ * stack and page directory the next AP to start takes, see smp_boot.S */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint32_t ap_boot_stack;
+extern uint32_t ap_boot_dir;
+extern uint32_t ap_cr0;
+extern uint32_t ap_cr4;
+
+cpu_t cpus[SMP_MAX_CPUS];
+uint32_t smp_ncpus = 0;
+
+/* Stacks of sched_idle, cpus[i] uses idle_stacks[i]. The APs also boot on
+ * theirs. */
+static uint8_t idle_stacks[SMP_MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned (AP_STACK_SIZE)));
+
+/* Task state segments of the APs, the bootstrap processor has tss */
+static tss_t ap_tss[SMP_MAX_CPUS - 1];
+
+static spinlock_t kernel_spin = SPINLOCK_INIT("kernel");
+
+/* static uint8_t mp_sum(const void* data, uint32_t len);
+ * Inputs: data - structure to check
+ *         len - its length in bytes
+ * Return Value: sum of the bytes, 0 for a valid MP structure */
+static uint8_t mp_sum(const void* data, uint32_t len) {
+    const uint8_t* bytes = data;
+    uint8_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+        sum += bytes[i];
+    return sum;
+}
+
+/* static mp_float_t* mp_search(uint32_t start, uint32_t len);
+ * Inputs: start - physical address to search from
+ *         len - bytes to search
+ * Return Value: the floating pointer structure, NULL if there is none
+ * Function: it sits on a 16 byte boundary */
+static mp_float_t* mp_search(uint32_t start, uint32_t len) {
+    uint32_t addr;
+    mp_float_t* mp;
+
+    for (addr = start; addr + sizeof(mp_float_t) <= start + len; addr += MP_ALIGN) {
+        mp = (mp_float_t*)addr;
+        if (mp->signature == MP_FLOAT_SIG && !mp_sum(mp, mp->length * MP_ALIGN))
+            return mp;
+    }
+    return NULL;
+}
+
+/* static void mp_io_entries(mp_config_t* conf, uint32_t imcr);
+ * Inputs: conf - MP configuration table
+ *         imcr - 1 if the floating pointer says the board has an IMCR
+ * Return Value: none
+ * Function: hands the IO APIC and the routes of the ISA IRQs to ioapic.c.
+ *           Bus entries come first in the table, so the ISA bus is known
+ *           by the time its interrupt entries appear. */
+static void mp_io_entries(mp_config_t* conf, uint32_t imcr) {
+    uint8_t* pos = (uint8_t*)(conf + 1);
+    uint32_t isa_bus = -1;
+    mp_bus_t* bus;
+    mp_ioapic_t* ioapic;
+    mp_ioint_t* ioint;
+    uint32_t i;
+
+    for (i = 0; i < conf->entry_count; i++) {
+        switch (*pos) {
+        case MP_ENTRY_CPU:
+            pos += MP_CPU_LEN;
+            continue;
+        case MP_ENTRY_BUS:
+            bus = (mp_bus_t*)pos;
+            if (!strncmp(bus->bus_type, MP_BUS_ISA, sizeof(MP_BUS_ISA) - 1))
+                isa_bus = bus->bus_id;
+            break;
+        case MP_ENTRY_IOAPIC:
+            ioapic = (mp_ioapic_t*)pos;
+            //The APIC window in paging.c covers only the usual address
+            if ((ioapic->flags & MP_IOAPIC_ENABLED) && (ioapic->addr >> 22) == APIC_INDEX)
+                ioapic_found(ioapic->addr, imcr);
+            break;
+        case MP_ENTRY_IOINT:
+            ioint = (mp_ioint_t*)pos;
+            if (ioint->int_type == MP_INT_VECTORED && ioint->src_bus == isa_bus)
+                ioapic_set_route(ioint->src_irq, ioint->dst_pin, ioint->flags);
+            break;
+        }
+        pos += MP_OTHER_LEN;
+    }
+}
+
+/* void smp_scan(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: finds the floating pointer where the MP spec says to look and
+ *           fills in cpus[] from the processor entries of its table. With
+ *           no valid table the kernel stays on one CPU with the 8259s. */
+void smp_scan(void) {
+    mp_float_t* mp;
+    mp_config_t* conf;
+    mp_cpu_t* entry;
+    uint8_t* pos;
+    uint32_t i, slot;
+
+    smp_ncpus = 1;
+    cpus[0].tss = &tss;
+    mp = mp_search(*(uint16_t*)BDA_EBDA_SEG << 4, MP_SCAN_LEN);
+    if (!mp)
+        mp = mp_search(*(uint16_t*)BDA_BASE_KB * 1024 - MP_SCAN_LEN, MP_SCAN_LEN);
+    if (!mp)
+        mp = mp_search(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+    if (!mp || !mp->config)
+        return;
+
+    conf = (mp_config_t*)mp->config;
+    if (conf->signature != MP_CONFIG_SIG || mp_sum(conf, conf->length))
+        return;
+    //The APIC window in paging.c covers only the usual address
+    if ((conf->lapic_addr >> 22) != APIC_INDEX)
+        return;
+    lapic_addr = conf->lapic_addr;
+
+    pos = (uint8_t*)(conf + 1);
+    for (i = 0; i < conf->entry_count; i++) {
+        if (*pos != MP_ENTRY_CPU) {
+            pos += MP_OTHER_LEN;
+            continue;
+        }
+        entry = (mp_cpu_t*)pos;
+        pos += MP_CPU_LEN;
+        if (!(entry->flags & MP_CPU_ENABLED))
+            continue;
+
+        if (entry->flags & MP_CPU_BSP) {
+            slot = 0;
+        } else {
+            if (smp_ncpus == SMP_MAX_CPUS)
+                continue;
+            slot = smp_ncpus++;
+        }
+        cpus[slot].apic_id = entry->apic_id;
+    }
+
+    mp_io_entries(conf, !!(mp->features[1] & MP_IMCR_PRESENT));
+}
+
+/* static void ap_tss_init(uint32_t i);
+ * Inputs: i - AP whose TSS and GDT entry are set up
+ * Return Value: none
+ * Function: same descriptor kernel.c builds for the bootstrap processor */
+static void ap_tss_init(uint32_t i) {
+    seg_desc_t the_tss_desc;
+
+    the_tss_desc.granularity   = 0x0;
+    the_tss_desc.opsize        = 0x0;
+    the_tss_desc.reserved      = 0x0;
+    the_tss_desc.avail         = 0x0;
+    the_tss_desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
+    the_tss_desc.present       = 0x1;
+    the_tss_desc.dpl           = 0x0;
+    the_tss_desc.sys           = 0x0;
+    the_tss_desc.type          = 0x9;
+    the_tss_desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
+
+    SET_TSS_PARAMS(the_tss_desc, &ap_tss[i - 1], tss_size);
+    ap_tss_desc_ptr[i - 1] = the_tss_desc;
+
+    ap_tss[i - 1].ldt_segment_selector = KERNEL_LDT;
+    ap_tss[i - 1].ss0 = KERNEL_DS;
+    cpus[i].tss = &ap_tss[i - 1];
+}
+
+/* static int32_t ap_wait(cpu_t* cpu);
+ * Inputs: cpu - AP that was just sent a startup IPI
+ * Return Value: 1 once it is online, 0 if it did not show up in time */
+static int32_t ap_wait(cpu_t* cpu) {
+    uint32_t start = pit_ticks;
+
+    while (!cpu->online && pit_ticks - start < AP_WAIT_TICKS)
+        asm volatile ("pause");
+    return cpu->online;
+}
+
+/* void smp_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: starts the APs one at a time, each on its own stack, so that
+ *           ap_main can tell from ap_boot_stack which one it is. An AP
+ *           that does not come up stays offline. With APs around the
+ *           bootstrap processor gets an idle loop too, for when they run
+ *           every process there is. */
+void smp_init(void) {
+    uint32_t i;
+
+    cpus[0].online = 1;
+    if (smp_ncpus < 2)
+        return;
+
+    sched_idle_init(&cpus[0], (uint32_t)idle_stacks[0] + AP_STACK_SIZE);
+    lapic_enable();
+    lapic_timer_calibrate();
+    memcpy((void*)AP_BOOT_ADDR, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    //The APs run the same kernel code, the SSE memcpy included, with
+    //caching on like here
+    asm volatile ("movl %%cr0, %0" : "=r"(ap_cr0));
+    asm volatile ("movl %%cr4, %0" : "=r"(ap_cr4));
+
+    for (i = 1; i < smp_ncpus; i++) {
+        ap_tss_init(i);
+        cpus[i].dir = paging_ap_init();
+        cpus[i].idle = 1;
+        ap_boot_dir = (uint32_t)cpus[i].dir;
+        ap_boot_stack = (uint32_t)idle_stacks[i] + AP_STACK_SIZE;
+        if (lapic_start_ap(cpus[i].apic_id, AP_BOOT_ADDR >> 12))
+            continue;
+        //The MP spec sends the startup IPI twice, the second is only
+        //needed if the first was lost
+        if (!ap_wait(&cpus[i]) && !lapic_sipi(cpus[i].apic_id, AP_BOOT_ADDR >> 12))
+            ap_wait(&cpus[i]);
+    }
+}
+
+/* void kernel_lock(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Waits for the kernel lock, or nests on it if this CPU holds
+ *           it already. Interrupts stay off while the depth and the lock
+ *           disagree, an interrupt in between would think it is held. */
+void kernel_lock(void) {
+    cpu_t* cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = smp_this_cpu();
+    if (cpu->lock_depth++ == 0)
+        spin_lock(&kernel_spin);
+    restore_flags(flags);
+}
+
+/* void kernel_unlock(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: undoes one kernel_lock, the last one frees the lock */
+void kernel_unlock(void) {
+    cpu_t* cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = smp_this_cpu();
+    if (--cpu->lock_depth == 0)
+        spin_unlock(&kernel_spin);
+    restore_flags(flags);
+}
+
+/* int32_t kernel_trylock(void);
+ * Inputs: none
+ * Return Value: 1 if the lock was taken, 0 if another CPU holds it
+ * Function: for the idle loop, which must not stop taking interrupts */
+int32_t kernel_trylock(void) {
+    cpu_t* cpu;
+    uint32_t flags;
+    int32_t taken = 1;
+
+    cli_and_save(flags);
+    cpu = smp_this_cpu();
+    if (cpu->lock_depth == 0)
+        taken = spin_trylock(&kernel_spin);
+    if (taken)
+        ++cpu->lock_depth;
+    restore_flags(flags);
+    return taken;
+}
+
+/* void kernel_lock_relax(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Frees the lock and takes it back at the same depth. Kernel
+ *           code waiting on another CPU, or on an interrupt only the
+ *           bootstrap processor gets, calls this through sched_yield. */
+void kernel_lock_relax(void) {
+    cpu_t* cpu = smp_this_cpu();
+    uint32_t depth = cpu->lock_depth;
+
+    cpu->lock_depth = 0;
+    spin_unlock(&kernel_spin);
+    asm volatile ("pause");
+    spin_lock(&kernel_spin);
+    cpu->lock_depth = depth;
+}
+
+/* void kernel_lock_unnest(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: leaves the hold of the system call, or of the fault that
+ *           came straight from user mode */
+void kernel_lock_unnest(void) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    smp_this_cpu()->lock_depth = 1;
+    restore_flags(flags);
+}
+
+/* void ap_main(void);
+ * Inputs: none
+ * Return Value: never returns
+ * Function: Loads the shared IDT and this AP's TSS and starts the local
+ *           timer, then runs processes from sched_idle. */
+void ap_main(void) {
+    uint32_t i = (ap_boot_stack - (uint32_t)idle_stacks[0]) / AP_STACK_SIZE - 1;
+
+    lidt(idt_desc_ptr);
+    ltr(AP_TSS + (i - 1) * sizeof(seg_desc_t));
+    lapic_enable();
+    lapic_timer_start();
+    cpus[i].online = 1;
+
+    sched_idle();
+}
+
+/* int32_t cpuinfo_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written
+ * Function: one line per CPU the MP table listed */
+int32_t cpuinfo_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t i;
+
+    len += snprintf(buf + len, size - len, "cpu apic online ticks\n");
+    for (i = 0; i < smp_ncpus; i++) {
+        len += snprintf(buf + len, size - len, "%-3u %-4u %-6u %u\n",
+                        i, cpus[i].apic_id, cpus[i].online, cpus[i].ticks);
+    }
+    return len;
+}
@@ -0,0 +1,80 @@
+/* smp.h - Finding and starting the other processors
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#define SMP_MAX_CPUS    4
+#define AP_BOOT_ADDR    0x8000      // real mode entry of the APs, 4kB aligned and below 1MB
+#define AP_STACK_SIZE   0x2000      // 8kB, like a process kernel stack
+
+#ifndef ASM
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* One entry per processor the MP table lists, the bootstrap one first */
+typedef struct cpu {
+    uint32_t apic_id;
+    volatile uint32_t online;       // set by the CPU itself once it runs C code
+    volatile uint32_t ticks;        // local APIC timer interrupts taken
+    uint32_t pid;                   // process running here, see cur_pid
+    uint32_t idle;                  // 1 while the CPU runs sched_idle instead
+    uint32_t idle_esp;              // sched_idle's stack while a process runs
+    uint32_t lock_depth;            // nesting of the kernel lock it holds
+    tss_t* tss;                     // its own task state segment
+    union dir_entry_desc* dir;      // its own page directory
+} cpu_t;
+
+extern cpu_t cpus[SMP_MAX_CPUS];
+extern uint32_t smp_ncpus;
+
+/* The calling CPU's entry, told apart by the TSS selector it loaded */
+static inline cpu_t* smp_this_cpu(void) {
+    uint16_t tr;
+
+    asm volatile ("str %0" : "=r"(tr));
+    if (tr < AP_TSS)
+        return &cpus[0];
+    return &cpus[(tr - AP_TSS) / sizeof(seg_desc_t) + 1];
+}
+
+/* Index of the calling CPU in cpus[] */
+#define smp_cpu_id()    ((uint32_t)(smp_this_cpu() - cpus))
+
+/* The process the calling CPU runs. Every CPU has its own. */
+#define cur_pid         (smp_this_cpu()->pid)
+
+/* Reads the MP configuration table. Paging must still be off, the table
+ * lives in BIOS memory the kernel does not map. */
+void smp_scan(void);
+
+/* Starts every processor smp_scan found. Needs paging and interrupts on,
+ * the startup IPIs are timed with the PIT. */
+void smp_init(void);
+
+/* The kernel lock: one CPU at a time runs kernel code. Every interrupt,
+ * exception and syscall linkage takes it, signal_return drops it. It
+ * nests on the CPU holding it. */
+void kernel_lock(void);
+void kernel_unlock(void);
+
+/* Takes the kernel lock only if it is free, returns 1 if it was taken */
+int32_t kernel_trylock(void);
+
+/* Lets the other CPUs have the kernel lock for a moment, interrupts off */
+void kernel_lock_relax(void);
+
+/* Drops the holds of interrupts and faults nested in a system call, for
+ * halt, which never returns to them */
+void kernel_lock_unnest(void);
+
+/* Writes one line per CPU into buf, for the cpuinfo pseudo file */
+int32_t cpuinfo_show(int8_t* buf, int32_t size);
+
+/* First C code an AP runs, called from ap_start32 in smp_boot.S */
+void ap_main(void);
+
+#endif /* ASM */
+#endif /* _SMP_H */
@@ -0,0 +1,40 @@
+/* spinlock.c - Bookkeeping for interrupt-safe critical sections
+ * vim:ts=4 noexpandtab
+ */
+
+#include "spinlock.h"
+
+uint32_t irq_off_max_cycles = 0;
+const int8_t* irq_off_max_name = "none";
+
+/* TSC value when interrupts were last turned off by spin_lock_irqsave */
+static uint32_t irq_off_start;
+
+/* void irq_off_begin(uint32_t flags);
+ * Inputs: flags = EFLAGS saved when entering the section
+ * Return Value: none
+ * Function: Stamps the start of an interrupts-off section if this section
+ *           is the one that disabled interrupts */
+void irq_off_begin(uint32_t flags) {
+    if (flags & EFLAGS_IF)
+        irq_off_start = rdtsc();
+}
+
+/* void irq_off_end(spinlock_t* lock, uint32_t flags);
+ * Inputs: lock = lock that guarded the section
+ *         flags = EFLAGS saved when entering the section
+ * Return Value: none
+ * Function: If interrupts are about to be turned back on, records the
+ *           section's length when it is the longest seen so far */
+void irq_off_end(spinlock_t* lock, uint32_t flags) {
+    uint32_t cycles;
+
+    if (!(flags & EFLAGS_IF))
+        return;
+
+    cycles = rdtsc() - irq_off_start;
+    if (cycles > irq_off_max_cycles) {
+        irq_off_max_cycles = cycles;
+        irq_off_max_name = lock->name;
+    }
+}
@@ -0,0 +1,83 @@
+/* spinlock.h - Spinlocks and interrupt-safe critical sections
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+#define EFLAGS_IF   0x0200      /* Interrupt enable bit in EFLAGS */
+
+typedef struct spinlock {
+    volatile uint32_t lock;     /* 1 while held */
+    const int8_t* name;         /* Reported by the interrupts-off statistics */
+} spinlock_t;
+
+#define SPINLOCK_INIT(lock_name)    { 0, (lock_name) }
+
+/* Longest time (in TSC cycles) interrupts stayed disabled inside a
+ * spin_lock_irqsave section, and the lock that was held */
+extern uint32_t irq_off_max_cycles;
+extern const int8_t* irq_off_max_name;
+
+/* Start/stop timing an interrupts-off section. Only the outermost section,
+ * the one entered with interrupts enabled, is timed. */
+void irq_off_begin(uint32_t flags);
+void irq_off_end(spinlock_t* lock, uint32_t flags);
+
+/* Busy wait until the lock is free and take it */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t held;
+    do {
+        asm volatile ("                   \n\
+                xchgl %0, (%1)            \n\
+                "
+                : "=r"(held)
+                : "r"(&lock->lock), "0"(1)
+                : "memory"
+        );
+        if (held)
+            asm volatile ("pause");
+    } while (held);
+}
+
+/* Take the lock if it is free, returns 1 if it was taken */
+static inline int32_t spin_trylock(spinlock_t* lock) {
+    uint32_t held;
+    asm volatile ("                   \n\
+            xchgl %0, (%1)            \n\
+            "
+            : "=r"(held)
+            : "r"(&lock->lock), "0"(1)
+            : "memory"
+    );
+    return !held;
+}
+
+/* Release the lock */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");
+    lock->lock = 0;
+}
+
+/* Save EFLAGS into "flags", disable interrupts and take the lock.
+ * Safe to nest: the matching restore only re-enables interrupts if they
+ * were enabled when the section was entered. */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    irq_off_begin(flags);               \
+    spin_lock(lock);                    \
+} while (0)
+
+/* Release the lock and put EFLAGS back the way spin_lock_irqsave found it */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    irq_off_end((lock), (flags));           \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif /* _SPINLOCK_H */
@@ -0,0 +1,110 @@
+/* stats.c - Per-vector interrupt and syscall statistics
+ * vim:ts=4 noexpandtab
+ */
+
+#include "stats.h"
+#include "x86_desc.h"
+#include "idt.h"
+#include "lib.h"
+#include "spinlock.h"
+#include "ioapic.h"
+
+static vec_stat_t vec_stats[NUM_VEC];
+
+/* void vec_stat_add(uint32_t vec, uint32_t cycles);
+ * Inputs: vec = IDT vector that was handled
+ *         cycles = TSC cycles the handler took
+ * Return Value: none
+ * Function: Adds one handler run to the vector's counters */
+void vec_stat_add(uint32_t vec, uint32_t cycles) {
+    vec_stat_t* stat;
+    uint32_t flags;
+
+    if (vec >= NUM_VEC)
+        return;
+    stat = &vec_stats[vec];
+
+    /* Device handlers can nest, keep the update atomic */
+    cli_and_save(flags);
+    stat->count++;
+    stat->total_cycles += cycles;
+    if (cycles > stat->max_cycles)
+        stat->max_cycles = cycles;
+    restore_flags(flags);
+}
+
+/* static int8_t* vec_name(uint32_t vec);
+ * Inputs: vec = IDT vector
+ * Return Value: short name for the vector
+ * Function: Names the vectors that have instrumented handlers */
+static int8_t* vec_name(uint32_t vec) {
+    switch (vec) {
+        case KEYBOARD_VEC_NUM:
+            return "keyboard";
+        case RTC_VEC_NUM:
+            return "rtc";
+        case PIT_VEC_NUM:
+            return "timer";
+        case SERIAL_VEC_NUM:
+            return "serial";
+        case SYSCALL_VEC_NUM:
+            return "syscall";
+        default:
+            return "other";
+    }
+}
+
+/* static uint32_t average(uint64_t total, uint32_t count);
+ * Inputs: total = sum of samples
+ *         count = number of samples
+ * Return Value: total / count rounded down, 0xFFFFFFFF if that does not
+ *               fit in 32 bits, 0 with no samples
+ * Function: divides with divl, which takes a 64 bit dividend, since there
+ *           is no libgcc for a 64 bit division */
+static uint32_t average(uint64_t total, uint32_t count) {
+    uint32_t high = total >> 32;
+    uint32_t low = total;
+    uint32_t avg, rem;
+
+    if (count == 0)
+        return 0;
+    if (high >= count)
+        return 0xFFFFFFFF;
+    asm ("divl %4"
+            : "=a"(avg), "=d"(rem)
+            : "a"(low), "d"(high), "rm"(count)
+    );
+    return avg;
+}
+
+/* int32_t stats_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written
+ * Function: Formats one line per vector that has been hit, followed by the
+ *           longest interrupts-off section */
+int32_t stats_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t vec;
+    vec_stat_t stat;
+    uint32_t flags;
+
+    len += snprintf(buf + len, size - len, "irq controller: %s\n",
+                    irq_ioapic ? "ioapic" : "8259");
+    len += snprintf(buf + len, size - len, "vec  name      count      avg        max\n");
+    for (vec = 0; vec < NUM_VEC; vec++) {
+        cli_and_save(flags);
+        stat = vec_stats[vec];
+        restore_flags(flags);
+        if (stat.count == 0)
+            continue;
+
+        len += snprintf(buf + len, size - len, "%02x   %-10s%-11u%-11u%u\n",
+                        vec, vec_name(vec), stat.count,
+                        average(stat.total_cycles, stat.count), stat.max_cycles);
+    }
+
+    len += snprintf(buf + len, size - len, "irqs off max: %u cycles (%s)\n",
+                    irq_off_max_cycles, irq_off_max_name);
+    return len;
+}
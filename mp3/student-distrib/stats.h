@@ -0,0 +1,25 @@
+/* stats.h - Per-vector interrupt and syscall statistics
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "types.h"
+
+/* Counters for one IDT vector. Cycles are TSC cycles spent in the
+ * handler, measured by the assembly linkage. */
+typedef struct vec_stat {
+    uint32_t count;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+} vec_stat_t;
+
+/* Record one run of the handler for vector vec. Called from handlers.S
+ * and syscall_support.S. */
+void vec_stat_add(uint32_t vec, uint32_t cycles);
+
+/* Write the statistics as text into buf, returns the length written */
+int32_t stats_show(int8_t* buf, int32_t size);
+
+#endif /* _STATS_H */
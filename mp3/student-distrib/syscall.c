@@ -3,15 +3,17 @@
 #include "paging.h"
 #include "terminal.h"
 #include "x86_desc.h"
+#include "proc.h"
+#include "serial.h"
+#include "elf.h"
+#include "sched.h"
 
-//variables for keeping track of the pid values
-uint32_t cur_pid = 0;
-uint32_t parent_pid = 0;
+//variables for keeping track of the pid values, cur_pid is per CPU (smp.h)
 uint32_t pid_array[PID_MAX];
 
 //Assembly functions. Descriptions in sycall_support.S
-extern void flush_tlb();
-extern void halt_ret(uint32_t execute_ebp, uint32_t execute_esp, uint8_t status);
+extern void halt_ret(uint32_t execute_ebp, uint32_t execute_esp, uint32_t status);
+extern void fork_ret(void);
 
 
 /* int32_t halt(uint8_t status)
@@ -19,14 +21,27 @@ extern void halt_ret(uint32_t execute_ebp, uint32_t execute_esp, uint8_t status)
  * Return Value: always 0
  * Function    : terminates a process, returning the specified value to its parent process */
 int32_t halt(uint8_t status){
+    return process_exit(status);
+}
+
+/* int32_t process_exit(uint32_t status)
+ * Inputs      : status - 0-255 from halt, EXCEPTION_STATUS from a fault
+ * Return Value: does not return
+ * Function    : tears the running process down and hands status to the
+ *               execute or waitpid of its parent */
+int32_t process_exit(uint32_t status){
   int i;
+  pcb_t* child_pcb_ptr;
 //---------Restore parent data-----------------------------------------
 
     pcb_t* cur_pcb_ptr = get_cur_pcb();
+    //A fault in the kernel leaves its own hold on the kernel lock
+    kernel_lock_unnest();
     //return to shell if it is the base shell
     if(cur_pcb_ptr->pid == 0){
         uint32_t eip_arg = cur_pcb_ptr->user_eip;
         uint32_t esp_arg = cur_pcb_ptr->user_esp;
+        kernel_unlock();
         // eax = eip_arg, ebx = USER_DS, ecx = USER_CS, edx = esp_arg
         asm volatile ("\
             andl    $0x00FF, %%ebx  ;\
@@ -46,25 +61,45 @@ int32_t halt(uint8_t status){
             : "memory"
         );
     }
+
+//---------Hand forked children to the base shell-----------------------
+    for(i = 1; i < MAX_PID; i++){
+        child_pcb_ptr = get_pcb(i);
+        if(!pid_array[i] || i == cur_pcb_ptr->pid || child_pcb_ptr->parent_pid != cur_pcb_ptr->pid)
+            continue;
+        if(child_pcb_ptr->state == PROC_ZOMBIE)
+            pid_array[i] = 0;               //nobody is left to wait for it
+        else
+            child_pcb_ptr->parent_pid = 0;
+    }
+
+//---------Close any relevant FDs and give back the pages---------------
+    for(i=0;i<MAX_FD_NUM;i++){
+        cur_pcb_ptr->fd_array[i].flag = 0;
+    }
+    user_paging_reset(cur_pcb_ptr->pid);
+    terminal_release(cur_pcb_ptr->pid);
+
+//---------A forked process stays a zombie until waitpid----------------
+    if(cur_pcb_ptr->forked){
+        cur_pcb_ptr->exit_status = status;
+        cur_pcb_ptr->state = PROC_ZOMBIE;
+        sched_exit();
+    }
+
     //Update the pid values, so that the memory mapping and info are correct
     pcb_t* parent_pcb_ptr = get_pcb(cur_pcb_ptr->parent_pid);
     cur_pid = cur_pcb_ptr->parent_pid;
-    parent_pid = parent_pcb_ptr->parent_pid;
+    parent_pcb_ptr->state = PROC_RUNNABLE;
+    parent_pcb_ptr->cpu = smp_cpu_id();
     pid_array[cur_pcb_ptr->pid] = 0;
 
 //---------restore parent paging----------------------------------------
-    uint32_t phys_addr = (PHYS_MEM_START + cur_pid) * PAGE_4MB;
-    page_directory[USER_INDEX].table_addr_31_12 = phys_addr/ALIGN_4KB; //pcb page_addr
-    flush_tlb();
-
-//---------Close any relevant FDs---------------------------------------
-    for(i=0;i<MAX_FD_NUM;i++){
-        cur_pcb_ptr->fd_array[i].flag = 0;
-    }
+    user_paging_switch(cur_pid);
 
 //---------Write Parent process' info back to TSS(esp0)-----------------
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = EIGHT_MB - (EIGHT_KB*parent_pcb_ptr->pid) - sizeof(int32_t);
+    smp_this_cpu()->tss->ss0 = KERNEL_DS;
+    smp_this_cpu()->tss->esp0 = EIGHT_MB - (EIGHT_KB*parent_pcb_ptr->pid) - sizeof(int32_t);
 
 //---------Jump to execute return---------------------------------------
     halt_ret(cur_pcb_ptr->exec_ebp,cur_pcb_ptr->exec_esp,status);
@@ -76,7 +111,8 @@ int32_t halt(uint8_t status){
 
 /* int32_t execute(const uint8_t* command)
  * Inputs      : command - sequence of words used for commands or arguemtns
- * Return Value: -1   upon failure due to non-existing or non-executable file
+ * Return Value: -1   upon failure due to non-existing or non-executable file,
+ *                    or no memory to load it into
  *               256  upon exception
  *              0-255 upon syscall halt
  * Function    :  load and execute a new program, handling off the processor to the new program till it terminates */
@@ -96,11 +132,12 @@ int32_t execute(const uint8_t* command){
     uint8_t file_arg[MAX_FILENAME];
     
     dentry_t temp_dentry;
-    uint8_t elf_buf[sizeof(int32_t)];
+    elf_image_t image;
 
     //Arguments for switching to user context.
     uint32_t eip_arg;
     uint32_t esp_arg;
+    uint32_t caller_pid = cur_pid;
 
 
 //----------Parse arguments ----------------------------------
@@ -145,13 +182,12 @@ int32_t execute(const uint8_t* command){
         return -1; /* file does not exist*/
     }
 
-    if(read_data(temp_dentry.inode_num, 0, elf_buf, sizeof(int32_t)) == -1){
-        return -1;  /* something failed during read_data*/
+    if(temp_dentry.ftype != 2 && temp_dentry.ftype != LZ_FTYPE){
+        return -1; /* only regular files can be executables */
     }
 
-    if(!(elf_buf[0] == MAGIC0 && elf_buf[1] == MAGIC1 &&
-         elf_buf[2] == MAGIC2 && elf_buf[3] == MAGIC3)) {
-        return -1; /* ELF not found, not an executable*/
+    if(elf_read(temp_dentry.inode_num, &image) == -1){
+        return -1; /* not an ELF program we can load */
     }
 
 
@@ -159,7 +195,7 @@ int32_t execute(const uint8_t* command){
     pcb_t* pcb_ptr;
     // pcb_t* parent_pcb_ptr;
     int pid_flag = 0;
-    for(i = 0; i < MAX_PID ;i++){         /* find available pid, max 3 for now */
+    for(i = 0; i < MAX_PID ;i++){         /* find available pid */
         if(pid_array[i] == 0){
             pid_array[i] = 1;
             cur_pid = i;                  /* set cur_pid to new one*/
@@ -172,29 +208,36 @@ int32_t execute(const uint8_t* command){
         return -1;
     }
 
-    uint32_t mem_index = PHYS_MEM_START + cur_pid;               // Skip first page
-    uint32_t phys_addr = mem_index * PAGE_4MB;      // Physical address
-    page_directory[USER_INDEX].table_addr_31_12 = phys_addr/ALIGN_4KB;//user virtual to physical
-    flush_tlb();
+    user_paging_switch(cur_pid);
 
 
 //------------load file into memory---------------------------------------------------
-    inode_t* temp_inode_ptr = (inode_t *)(inode_ptr+temp_dentry.inode_num);
-    uint8_t* image_addr = (uint8_t*)PROGRAM_IMAGE_ADDR;           //it should stay the same, overwriting existing program image
-    read_data(temp_dentry.inode_num, (uint32_t)0, image_addr,temp_inode_ptr->length); //copying entire file to memory starting at Virt addr 0x08048000
+    //text read-only, data read-write, bss and stack on demand
+    if(elf_load(&image, cur_pid) == -1){
+        user_paging_reset(cur_pid);
+        pid_array[cur_pid] = 0;
+        cur_pid = caller_pid;
+        user_paging_switch(caller_pid);
+        return -1;
+    }
 
 //-------------Create PCB/Open FDs-----------------------------------------------------
 
     pcb_ptr = get_pcb(cur_pid);          /* create PCB       */
     pcb_ptr->pid = cur_pid;
 
-    //Update pid values.
-    if(cur_pid != 0 ){
-        pcb_ptr->parent_pid = parent_pid;
-        parent_pid = cur_pid;
-    }else{
-        pcb_ptr->parent_pid = cur_pid;
-    }
+    //The caller waits here until the new program halts
+    pcb_ptr->parent_pid = caller_pid;
+    pcb_ptr->state = PROC_RUNNABLE;
+    pcb_ptr->forked = 0;
+    pcb_ptr->cpu = smp_cpu_id();
+
+    //Every signal takes its default action
+    pcb_ptr->sig_pending = 0;
+    pcb_ptr->sig_mask = 0;
+    memset(pcb_ptr->sig_handler, 0, sizeof(pcb_ptr->sig_handler));
+    if(cur_pid != caller_pid)
+        get_pcb(caller_pid)->state = PROC_EXECUTING;
 
     // Initialize the file descriptor array
     for (i = 0; i < MAX_NUM_FILE;i++) {
@@ -218,10 +261,7 @@ int32_t execute(const uint8_t* command){
 
 
   //------------Prepare for context switch--------------------------------------------------
-    //Bytes 24 to 27 of the executable. entry point
-    uint8_t eip_buf[ELF_SIZE];
-    read_data(temp_dentry.inode_num, ELF_START, eip_buf, sizeof(int32_t)); // Read eip from elf (location 24)
-    eip_arg = *((int*)eip_buf);
+    eip_arg = image.hdr.entry;
 
     esp_arg = USER_MEM + PAGE_4MB - sizeof(int32_t); // where program starts
 
@@ -229,9 +269,9 @@ int32_t execute(const uint8_t* command){
     pcb_ptr->user_esp = esp_arg;
 
     //For privilege level switch
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = EIGHT_MB - (EIGHT_KB*cur_pid) - sizeof(int32_t);
-    pcb_ptr->tss_esp0 = tss.esp0;
+    smp_this_cpu()->tss->ss0 = KERNEL_DS;
+    smp_this_cpu()->tss->esp0 = EIGHT_MB - (EIGHT_KB*cur_pid) - sizeof(int32_t);
+    pcb_ptr->tss_esp0 = smp_this_cpu()->tss->esp0;
 
     //Get the esp and ebp values for the user context switch.
     uint32_t esp;
@@ -241,8 +281,9 @@ int32_t execute(const uint8_t* command){
     pcb_ptr->exec_esp = esp;
     pcb_ptr->exec_ebp = ebp;
 
-    //Enable interrupts
-    sti();
+    //Nothing in the kernel is left to do for this CPU
+    kernel_unlock();
+
   //------------Push IRET context to stack-------------------------------------------------
   // eax = eip_arg, ebx = USER_DS, ecx = USER_CS, edx = esp_arg
     asm volatile ("\
@@ -294,7 +335,7 @@ void fop_init(){
     file_fop.close = file_close;
 
     stdin_fop.read = terminal_read;
-    stdin_fop.write = null_write;
+    stdin_fop.write = terminal_mode;
     stdin_fop.open = terminal_open;
     stdin_fop.close = terminal_close;
 
@@ -302,6 +343,16 @@ void fop_init(){
     stdout_fop.write = terminal_write;
     stdout_fop.open = terminal_open;
     stdout_fop.close = terminal_close;
+
+    proc_fop.read = proc_read;
+    proc_fop.write = proc_write;
+    proc_fop.open = proc_open;
+    proc_fop.close = proc_close;
+
+    serial_fop.read = serial_read;
+    serial_fop.write = serial_fwrite;
+    serial_fop.open = serial_open;
+    serial_fop.close = serial_close;
 }
 
 /* int32_t open(const uint8_t* fname)
@@ -334,8 +385,12 @@ int32_t open(const uint8_t* fname){
                 cur_pcb_ptr->fd_array[i].fop_table_ptr = &rtc_fop;
             }else if (dentry.ftype == 1){         /* directory */
                 cur_pcb_ptr->fd_array[i].fop_table_ptr = &dir_fop;
-            }else if (dentry.ftype == 2){         /* regular file */
+            }else if (dentry.ftype == 2 || dentry.ftype == LZ_FTYPE){ /* regular file */
                 cur_pcb_ptr->fd_array[i].fop_table_ptr = &file_fop;
+            }else if (dentry.ftype == PROC_FTYPE){ /* pseudo file */
+                cur_pcb_ptr->fd_array[i].fop_table_ptr = &proc_fop;
+            }else if (dentry.ftype == SERIAL_FTYPE){ /* ttyS0 */
+                cur_pcb_ptr->fd_array[i].fop_table_ptr = &serial_fop;
             }
 
             return i; /* return fd upon success*/
@@ -376,8 +431,6 @@ int32_t close(int32_t fd){
  * Return Value: ret - number of bytes read
  * Function    : reads data from keyboard ,file, device, or directory*/
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
-    sti();
-    
     if(fd < 0 || fd > MAX_NUM_FILE){
         return -1;
     }
@@ -445,6 +498,123 @@ int32_t getargs(uint8_t* buf, int32_t nbytes){
     return 0;
 }
 
+/* int32_t fork(void)
+ * Inputs      : none
+ * Return Value: the child's pid to the parent, 0 to the child, -1 if there
+ *               is no free pid
+ * Function    : Duplicates the calling process. The child gets a copy of the
+ *               fd table and arguments and shares every page with the
+ *               parent until one of them writes it (copy on write). It is
+ *               left runnable and first runs when the scheduler picks it,
+ *               returning from the same int $0x80 as the parent. */
+int32_t fork(void){
+    pcb_t* parent_pcb_ptr = get_cur_pcb();
+    pcb_t* pcb_ptr;
+    syscall_regs_t* regs;
+    switch_frame_t* frame;
+    uint32_t child = 0;
+    int i;
+    int pid_flag = 0;
+
+    for(i = 0; i < MAX_PID; i++){
+        if(pid_array[i] == 0){
+            pid_array[i] = 1;
+            child = i;
+            pid_flag = 1;
+            break;
+        }
+    }
+    if(pid_flag == 0)
+        return -1;
+
+//-------------Copy the PCB-----------------------------------------------------------
+    pcb_ptr = get_pcb(child);
+    memcpy(pcb_ptr->fd_array, parent_pcb_ptr->fd_array, sizeof(pcb_ptr->fd_array));
+    memcpy(pcb_ptr->cmd_arg, parent_pcb_ptr->cmd_arg, sizeof(pcb_ptr->cmd_arg));
+    pcb_ptr->pid = child;
+    pcb_ptr->parent_pid = cur_pid;
+    pcb_ptr->user_eip = parent_pcb_ptr->user_eip;
+    pcb_ptr->user_esp = parent_pcb_ptr->user_esp;
+    pcb_ptr->forked = 1;
+    pcb_ptr->cpu = parent_pcb_ptr->cpu;
+    pcb_ptr->sig_pending = 0;
+    pcb_ptr->sig_mask = parent_pcb_ptr->sig_mask;
+    pcb_ptr->sig_saved_mask = parent_pcb_ptr->sig_saved_mask;
+    memcpy(pcb_ptr->sig_handler, parent_pcb_ptr->sig_handler, sizeof(pcb_ptr->sig_handler));
+
+//-------------Share the address space------------------------------------------------
+    user_paging_fork(cur_pid, child);
+
+//-------------Build the child's kernel stack-----------------------------------------
+    //A copy of the parent's saved registers, returned to user mode by fork_ret
+    pcb_ptr->tss_esp0 = EIGHT_MB - (EIGHT_KB*child) - sizeof(int32_t);
+    regs = (syscall_regs_t*)(pcb_ptr->tss_esp0 - sizeof(syscall_regs_t));
+    memcpy(regs, (void*)(parent_pcb_ptr->tss_esp0 - sizeof(syscall_regs_t)), sizeof(syscall_regs_t));
+    regs->esp = (uint32_t)&regs->ebx;   //the value pushl %esp saved, on the child's stack
+
+    //Below it, what context_switch pops when the child is first picked
+    frame = (switch_frame_t*)regs - 1;
+    memset(frame, 0, sizeof(switch_frame_t));
+    frame->eflags = EFLAGS_RESERVED;
+    frame->ret = (uint32_t)fork_ret;
+    pcb_ptr->sched_esp = (uint32_t)frame;
+    pcb_ptr->state = PROC_RUNNABLE;
+
+    return child;
+}
+
+/* int32_t wait(int32_t* status)
+ * Inputs      : status - where to store the child's halt status, may be NULL
+ * Return Value: pid of the reaped child, -1 if there are no forked children
+ * Function    : waitpid for any child */
+int32_t wait(int32_t* status){
+    return waitpid(-1, status, 0);
+}
+
+/* int32_t waitpid(int32_t pid, int32_t* status, int32_t options)
+ * Inputs      : pid     - forked child to wait for, -1 for any
+ *               status  - where to store the child's halt status, may be NULL
+ *               options - WNOHANG to return at once if none has halted
+ * Return Value: pid of the reaped child, 0 under WNOHANG if it is still
+ *               running, -1 if there is no such child, status is bad or
+ *               a signal arrived first
+ * Function    : Waits for a forked child to halt and frees its pid. Only
+ *               forked children can be waited for, an executed one hands
+ *               its status back through execute. */
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options){
+    pcb_t* child_pcb_ptr;
+    int32_t found;
+    int i;
+
+    if(status != NULL && ((uint32_t)status < USER_MEM ||
+       (uint32_t)status > USER_MEM + PAGE_4MB - sizeof(int32_t)))
+        return -1;
+
+    while(1){
+        found = 0;
+        for(i = 0; i < MAX_PID; i++){
+            child_pcb_ptr = get_pcb(i);
+            if(!pid_array[i] || i == cur_pid || !child_pcb_ptr->forked ||
+               child_pcb_ptr->parent_pid != cur_pid || (pid != -1 && pid != i))
+                continue;
+            found = 1;
+            if(child_pcb_ptr->state == PROC_ZOMBIE){
+                if(status != NULL)
+                    *status = child_pcb_ptr->exit_status;
+                pid_array[i] = 0;
+                return i;
+            }
+        }
+        if(!found)
+            return -1;
+        if(options & WNOHANG)
+            return 0;
+        if(signal_pending())
+            return -1;
+        sched_yield();
+    }
+}
+
 /* int32_t vidmap(uint32_t** screen_start)
  * Inputs      : buf    - double pointer to user address space 
 * Function: pass virtual address which points to video memory */
@@ -459,28 +629,46 @@ int32_t vidmap(uint32_t** screen_start){
         return -1;
 
 
-    // set up virtual add at 136mb for vidmap
-    page_directory[VIDEO_INDEX].size = 0;
-    page_directory[VIDEO_INDEX].present = 1;
-    page_directory[VIDEO_INDEX].user = 1;
-    page_directory[VIDEO_INDEX].table_addr_31_12 =((int)page_table_vidmap)/ALIGN_4KB;
-    
-    page_table_vidmap[0].present =1;
-    page_table_vidmap[0].user = 1;
-    page_table_vidmap[0].page_addr_31_12 = VIDMEM_ADDR/ALIGN_4KB; // 0xB8000
-
-    flush_tlb();
+    // map video memory at 136mb, only that page leaves the TLB
+    if (user_vidmap(cur_pid, 0) != 0)
+        return -1;
 
     *screen_start = (uint32_t*)(VM_VIDEO);  //0x8800000
     return 0;
 }
 
-int32_t set_handler(int32_t signum, void* handler_address){
-    return -1;
+/* int32_t vidmap_buffered(uint32_t** screen_start)
+ * Inputs      : screen_start - where to store the back page's user address
+ * Return Value: 0 on success, -1 on a bad pointer or if memory is full
+ * Function    : Like vidmap, but the program gets a private page, starting
+ *               as a copy of the screen, that nothing shows until vflip */
+int32_t vidmap_buffered(uint32_t** screen_start){
+    uint32_t addr = (uint32_t)screen_start;
+
+    if (addr < USER_MEM || addr > USER_MEM + PAGE_4MB - sizeof(uint32_t*))
+        return -1;
+    if (user_vidmap(cur_pid, 1) != 0)
+        return -1;
+
+    *screen_start = (uint32_t*)(VM_VIDEO);
+    return 0;
 }
-int32_t sigreturn(void){
-    return -1;
+
+/* int32_t vflip(void)
+ * Inputs      : none
+ * Return Value: 0 on success, -1 if the program has no back page
+ * Function    : Copies the back page to video memory in one go, so the
+ *               screen never shows a half drawn frame */
+int32_t vflip(void){
+    if (!user_vidmap_buffered(cur_pid))
+        return -1;
+    /* There is one terminal, so the caller's screen is always the visible
+     * one. With more terminals a process in the background must not reach
+     * VIDMEM_ADDR; its flip would go to its terminal's saved screen. */
+    memcpy((void*)VIDMEM_ADDR, (void*)VM_VIDEO, ALIGN_4KB);
+    return 0;
 }
+
 //-------------------------------------------------------------
 
 
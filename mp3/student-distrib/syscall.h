@@ -4,13 +4,11 @@
 #include "types.h"
 #include "lib.h"
 #include "fs_driver.h"
+#include "paging.h"
+#include "signal.h"
 
 
 #define MAX_FD_NUM 8
-#define MAGIC0    0x7f
-#define MAGIC1    0x45
-#define MAGIC2    0x4c
-#define MAGIC3    0x46
 #define FOUR_BYTES  4
 
 #define PROGRAM_IMAGE_ADDR 0x08048000
@@ -20,17 +18,15 @@
 
 #define PROGRAM_IMAGE_OFFSET 0x48000
 
-#define PID_MAX         8
-#define PHYS_MEM_START  2
-#define ELF_SIZE        4
-#define ELF_START       24
+/* Every process needs a user page table, so paging.h's count is the one
+ * limit. A background job takes two: the forked shell and the program. */
+#define PID_MAX         USER_PID_MAX
 
-#define ELF0    0
-#define ELF1    1
-#define ELF2    2
-#define ELF3    3
+#define MAX_PID PID_MAX
 
-#define MAX_PID 3
+#define EXCEPTION_STATUS 256    /* execute's result for a program killed by an exception */
+
+#define WNOHANG 1        /* waitpid option: return 0 instead of waiting */
 
 /*file operation table*/
 typedef struct {
@@ -47,6 +43,8 @@ fop_table_t dir_fop;    /* directory*/
 fop_table_t file_fop;   /* file     */
 fop_table_t stdin_fop;  /* in       */
 fop_table_t stdout_fop; /* out      */
+fop_table_t proc_fop;   /* pseudo file */
+fop_table_t serial_fop; /* ttyS0    */
 
 /* file descriptor*/
 typedef struct {
@@ -59,6 +57,10 @@ typedef struct {
 
 /* pcb */
 typedef struct{
+    uint32_t sig_pending;   /* bitmaps of signals, first: signal_support.S reads them */
+    uint32_t sig_mask;
+    uint32_t sig_saved_mask;    /* mask to restore on sigreturn */
+    void* sig_handler[NUM_SIGNALS];
     file_descriptor_t fd_array[MAX_FD_NUM];
     uint32_t pid;
     uint32_t parent_pid;
@@ -67,10 +69,33 @@ typedef struct{
     uint32_t tss_esp0;
     uint32_t user_eip;
     uint32_t user_esp;
+    uint32_t state;         /* PROC_* in sched.h */
+    uint32_t sched_esp;     /* kernel stack pointer while switched out */
+    uint32_t forked;        /* 1 if made by fork: halt leaves a zombie instead of returning to execute */
+    uint32_t cpu;           /* cpus[] index of the CPU whose run queue it is in */
+    int32_t exit_status;    /* for waitpid once the process is a zombie */
 
     uint8_t cmd_arg[MAX_FILENAME];
 } pcb_t;
 
+/* Registers syscall_handler saves below the iret frame int $0x80 pushed, lowest
+ * address first. They sit at the top of the process's kernel stack. */
+typedef struct{
+    uint32_t eflags;
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebp;
+    uint32_t esp;
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t ecx;
+    uint32_t user_eip;
+    uint32_t user_cs;
+    uint32_t user_eflags;
+    uint32_t user_esp;
+    uint32_t user_ss;
+} syscall_regs_t;
+
 
 
 extern void syscall_handler();
@@ -93,9 +118,21 @@ int32_t null_close(int32_t fd);
 /* terminates a process, returning the specified value to its parent process */
 int32_t halt(uint8_t status);
 
+/* halt with a status that does not fit the syscall's byte */
+int32_t process_exit(uint32_t status);
+
 /* load and execute a new program, handling off the processor to the new program till it terminates */
 int32_t execute(const uint8_t* command);
 
+/* duplicates the calling process, both continue */
+int32_t fork(void);
+
+/* waits for any forked child to halt and reaps it */
+int32_t wait(int32_t* status);
+
+/* waits for a forked child (or any with pid -1) to halt and reaps it */
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options);
+
 /* provides access to file system */
 int32_t open(const uint8_t* fname);
 
@@ -114,6 +151,12 @@ int32_t getargs(uint8_t* buf, int32_t nbytes);
 /* maps the text-mode video memory into user space at a pre-set virtual address */
 int32_t vidmap(uint32_t** screen_start);
 
+/* maps a private back page instead of video memory */
+int32_t vidmap_buffered(uint32_t** screen_start);
+
+/* copies the back page to video memory */
+int32_t vflip(void);
+
 
 int32_t set_handler(int32_t signum, void* handler_address);
 
@@ -2,68 +2,73 @@
 #include "keyboard.h"
 #include "i8259.h"
 #include "lib.h"
+#include "sched.h"
+#include "signal.h"
 
 #define BCKSPACE    0x08
 
-//Holds the values entered by the keyboard
-static char char_buffer[BUFFER_SIZE];
-//Flag to break out of read loop.
-volatile static int enter_flag = 0;
-//Keeps track of the current location to be filled in the char_buffer
-static int char_count = 0;
+//Line editing state for every terminal
+static terminal_t terminals[NUM_TERMINALS] = {
+    { .lock = SPINLOCK_INIT("terminal") },
+};
+//Terminal that receives keyboard input
+static terminal_t* cur_terminal = &terminals[0];
+
+static void line_insert(terminal_t* term, char new_char);
+static void line_erase(terminal_t* term, int32_t index);
+static void line_replace(terminal_t* term, const char* text);
+static void line_history(terminal_t* term, int32_t step);
+static void line_enter(terminal_t* term);
 
 
 /* int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
- * Reads in keyboard presses and stores it in the char_buffer
- * until the newline is entered. It then stores the resulting char_buffer
- * in the buf array entered by the user.
+ * Waits until a line has been entered on the keyboard and copies it into
+ * buf. If the line does not fit, it is cut short and the last character
+ * in buf is replaced with a newline. In raw mode it waits for any key and
+ * copies the keys typed so far, leaving the rest for the next read.
  *
  * Inputs: fd - The file descriptor value.
  *        buf - The array that terminal read will be storing the entered
  *              keyboard text to.
  *     nbytes - The maximum number of characters that can be entered in buf.
- * Return Value: The number of bytes (characters) written to the buf array.
- * Side effects: char_buffer, char_count, and enter_flag are changed */
+ * Return Value: The number of bytes (characters) written to the buf array,
+ *               -1 if a signal arrived first.
+ * Side effects: read_buffer and enter_flag are changed */
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
-    int bytes_read = 0;
+    terminal_t* term = cur_terminal;
+    int32_t bytes_read;
+    uint32_t flags;
     int i;
 
-    //Fills in the buffer as the keyboard interrupts. Exits after newline.
-    while(enter_flag == 0){}
-
-    cli();
-    //The max size of the buffer returned ranges from 1 to 128.
-    if(nbytes < BUFFER_SIZE) {
-        for(i = 0; i < nbytes; ++i) {
-            //Fills in the user entered buffer with the resulting characters.
-            ((char*) buf)[i] = char_buffer[i];
-            char_buffer[i] = ' ';                   //Clears char_buffer
-            //If it is smaller than nbytes it finishes here.
-            if(((char*)buf)[i] == '\n') {
-                bytes_read = i + 1;
-                break;
-            }
-            //Makes sure that the last character in buf is a newline
-            if((i == (nbytes - 1)) && (((char*)buf)[i] != '\n')){
-                ((char*) buf)[i] = '\n';
-                bytes_read = i + 1;
-                break;
-            }
-        }
-    } else {
-        for(i = 0; i < BUFFER_SIZE; ++i) {
-            //Fill in the user entered buffer
-            ((char*) buf)[i] = char_buffer[i];
-            char_buffer[i] = ' ';               //Clear char_buffer
-            if(((char*)buf)[i] == '\n') {
-                bytes_read = i + 1;
-                break;
-            }
-        }
+    if(nbytes <= 0)
+        return 0;
+
+    //Fills in the buffer as the keyboard interrupts. Exits after newline,
+    //or with -1 if a signal is waiting to kill or interrupt the reader.
+    while(term->enter_flag == 0) {
+        if(signal_pending())
+            return -1;
+        sched_yield();
     }
-    char_count = 0;  //Go back to the start of the char_buffer.
-    enter_flag = 0;
-    sti();
+
+    spin_lock_irqsave(&term->lock, flags);
+    bytes_read = (nbytes < term->read_len) ? nbytes : term->read_len;
+    for(i = 0; i < bytes_read; ++i)
+        ((char*) buf)[i] = term->read_buffer[i];
+    if(term->raw) {
+        for(i = bytes_read; i < term->read_len; ++i)
+            term->read_buffer[i - bytes_read] = term->read_buffer[i];
+        term->read_len -= bytes_read;
+        term->enter_flag = (term->read_len > 0);
+        spin_unlock_irqrestore(&term->lock, flags);
+        return bytes_read;
+    }
+    //Makes sure that the last character in buf is a newline
+    ((char*) buf)[bytes_read - 1] = '\n';
+
+    term->read_len = 0;
+    term->enter_flag = 0;
+    spin_unlock_irqrestore(&term->lock, flags);
 
     return bytes_read;
 }
@@ -75,16 +80,11 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
  *              to print to video memory.
  *     nbytes - The number of characters to print from buf.
  * Return Value: The number of bytes (characters) written to video memory.
- * Side effects: char_buffer, char_count, and enter_flag are changed */
+ * Side effects: none */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
-    int i;
-    char curr_char;
-    for(i = 0; i < nbytes; ++i) {
-        //Prints the given characters to the screen.
-        curr_char = ((char*) buf)[i];
-        if(curr_char != '\0')           //Skips printing out the null terminator
-            putc(curr_char);
-    }
+    //console_write copies the buffer in chunks, skipping any null terminators
+    if(nbytes > 0)
+        console_write((const int8_t*) buf, nbytes);
     return nbytes;
 }
 
@@ -109,35 +109,241 @@ int32_t terminal_close(int32_t fd) {
 }
 
 
+/* int32_t terminal_mode(int32_t fd, const void* buf, int32_t nbytes);
+ * Switches the terminal between line editing and raw keys, the way
+ * rtc_write sets the RTC rate. Anything typed but not yet read is dropped.
+ * The calling program owns raw mode until it switches back or halts.
+ *
+ * Inputs: fd - The file descriptor value.
+ *        buf - int32_t TERMINAL_LINE or TERMINAL_RAW
+ *     nbytes - should be 4
+ * Return Value: 0 on success, -1 on a bad mode
+ * Side effects: the current terminal's line and read buffer are emptied */
+int32_t terminal_mode(int32_t fd, const void* buf, int32_t nbytes) {
+    terminal_t* term = cur_terminal;
+    int32_t mode;
+    uint32_t flags;
+
+    if(buf == NULL || nbytes != sizeof(int32_t))
+        return -1;
+    mode = *((int32_t*) buf);
+    if(mode != TERMINAL_LINE && mode != TERMINAL_RAW)
+        return -1;
+
+    spin_lock_irqsave(&term->lock, flags);
+    //Wipe the half edited line from the screen when going raw
+    if(mode == TERMINAL_RAW && !term->raw)
+        line_replace(term, "");
+    term->raw = mode;
+    term->raw_pid = cur_pid;
+    term->line_len = 0;
+    term->cursor = 0;
+    term->history_pos = 0;
+    term->read_len = 0;
+    term->enter_flag = 0;
+    spin_unlock_irqrestore(&term->lock, flags);
+    return 0;
+}
+
+/* void terminal_release(uint32_t pid);
+ * Puts the terminal back into line mode if pid left it raw. Called from
+ * halt, so a program that dies in raw mode does not take the shell's line
+ * editing with it.
+ *
+ * Inputs: pid - process that is halting
+ * Return Value: none */
+void terminal_release(uint32_t pid) {
+    terminal_t* term = cur_terminal;
+    int32_t mode = TERMINAL_LINE;
+
+    if(term->raw && term->raw_pid == pid)
+        terminal_mode(0, &mode, sizeof(mode));
+}
+
 /* void get_char(char new_char);
- * Puts the most recently entered keyboard character into the char_buffer
- * for terminal_read and updates if enter has been pressed.
+ * Applies the most recently entered key to the line being edited and echoes
+ * the change to the screen. Enter hands the line over to terminal_read.
+ * In raw mode the key is queued for terminal_read as it is, unechoed.
  *
- * Inputs: new_char - The character entered by the keyboard
+ * Inputs: new_char - The character or KEY_* code entered by the keyboard
  * Return Value: none
- * Side effects: char_buffer, char_count, and enter_flag are changed */
+ * Side effects: the current terminal's line and history are changed */
 void get_char(char new_char) {
-    //End the buffer with the newline and enable the enter_flag.
-    if(new_char == '\n') {
-        enter_flag = 1;
-        if(char_count >= BUFFER_SIZE)
-            char_buffer[BUFFER_SIZE - 1] = '\n';
-        else
-            char_buffer[char_count] = '\n';
-    //Clear one space of the buffer.
-    } else if(new_char == BCKSPACE) {
-        if(char_count > 0){
-            if(char_count <= BUFFER_SIZE)
-                char_buffer[char_count - 1] = ' ';
-            --char_count;
+    terminal_t* term = cur_terminal;
+    uint32_t flags;
+
+    spin_lock_irqsave(&term->lock, flags);
+    if(term->raw) {
+        if(term->read_len < BUFFER_SIZE)
+            term->read_buffer[term->read_len++] = new_char;
+        term->enter_flag = 1;
+        spin_unlock_irqrestore(&term->lock, flags);
+        return;
+    }
+    switch(new_char) {
+    case '\n':
+        line_enter(term);
+        break;
+    case BCKSPACE:
+        if(term->cursor > 0) {
+            move_cursor(-1);
+            --term->cursor;
+            line_erase(term, term->cursor);
+        }
+        break;
+    case KEY_DELETE:
+        if(term->cursor < term->line_len)
+            line_erase(term, term->cursor);
+        break;
+    case KEY_LEFT:
+        if(term->cursor > 0) {
+            move_cursor(-1);
+            --term->cursor;
+        }
+        break;
+    case KEY_RIGHT:
+        if(term->cursor < term->line_len) {
+            move_cursor(1);
+            ++term->cursor;
         }
-    //Add a new character to the buffer.
-    } else if(char_count < (BUFFER_SIZE - 1)){
-        char_buffer[char_count] = new_char;
-        ++char_count;
+        break;
+    case KEY_HOME:
+        move_cursor(-term->cursor);
+        term->cursor = 0;
+        break;
+    case KEY_END:
+        move_cursor(term->line_len - term->cursor);
+        term->cursor = term->line_len;
+        break;
+    case KEY_UP:
+        line_history(term, 1);
+        break;
+    case KEY_DOWN:
+        line_history(term, -1);
+        break;
+    default:
+        //Leave room for the newline
+        if(term->line_len < (BUFFER_SIZE - 1))
+            line_insert(term, new_char);
+        break;
     }
-    //Keep track of the available number of backspaces that can be used.
-    else{
-        ++char_count;
+    spin_unlock_irqrestore(&term->lock, flags);
+}
+
+/* static void line_insert(terminal_t* term, char new_char);
+ * Inserts a character at the cursor and redraws the rest of the line.
+ * Inputs: term - terminal being edited
+ *     new_char - character to insert
+ * Return Value: none */
+static void line_insert(terminal_t* term, char new_char) {
+    int32_t i;
+
+    for(i = term->line_len; i > term->cursor; --i)
+        term->line[i] = term->line[i - 1];
+    term->line[term->cursor] = new_char;
+    ++term->line_len;
+
+    for(i = term->cursor; i < term->line_len; ++i)
+        putc(term->line[i]);
+    ++term->cursor;
+    move_cursor(term->cursor - term->line_len);
+}
+
+/* static void line_erase(terminal_t* term, int32_t index);
+ * Removes the character at index, which must be at the cursor, and redraws
+ * the rest of the line.
+ * Inputs: term - terminal being edited
+ *        index - position of the character to remove
+ * Return Value: none */
+static void line_erase(terminal_t* term, int32_t index) {
+    int32_t i;
+
+    for(i = index; i < term->line_len - 1; ++i)
+        term->line[i] = term->line[i + 1];
+    --term->line_len;
+
+    for(i = index; i < term->line_len; ++i)
+        putc(term->line[i]);
+    putc(' ');                                  //Blank the old last character
+    move_cursor(index - term->line_len - 1);
+}
+
+/* static void line_replace(terminal_t* term, const char* text);
+ * Replaces the whole line with a NULL terminated string and leaves the
+ * cursor at its end.
+ * Inputs: term - terminal being edited
+ *         text - new contents of the line
+ * Return Value: none */
+static void line_replace(terminal_t* term, const char* text) {
+    int32_t i;
+    int32_t old_len = term->line_len;
+
+    move_cursor(-term->cursor);
+    for(i = 0; i < (BUFFER_SIZE - 1) && text[i] != '\0'; ++i) {
+        term->line[i] = text[i];
+        putc(text[i]);
+    }
+    term->line_len = i;
+    term->cursor = i;
+
+    //Blank what is left of a longer previous line
+    for(; i < old_len; ++i)
+        putc(' ');
+    move_cursor(term->line_len - i);
+}
+
+/* static void line_history(terminal_t* term, int32_t step);
+ * Moves through the history ring and shows the selected line.
+ * Inputs: term - terminal being edited
+ *         step - 1 for an older line, -1 for a newer one
+ * Return Value: none */
+static void line_history(terminal_t* term, int32_t step) {
+    int32_t pos = term->history_pos + step;
+    int32_t slot;
+
+    if(pos < 0 || pos > term->history_count)
+        return;
+    term->history_pos = pos;
+
+    //Position 0 is the empty line below the newest entry
+    if(pos == 0) {
+        line_replace(term, "");
+        return;
+    }
+    slot = (term->history_head - pos + HISTORY_SIZE) % HISTORY_SIZE;
+    line_replace(term, term->history[slot]);
+}
+
+/* static void line_enter(terminal_t* term);
+ * Finishes the line: records it in the history ring and hands it to
+ * terminal_read with a trailing newline.
+ * Inputs: term - terminal being edited
+ * Return Value: none */
+static void line_enter(terminal_t* term) {
+    int32_t i;
+    int32_t newest = (term->history_head - 1 + HISTORY_SIZE) % HISTORY_SIZE;
+
+    move_cursor(term->line_len - term->cursor);
+    putc('\n');
+    term->line[term->line_len] = '\0';
+
+    //Skip empty lines and repeats of the newest entry
+    if(term->line_len > 0 && (term->history_count == 0 ||
+       strncmp((int8_t*)term->line, (int8_t*)term->history[newest], BUFFER_SIZE) != 0)) {
+        for(i = 0; i <= term->line_len; ++i)
+            term->history[term->history_head][i] = term->line[i];
+        term->history_head = (term->history_head + 1) % HISTORY_SIZE;
+        if(term->history_count < HISTORY_SIZE)
+            ++term->history_count;
     }
+
+    for(i = 0; i < term->line_len; ++i)
+        term->read_buffer[i] = term->line[i];
+    term->read_buffer[i] = '\n';
+    term->read_len = term->line_len + 1;
+    term->enter_flag = 1;
+
+    term->line_len = 0;
+    term->cursor = 0;
+    term->history_pos = 0;
 }
@@ -3,14 +3,45 @@
 
 
 #include "types.h"
+#include "spinlock.h"
 
 #define BUFFER_SIZE   128
+#define HISTORY_SIZE  16      //Number of previous lines kept per terminal
+#define NUM_TERMINALS 1
+
+//Modes written to stdin, see terminal_mode
+#define TERMINAL_LINE 0       //Lines are edited and handed over on enter
+#define TERMINAL_RAW  1       //Every key, KEY_* codes included, goes to read unechoed
+
+/* Per terminal line editing state. Everything lives in fixed arrays so that
+ * editing from the keyboard interrupt never allocates. */
+typedef struct {
+    char line[BUFFER_SIZE];                 //Line currently being edited
+    int32_t line_len;
+    int32_t cursor;                         //Edit position within line
+
+    char history[HISTORY_SIZE][BUFFER_SIZE];    //Ring of entered lines
+    int32_t history_head;                   //Slot the next line is stored in
+    int32_t history_count;
+    int32_t history_pos;                    //Lines back while browsing, 0 = live line
+
+    char read_buffer[BUFFER_SIZE];          //Finished line waiting for terminal_read
+    int32_t read_len;
+    volatile int32_t enter_flag;            //Set when read_buffer holds a line,
+                                            //or any keys in raw mode
+    int32_t raw;                            //TERMINAL_RAW while a program asked for it
+    uint32_t raw_pid;                       //and which one, to undo it when it halts
+
+    spinlock_t lock;                        //Guards all of the above
+} terminal_t;
 
 //Terminal system call functions. (see terminal.c for descriptions)
 extern int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 extern int32_t terminal_open(const uint8_t* filename);
 extern int32_t terminal_close(int32_t fd);
+extern int32_t terminal_mode(int32_t fd, const void* buf, int32_t nbytes);
+extern void terminal_release(uint32_t pid);
 
 //Connect keybaord to terminal functions. (see terminal.c for descriptions)
 extern void get_char(char new_char);
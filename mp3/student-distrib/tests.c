@@ -5,6 +5,29 @@
 #include "rtc.h"
 #include "fs_driver.h"
 #include "terminal.h"
+#include "keyboard.h"
+#include "proc.h"
+#include "stats.h"
+#include "trace.h"
+#include "prof.h"
+#include "elf.h"
+#include "paging.h"
+#include "frame.h"
+#include "syscall.h"
+#include "sched.h"
+#include "signal.h"
+#include "crash.h"
+#include "smp.h"
+#include "pit.h"
+#include "i8259.h"
+#include "apic.h"
+#include "ioapic.h"
+#include "ktest.h"
+#include "serial.h"
+#include "lz4.h"
+#include "ata.h"
+#include "bcache.h"
+#include "bootprof.h"
 
 #define PASS 1
 #define FAIL 0
@@ -13,7 +36,7 @@
 #define TEST_HEADER     \
     printf("[TEST %s] Running %s at %s:%d\n", __FUNCTION__, __FUNCTION__, __FILE__, __LINE__)
 #define TEST_OUTPUT(name, result)    \
-    printf("[TEST %s] Result = %s\n", name, (result) ? "PASS" : "FAIL");
+    ktest_result(name, result);
 
 static inline void assertion_failure(){
     /* Use exception #15 for assertions, otherwise
@@ -273,8 +296,8 @@ int dir_test(){
 
     for(i=0;i<dentry_num;i++){
         cur_dentry = (dentry_t*)&(boot_block_ptr->dentry[i]);
-        cur_inode_block_ptr = (inode_t*)(inode_ptr + (cur_dentry->inode_num));
-        size = cur_inode_block_ptr->length;
+        cur_inode_block_ptr = fs_inode(cur_dentry->inode_num);
+        size = (cur_inode_block_ptr != NULL) ? cur_inode_block_ptr->length : 0;
         dir_read(empty_fd,buf,empty_nbytes);
         printf("file_name: ");
         print_filename(buf);
@@ -318,6 +341,41 @@ int term_driver_test(){
     return PASS;
 }
 
+/*    terminal_raw_test
+*    inputs: none
+*    Coverage: terminal_mode, terminal_release, get_char, terminal_read
+*    Function: In raw mode keys, arrows included, reach terminal_read as
+*              they were typed and a short read leaves the rest queued.
+*              Halting the owner puts line editing back, which eats the
+*              arrow and hands over only the newline.
+*    Files: terminal.c
+*/
+int terminal_raw_test(){
+    TEST_HEADER;
+    int32_t mode = TERMINAL_RAW;
+    int32_t bad = 2;
+    char buf[4];
+    int result = PASS;
+
+    if(terminal_mode(0, &bad, sizeof(bad)) != -1 || terminal_mode(0, &mode, 2) != -1)
+        return FAIL;
+    if(terminal_mode(0, &mode, sizeof(mode)) != 0)
+        return FAIL;
+    get_char(KEY_LEFT);
+    get_char('a');
+    get_char(KEY_UP);
+    if(terminal_read(0, buf, 2) != 2 || buf[0] != KEY_LEFT || buf[1] != 'a')
+        result = FAIL;
+    if(terminal_read(0, buf, sizeof(buf)) != 1 || buf[0] != KEY_UP)
+        result = FAIL;
+
+    terminal_release(cur_pid);
+    get_char(KEY_LEFT);
+    get_char('\n');
+    if(terminal_read(0, buf, sizeof(buf)) != 1 || buf[0] != '\n')
+        result = FAIL;
+    return result;
+}
 
 /*    file_test
 *    inputs: none
@@ -366,11 +424,1087 @@ int file_test(){
     return PASS;
 }
 
+/*    proc_test
+*    inputs: none
+*    Coverage: read_dentry_by_name falling back to the pseudo files, stats_show,
+*              bootprof_show
+*    Function: looks up irqstat and bootprof and checks that their text can be built
+*    Files: proc.c, stats.c, bootprof.c, fs_driver.c
+*/
+int proc_test(){
+    TEST_HEADER;
+    dentry_t dentry;
+    int8_t text[PROC_BUF_SIZE];
+
+    if(read_dentry_by_name((uint8_t*)"irqstat", &dentry) != 0)
+        return FAIL;
+    if(dentry.ftype != PROC_FTYPE)
+        return FAIL;
+    if(read_dentry_by_name((uint8_t*)"irqstatx", &dentry) != -1)
+        return FAIL;
+    if(stats_show(text, PROC_BUF_SIZE) <= 0)
+        return FAIL;
+    //The boot stamped its stages before any test runs
+    if(read_dentry_by_name((uint8_t*)"bootprof", &dentry) != 0)
+        return FAIL;
+    if(bootprof_show(text, PROC_BUF_SIZE) <= 0)
+        return FAIL;
+    return PASS;
+}
+
+/*    fs_hash_test
+*    inputs: none
+*    Coverage: fs_name_hash, read_dentry_by_name with and without a hash table
+*    Function: checks a known FNV-1a value, then looks every boot block file up
+*              by name and expects the dentry it came from
+*    Files: fs_driver.c
+*/
+int fs_hash_test(){
+    TEST_HEADER;
+    dentry_t dentry;
+    uint8_t name[MAX_FILENAME + 1];
+    uint32_t i;
+
+    if(fs_name_hash((uint8_t*)"a") != 0xE40C292C)
+        return FAIL;
+    for(i = 0; i < boot_block_ptr->num_dentries; i++){
+        //Names of exactly MAX_FILENAME characters have no NULL
+        strncpy((int8_t*)name, (int8_t*)dentry_ptr[i].fname, MAX_FILENAME);
+        name[MAX_FILENAME] = '\0';
+        if(read_dentry_by_name(name, &dentry) != 0)
+            return FAIL;
+        if(dentry.inode_num != dentry_ptr[i].inode_num || dentry.ftype != dentry_ptr[i].ftype)
+            return FAIL;
+    }
+    if(read_dentry_by_name((uint8_t*)"nosuchfile", &dentry) != -1)
+        return FAIL;
+    return PASS;
+}
+
+/*    trace_test
+*    inputs: none
+*    Coverage: trace_ring_add, trace_ring_copy, trace, syshist_show
+*    Function: fills a ring of its own past the wrap and reads back the
+*              newest records in order. The live ring and histograms are
+*              only read, so trace and syshist show no test records.
+*              trace refuses kernel buffers and ones running off the user
+*              page.
+*    Files: trace.c
+*/
+int trace_test(){
+    TEST_HEADER;
+    static trace_ring_t ring;
+    trace_rec_t rec = { 0, 5, { 1, 2, 3 }, -1, 100 };
+    trace_rec_t recs[2];
+    trace_rec_t* user = (trace_rec_t*)(USER_MEM + PAGE_4MB - sizeof(trace_rec_t));
+    int8_t text[PROC_BUF_SIZE];
+    uint32_t i;
+
+    memset(&ring, 0, sizeof(ring));
+    if(trace_ring_copy(&ring, recs, 2) != 0)
+        return FAIL;
+    for(i = 0; i <= TRACE_RING_SIZE; i++){
+        rec.cycles = i;
+        trace_ring_add(&ring, &rec);
+    }
+    if(trace_ring_copy(&ring, recs, 2) != 2)
+        return FAIL;
+    if(recs[0].cycles != TRACE_RING_SIZE - 1 || recs[1].cycles != TRACE_RING_SIZE ||
+       recs[1].num != 5 || recs[1].args[2] != 3 || recs[1].ret != -1)
+        return FAIL;
+    if(trace(NULL, sizeof(recs)) != -1 || trace(recs, sizeof(recs)) != -1)
+        return FAIL;
+    if(trace(user, sizeof(trace_rec_t) + 1) != -1 || trace(user, sizeof(trace_rec_t) - 1) != 0)
+        return FAIL;
+    if(syshist_show(text, PROC_BUF_SIZE) <= 0)
+        return FAIL;
+    return PASS;
+}
+
+/*    prof_test
+*    inputs: none
+*    Coverage: prof_ctl, prof_tick, prof_read
+*    Function: feeds the profiler fake ticks with interrupts off and drains
+*              the samples one at a time into the top user page. Kernel
+*              addresses and buffers running off the user page are refused.
+*    Files: prof.c
+*/
+int prof_test(){
+    TEST_HEADER;
+    irq_frame_t frame = { 0x400123, 0, 0 };
+    prof_sample_t* samples = (prof_sample_t*)(USER_MEM + PAGE_4MB - 2 * sizeof(prof_sample_t));
+    prof_sample_t kernel_samples[2];
+    uint32_t flags;
+    int result = PASS;
+
+    user_paging_switch(0);
+    user_paging_reset(0);
+    user_map_range(0, USER_MEM + PAGE_4MB - ALIGN_4KB, USER_MEM + PAGE_4MB, USER_MAP_WRITE);
+
+    cli_and_save(flags);
+    prof_ctl(2);
+    prof_tick(&frame);
+    prof_tick(&frame);              //Sampled, every second tick
+    prof_tick(&frame);
+    prof_ctl(0);
+    prof_tick(&frame);              //Off, ignored
+    restore_flags(flags);
+
+    if(prof_read(kernel_samples, sizeof(kernel_samples)) != -1 ||
+       prof_read(samples, 2 * sizeof(prof_sample_t) + 1) != -1)
+        result = FAIL;
+    if(prof_read(samples, 2 * sizeof(prof_sample_t)) != sizeof(prof_sample_t))
+        result = FAIL;
+    if(samples[0].eip != 0x400123)
+        result = FAIL;
+    if(prof_read(samples, 2 * sizeof(prof_sample_t)) != 0)
+        result = FAIL;
+    user_paging_reset(0);
+    return result;
+}
+
+/* Static, so kept small: the kernel's .bss shares its 4MB page with the
+ * kernel stacks */
+#define LIB_TEST_MAX    (16 * 1024)
+#define PRINTF_BENCH_SIZE   512
+#define LIB_TEST_PAD    16
+
+static uint8_t lib_src[LIB_TEST_MAX + LIB_TEST_PAD];
+static uint8_t lib_dst[LIB_TEST_MAX + LIB_TEST_PAD];
+static uint8_t lib_ref[LIB_TEST_MAX + LIB_TEST_PAD];
+static uint32_t lib_lens[] = { 0, 1, 3, 4, 5, 15, 16, 63, 64, 100, 511, 512, 513, 4097, LIB_TEST_MAX };
+
+/* Fills buf with a pattern that has no zero bytes */
+static void lib_fill(uint8_t* buf, uint32_t n, uint32_t seed) {
+    uint32_t i;
+    for (i = 0; i < n; i++)
+        buf[i] = ((i * 7 + seed) % 255) + 1;
+}
+
+/* Byte by byte compare, independent of the code under test */
+static int lib_same(const uint8_t* a, const uint8_t* b, uint32_t n) {
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return 0;
+    }
+    return 1;
+}
+
+/*    string_lib_test
+*    inputs: none
+*    Coverage: memcpy, memmove, strlen, strcpy, strncpy, strncmp
+*    Function: checks every source/destination alignment 0-3 over lengths
+*              up to 16K against byte loops, including overlapping memmoves
+*              in both directions and the direction flag afterwards
+*    Files: lib.c
+*/
+int string_lib_test(){
+    TEST_HEADER;
+    uint32_t l, n, sa, da, i;
+    uint32_t eflags;
+
+    for (l = 0; l < sizeof(lib_lens) / sizeof(lib_lens[0]); l++) {
+        n = lib_lens[l];
+        for (sa = 0; sa < 4; sa++) {
+            for (da = 0; da < 4; da++) {
+                lib_fill(lib_src, sizeof(lib_src), n + sa);
+                lib_fill(lib_dst, sizeof(lib_dst), da);
+                lib_fill(lib_ref, sizeof(lib_ref), da);
+                for (i = 0; i < n; i++)
+                    lib_ref[da + i] = lib_src[sa + i];
+                if (memcpy(lib_dst + da, lib_src + sa, n) != lib_dst + da)
+                    return FAIL;
+                if (!lib_same(lib_dst, lib_ref, sizeof(lib_dst)))
+                    return FAIL;
+
+                //Overlapping, dest below src: copies forward
+                if (n + 8 + sa + da <= sizeof(lib_dst)) {
+                    for (i = 0; i < sizeof(lib_ref); i++)
+                        lib_ref[i] = lib_dst[i];
+                    for (i = 0; i < n; i++)
+                        lib_ref[da + i] = lib_ref[da + 8 + sa + i];
+                    if (memmove(lib_dst + da, lib_dst + da + 8 + sa, n) != lib_dst + da)
+                        return FAIL;
+                    if (!lib_same(lib_dst, lib_ref, sizeof(lib_dst)))
+                        return FAIL;
+                }
+
+                //Overlapping, dest above src: must copy backward
+                if (n + LIB_TEST_PAD / 2 <= LIB_TEST_MAX) {
+                    for (i = 0; i < sizeof(lib_ref); i++)
+                        lib_ref[i] = lib_src[i];
+                    for (i = n; i > 0; i--)
+                        lib_ref[da + 8 + i - 1] = lib_ref[sa + i - 1];
+                    if (memmove(lib_src + da + 8, lib_src + sa, n) != lib_src + da + 8)
+                        return FAIL;
+                    if (!lib_same(lib_src, lib_ref, sizeof(lib_src)))
+                        return FAIL;
+                    asm volatile ("pushfl; popl %0" : "=r"(eflags));
+                    if (eflags & 0x400)             //DF must be clear again
+                        return FAIL;
+                }
+
+                //Strings of length n, terminated inside the buffer
+                if (n + sa < LIB_TEST_MAX) {
+                    lib_fill(lib_src, sizeof(lib_src), n);
+                    lib_src[sa + n] = '\0';
+                    if (strlen((int8_t*)lib_src + sa) != n)
+                        return FAIL;
+                    lib_fill(lib_dst, sizeof(lib_dst), 1);
+                    strcpy((int8_t*)lib_dst + da, (int8_t*)lib_src + sa);
+                    if (!lib_same(lib_dst + da, lib_src + sa, n + 1) || lib_dst[da + n + 1] == 0)
+                        return FAIL;
+                    if (strncmp((int8_t*)lib_dst + da, (int8_t*)lib_src + sa, n + 4) != 0)
+                        return FAIL;
+                    if (n > 0) {
+                        lib_dst[da + n - 1]++;
+                        if (strncmp((int8_t*)lib_dst + da, (int8_t*)lib_src + sa, n) == 0)
+                            return FAIL;
+                        if (strncmp((int8_t*)lib_dst + da, (int8_t*)lib_src + sa, n - 1) != 0)
+                            return FAIL;
+                    }
+                    lib_fill(lib_dst, sizeof(lib_dst), 1);
+                    strncpy((int8_t*)lib_dst + da, (int8_t*)lib_src + sa, n + 5);
+                    if (!lib_same(lib_dst + da, lib_src + sa, n) || lib_dst[da + n] != 0 || lib_dst[da + n + 4] != 0)
+                        return FAIL;
+                }
+            }
+        }
+    }
+    return PASS;
+}
+
+/*    string_lib_bench
+*    inputs: none
+*    Coverage: memcpy, memmove, strlen
+*    Function: prints the TSC cycles taken by a 16K copy, move and strlen
+*              next to a plain byte loop doing the same copy
+*    Files: lib.c
+*/
+int string_lib_bench(){
+    TEST_HEADER;
+    uint32_t start, i;
+
+    lib_fill(lib_src, LIB_TEST_MAX, 0);
+    lib_src[LIB_TEST_MAX - 1] = '\0';
+
+    start = rdtsc();
+    for (i = 0; i < LIB_TEST_MAX; i++)
+        ((volatile uint8_t*)lib_dst)[i] = lib_src[i];
+    printf("byte loop  16K: %d cycles\n", rdtsc() - start);
+    start = rdtsc();
+    memcpy(lib_dst, lib_src, LIB_TEST_MAX);
+    printf("memcpy     16K: %d cycles\n", rdtsc() - start);
+    start = rdtsc();
+    memcpy(lib_dst + 1, lib_src + 3, LIB_TEST_MAX - 3);
+    printf("memcpy +1+3 16K: %d cycles\n", rdtsc() - start);
+    start = rdtsc();
+    memmove(lib_src + 4, lib_src, LIB_TEST_MAX - 4);
+    printf("memmove    16K: %d cycles\n", rdtsc() - start);
+    lib_fill(lib_src, LIB_TEST_MAX, 0);
+    lib_src[LIB_TEST_MAX - 1] = '\0';
+    start = rdtsc();
+    strlen((int8_t*)lib_src);
+    printf("strlen     16K: %d cycles\n", rdtsc() - start);
+    return PASS;
+}
+
+/*    lz4_test
+*    inputs: none
+*    Coverage: lz4_decompress, read_data across piece boundaries
+*    Function: decodes a block with an overlapping match and rejects
+*              corrupt ones, then reads fish in odd sized chunks, with the
+*              cache flushed halfway, and compares with one whole read
+*    Files: lz4.c, fs_driver.c
+*/
+int lz4_test(){
+    TEST_HEADER;
+    //"abc", a match 3 back of 9 bytes, then "!"
+    static const uint8_t block[] = { 0x35, 'a', 'b', 'c', 3, 0, 0x10, '!' };
+    static const uint8_t far[] = { 0x10, 'a', 2, 0, 0x00 };
+    static const uint8_t cut[] = { 0x35, 'a', 'b', 'c', 3 };
+    uint8_t out[16];
+    dentry_t dentry;
+    int32_t length, n, pos, i;
+
+    if(lz4_decompress(block, sizeof(block), out, sizeof(out)) != 13 ||
+       strncmp((int8_t*)out, "abcabcabcabc!", 13))
+        return FAIL;
+    if(lz4_decompress(block, sizeof(block), out, 12) != -1)
+        return FAIL;
+    if(lz4_decompress(far, sizeof(far), out, sizeof(out)) != -1)
+        return FAIL;
+    if(lz4_decompress(cut, sizeof(cut), out, sizeof(out)) != -1)
+        return FAIL;
+
+    if(read_dentry_by_name((uint8_t*)"fish", &dentry) != 0)
+        return FAIL;
+    length = read_data(dentry.inode_num, 0, lib_ref, LIB_TEST_MAX);
+    if(length <= BLOCK_SIZE)
+        return FAIL;
+    for(pos = 0; pos < length; pos += n){
+        if(pos > length / 2 && pos - 1000 <= length / 2)
+            fs_cache_flush();
+        n = read_data(dentry.inode_num, pos, lib_dst + pos, (length - pos < 1000) ? length - pos : 1000);
+        if(n <= 0)
+            return FAIL;
+    }
+    for(i = 0; i < length; i++){
+        if(lib_dst[i] != lib_ref[i])
+            return FAIL;
+    }
+    return PASS;
+}
+
+/*    bcache_test
+*    inputs: none
+*    Coverage: ata_read, bcache_get
+*    Function: reads the first block through the cache, and again straight
+*              from the disk into an odd address, and expects the same
+*              bytes. Asking again must be a hit. Without a disk there is
+*              nothing to check.
+*    Files: ata.c, bcache.c
+*/
+int bcache_test(){
+    TEST_HEADER;
+    static uint8_t pio[BLOCK_SIZE + 1];
+    uint8_t* block;
+    int32_t i;
+
+    if(!ata_present)
+        return PASS;
+    if(ata_read(ata_sectors, 1, pio) != -1)
+        return FAIL;
+    block = bcache_get(0);
+    if(block == NULL || bcache_get(0) != block)
+        return FAIL;
+    if(ata_read(0, BLOCK_SIZE / ATA_SECTOR_SIZE, pio + 1) != 0)
+        return FAIL;
+    for(i = 0; i < BLOCK_SIZE; i++){
+        if(pio[i + 1] != block[i])
+            return FAIL;
+    }
+    return PASS;
+}
+
+/*    snprintf_test
+*    inputs: none
+*    Coverage: snprintf
+*    Function: checks the conversions, field widths and truncation
+*    Files: lib.c
+*/
+int snprintf_test(){
+    TEST_HEADER;
+    int8_t buf[64];
+    int8_t small[8];
+
+    snprintf(buf, sizeof(buf), "%02x|%-5s|%4u|%#x|%d|%c%%", 5, "ab", 42, 0xE, -7, 'z');
+    if(strncmp(buf, "05|ab   |  42|0000000E|-7|z%", sizeof(buf)) != 0)
+        return FAIL;
+    if(snprintf(small, sizeof(small), "%s", "truncated") != sizeof(small) - 1)
+        return FAIL;
+    if(strncmp(small, "truncat", sizeof(small)) != 0)
+        return FAIL;
+    if(snprintf(small, 0, "x") != 0)
+        return FAIL;
+    return PASS;
+}
+
+/* Prints the exception_handler register dump with made up values */
+static void printf_bench_regs(){
+    printf("ESP: %#x \t ESI: %#x\n", 0x7FFFF0, 0x1234);
+    printf("EBP: %#x \t EDI: %#x\n", 0x7FFFFC, 0x5678);
+    printf("EAX: %#x \t EBX: %#x\n", 0xFFFFFFFF, 0);
+    printf("ECX: %#x \t EDX: %#x\n", 0x80, 0x3D5);
+    printf("EFLAGS: %#x\n", 0x202);
+    printf("\nERROR: %#x\n", 0);
+}
+
+/* Prints the module bytes the way kernel.c does at boot */
+static void printf_bench_multiboot(){
+    int i;
+    printf("Module %d loaded at address: 0x%#x\n", 0, 0x410000);
+    printf("Module %d ends at address: 0x%#x\n", 0, 0x47C000);
+    printf("First few bytes of module:\n");
+    for (i = 0; i < 16; i++)
+        printf("0x%x ", i * 17);
+    printf("\n");
+}
+
+/*    printf_bench
+*    inputs: none
+*    Coverage: printf, console_write
+*    Function: prints the TSC cycles taken by the exception register dump and
+*              the boot module print, then by the same text sent through putc
+*              one character at a time the way printf used to
+*    Files: lib.c, idt.c, kernel.c
+*/
+int printf_bench(){
+    TEST_HEADER;
+    int8_t text[PRINTF_BENCH_SIZE];
+    uint32_t start, regs, boot, regs_putc, boot_putc;
+    int32_t i, len;
+
+    start = rdtsc();
+    printf_bench_regs();
+    regs = rdtsc() - start;
+    start = rdtsc();
+    printf_bench_multiboot();
+    boot = rdtsc() - start;
+
+    len = snprintf(text, sizeof(text), "ESP: %#x \t ESI: %#x\nEBP: %#x \t EDI: %#x\n"
+                   "EAX: %#x \t EBX: %#x\nECX: %#x \t EDX: %#x\nEFLAGS: %#x\n\nERROR: %#x\n",
+                   0x7FFFF0, 0x1234, 0x7FFFFC, 0x5678, 0xFFFFFFFF, 0, 0x80, 0x3D5, 0x202, 0);
+    start = rdtsc();
+    for (i = 0; i < len; i++)
+        putc(text[i]);
+    regs_putc = rdtsc() - start;
+
+    len = snprintf(text, sizeof(text), "Module %d loaded at address: 0x%#x\n"
+                   "Module %d ends at address: 0x%#x\nFirst few bytes of module:\n", 0, 0x410000, 0, 0x47C000);
+    for (i = 0; i < 16; i++)
+        len += snprintf(text + len, sizeof(text) - len, "0x%x ", i * 17);
+    len += snprintf(text + len, sizeof(text) - len, "\n");
+    start = rdtsc();
+    for (i = 0; i < len; i++)
+        putc(text[i]);
+    boot_putc = rdtsc() - start;
+
+    printf("register dump: %u cycles, %u per character\n", regs, regs_putc);
+    printf("multiboot:     %u cycles, %u per character\n", boot, boot_putc);
+    return PASS;
+}
+
+/*    elf_test
+*    inputs: none
+*    Coverage: elf_read, elf_validate
+*    Function: accepts every program built from syscalls/, rejects text
+*              files and headers broken one field at a time
+*    Files: elf.c
+*/
+int elf_test(){
+    TEST_HEADER;
+    static int8_t* programs[] = { "shell", "ls", "cat", "grep", "hello", "counter",
+                                  "pingpong", "sigtest", "syserr", "testprint", "fish" };
+    elf_image_t image;
+    elf_phdr_t* text;
+    dentry_t dentry;
+    uint32_t i, save;
+
+    for(i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        if(read_dentry_by_name((uint8_t*)programs[i], &dentry) != 0)
+            return FAIL;
+        if(elf_read(dentry.inode_num, &image) != 0)
+            return FAIL;
+    }
+    if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) != 0)
+        return FAIL;
+    if(elf_read(dentry.inode_num, &image) != -1)
+        return FAIL;
+
+    //image holds fish, change one thing at a time
+    text = &image.phdrs[0];
+    image.hdr.ident[EI_CLASS] = 2;
+    if(elf_validate(&image) != -1)
+        return FAIL;
+    image.hdr.ident[EI_CLASS] = ELFCLASS32;
+    save = text->filesz;
+    text->filesz = text->memsz + 1;
+    if(elf_validate(&image) != -1)
+        return FAIL;
+    text->filesz = save;
+    save = text->vaddr;
+    text->vaddr = KERNEL_ADDR;
+    if(elf_validate(&image) != -1)
+        return FAIL;
+    text->vaddr = save;
+    save = image.hdr.entry;
+    image.hdr.entry = USER_MEM + PAGE_4MB - 4;
+    if(elf_validate(&image) != -1)
+        return FAIL;
+    image.hdr.entry = save;
+    save = text->memsz;
+    text->memsz = PAGE_4MB;
+    if(elf_validate(&image) != -1)
+        return FAIL;
+    text->memsz = save;
+
+    return (elf_validate(&image) == 0) ? PASS : FAIL;
+}
+
+/*    lazy_page_test
+*    inputs: none
+*    Coverage: user_map_range, page_fault_resolve
+*    Function: maps the top user page on demand, touches it and checks it
+*              came in zero filled and writable
+*    Files: paging.c, idt.c
+*/
+int lazy_page_test(){
+    TEST_HEADER;
+    volatile uint32_t* top = (uint32_t*)(USER_MEM + PAGE_4MB - ALIGN_4KB);
+    int result = PASS;
+
+    user_paging_switch(0);
+    user_paging_reset(0);
+    user_map_range(0, (uint32_t)top, USER_MEM + PAGE_4MB, USER_MAP_WRITE | USER_MAP_LAZY);
+    if(page_table_user[0][MAX_SPACES - 1].present)
+        result = FAIL;
+    if(top[5] != 0)                 //Faults and is filled here
+        result = FAIL;
+    top[5] = 0x391;
+    if(top[5] != 0x391 || !page_table_user[0][MAX_SPACES - 1].present)
+        result = FAIL;
+    user_paging_reset(0);
+    return result;
+}
+
+/*    map_page_test
+*    inputs: none
+*    Coverage: map_page, unmap_page, paging_init, kmap
+*    Function: maps a frame at a free kernel address, writes it there and
+*              reads it back through kmap, then checks it is gone after
+*              unmap_page. The kernel page must be global and refuse 4kB
+*              pages.
+*    Files: paging.c, frame.c
+*/
+int map_page_test(){
+    TEST_HEADER;
+    uint32_t vaddr = KMAP_ADDR + KMAP_SLOTS * ALIGN_4KB;   //Past the kmap slots
+    volatile uint32_t* page = (uint32_t*)vaddr;
+    uint32_t* window;
+    table_entry_desc_t* table;
+    uint32_t ppn;
+    int result = PASS;
+
+    if(!(page_directory[KERNEL_ADDR / PAGE_4MB].val & PG_GLOBAL))
+        result = FAIL;
+    if(map_page(KERNEL_ADDR, KERNEL_ADDR, PG_WRITE) != -1)
+        result = FAIL;
+
+    ppn = frame_alloc();
+    if(ppn == 0)
+        return FAIL;
+    if(map_page(vaddr, ppn * ALIGN_4KB, PG_WRITE) != 0)
+        result = FAIL;
+    page[3] = 0x391;
+    window = kmap(ppn, 0);
+    if(window[3] != 0x391)
+        result = FAIL;
+    kunmap(0);
+    unmap_page(vaddr);
+    table = (table_entry_desc_t*)(page_directory[vaddr / PAGE_4MB].val & PG_ADDR_MASK);
+    if(table[(vaddr / ALIGN_4KB) % MAX_SPACES].present)
+        result = FAIL;
+    frame_put(ppn);
+    return result;
+}
+
+/*    vidmap_buffer_test
+*    inputs: none
+*    Coverage: user_vidmap, user_vidmap_buffered, user_paging_switch,
+*              user_paging_reset
+*    Function: gives process 0 a back page and checks it starts as a copy
+*              of the screen, that writes to it stay off the screen, that
+*              it comes back after running another process and that going
+*              back to plain vidmap shows video memory again
+*    Files: paging.c
+*/
+int vidmap_buffer_test(){
+    TEST_HEADER;
+    volatile uint8_t* screen = (uint8_t*)VIDMEM_ADDR;
+    volatile uint8_t* user = (uint8_t*)VM_VIDEO;
+    uint8_t shown;
+    int result = PASS;
+
+    user_paging_switch(0);
+    user_paging_reset(0);
+    if(user_vidmap_buffered(0))
+        result = FAIL;
+    if(user_vidmap(0, 1) != 0)
+        return FAIL;
+    //Odd bytes are attributes, nothing printed changes them here
+    shown = screen[1];
+    if(!user_vidmap_buffered(0) || user[1] != shown)
+        result = FAIL;
+    user[1] = shown ^ 0x77;
+    if(screen[1] != shown)
+        result = FAIL;
+
+    user_paging_switch(1);
+    user_paging_switch(0);
+    if(user[1] != (shown ^ 0x77))
+        result = FAIL;
+
+    if(user_vidmap(0, 0) != 0 || user_vidmap_buffered(0) || user[1] != screen[1])
+        result = FAIL;
+    user_paging_reset(0);
+    if(user_vidmap_buffered(0))
+        result = FAIL;
+    return result;
+}
+
+/*    page_cache_test
+*    inputs: none
+*    Coverage: elf_load, page_cache_get, user_paging_reset, meminfo_show
+*    Function: loads shell for two pids and checks that they share the text
+*              page but not the data page, and that the frames come back
+*    Files: elf.c, page_cache.c, frame.c, paging.c
+*/
+int page_cache_test(){
+    TEST_HEADER;
+    elf_image_t image;
+    dentry_t dentry;
+    uint32_t text = (PROGRAM_IMAGE_ADDR - USER_MEM) / ALIGN_4KB;
+    uint32_t data = text + 1;
+    uint32_t text_ppn;
+    int8_t info[PROC_BUF_SIZE];
+    int result = PASS;
+
+    if(read_dentry_by_name((uint8_t*)"shell", &dentry) != 0 ||
+       elf_read(dentry.inode_num, &image) != 0)
+        return FAIL;
+
+    user_paging_switch(1);
+    if(elf_load(&image, 1) != 0)
+        result = FAIL;
+    user_paging_switch(2);
+    if(elf_load(&image, 2) != 0)
+        result = FAIL;
+
+    text_ppn = page_table_user[1][text].page_addr_31_12;
+    if(!page_table_user[1][text].present || page_table_user[1][text].read_write)
+        result = FAIL;
+    if(page_table_user[2][text].page_addr_31_12 != text_ppn)
+        result = FAIL;
+    if(frame_refs(text_ppn) != 3)           //Two mappings and the cache
+        result = FAIL;
+    if(page_table_user[1][data].page_addr_31_12 == page_table_user[2][data].page_addr_31_12)
+        result = FAIL;
+    if(meminfo_show(info, PROC_BUF_SIZE) <= 0)
+        result = FAIL;
+
+    user_paging_reset(2);
+    user_paging_switch(1);
+    user_paging_reset(1);
+    user_paging_switch(0);
+    if(frame_refs(text_ppn) != 1)           //Only the cache is left
+        result = FAIL;
+    return result;
+}
+
+/*    elf_nomem_test
+*    inputs: none
+*    Coverage: elf_load, user_map_range, frame_alloc
+*    Function: takes every free frame, which also empties the page cache,
+*              and expects elf_load to fail rather than leave pages out.
+*              The frames are chained through their first word and all
+*              come back afterwards.
+*    Files: elf.c, paging.c, frame.c
+*/
+int elf_nomem_test(){
+    TEST_HEADER;
+    elf_image_t image;
+    dentry_t dentry;
+    uint32_t chain = 0;
+    uint32_t ppn;
+    int result = PASS;
+
+    if(read_dentry_by_name((uint8_t*)"shell", &dentry) != 0 ||
+       elf_read(dentry.inode_num, &image) != 0)
+        return FAIL;
+
+    while((ppn = frame_alloc()) != 0){
+        *(uint32_t*)kmap(ppn, 0) = chain;
+        kunmap(0);
+        chain = ppn;
+    }
+
+    user_paging_switch(1);
+    if(elf_load(&image, 1) != -1)
+        result = FAIL;
+    user_paging_reset(1);
+    user_paging_switch(0);
+
+    while(chain != 0){
+        ppn = chain;
+        chain = *(uint32_t*)kmap(ppn, 0);
+        kunmap(0);
+        frame_put(ppn);
+    }
+    return result;
+}
+
+/*    cow_test
+ *  Shares a loaded program with fork's page table copy and writes its data
+ *  page. The writer must get its own copy, the other table keeps the old
+ *  contents, and a page nobody else holds any more is written in place.
+ *  Coverage: user_paging_fork, page_fault_resolve */
+int cow_test(){
+    TEST_HEADER;
+    elf_image_t image;
+    dentry_t dentry;
+    uint32_t data = (PROGRAM_IMAGE_ADDR - USER_MEM) / ALIGN_4KB + 1;
+    volatile uint32_t* word = (uint32_t*)(USER_MEM + data * ALIGN_4KB);
+    uint32_t ppn;
+    uint32_t old;
+    int result = PASS;
+
+    if(read_dentry_by_name((uint8_t*)"shell", &dentry) != 0 ||
+       elf_read(dentry.inode_num, &image) != 0)
+        return FAIL;
+
+    user_paging_switch(0);
+    if(elf_load(&image, 0) != 0)
+        result = FAIL;
+    user_paging_fork(0, 1);
+
+    ppn = page_table_user[0][data].page_addr_31_12;
+    if(page_table_user[1][data].page_addr_31_12 != ppn || frame_refs(ppn) != 2)
+        result = FAIL;
+    if(page_table_user[0][data].read_write || page_table_user[1][data].read_write)
+        result = FAIL;
+
+    old = *word;
+    *word = old + 1;                        //Faults and copies the page
+    if(page_table_user[0][data].page_addr_31_12 == ppn || frame_refs(ppn) != 1)
+        result = FAIL;
+    user_paging_switch(1);
+    if(*word != old)
+        result = FAIL;
+    user_paging_switch(0);
+    user_paging_reset(1);
+
+    user_paging_fork(0, 1);
+    user_paging_reset(1);
+    ppn = page_table_user[0][data].page_addr_31_12;
+    *word = old;                            //Last holder, no copy
+    if(page_table_user[0][data].page_addr_31_12 != ppn ||
+       !page_table_user[0][data].read_write)
+        result = FAIL;
+
+    user_paging_reset(0);
+    return result;
+}
+
+/*    context_switch_test
+ *  Switches to a second stack built the way fork builds a child's, which
+ *  switches straight back. Coverage: context_switch */
+extern void context_switch(uint32_t* save_esp, uint32_t new_esp);
+static uint32_t switch_main_esp;
+static uint32_t switch_side_esp;
+static volatile int switch_side_ran;
+static uint32_t switch_stack[256];
+
+static void switch_side(){
+    switch_side_ran = 1;
+    context_switch(&switch_side_esp, switch_main_esp);
+}
+
+int context_switch_test(){
+    TEST_HEADER;
+    uint32_t* frame = &switch_stack[256 - 8];
+    volatile uint32_t canary = 0x391;
+
+    frame[0] = 0x2;                         //eflags, interrupts off
+    frame[1] = frame[2] = frame[3] = frame[4] = 0;  //edi, esi, ebx, ebp
+    frame[5] = (uint32_t)switch_side;
+    switch_side_ran = 0;
+    context_switch(&switch_main_esp, (uint32_t)frame);
+
+    return (switch_side_ran && canary == 0x391) ? PASS : FAIL;
+}
+
+/*    waitpid_test
+ *  With no forked children waitpid has nothing to wait for, and a status
+ *  pointer outside user memory is refused. Coverage: waitpid */
+int waitpid_test(){
+    TEST_HEADER;
+    int32_t status;
+
+    if(waitpid(-1, NULL, WNOHANG) != -1)
+        return FAIL;
+    if(waitpid(-1, &status, WNOHANG) != -1)   //kernel stack address
+        return FAIL;
+    return PASS;
+}
+
+/*    signal_frame_test
+ *  Delivers a pending ALARM to a handler with a made up register set and
+ *  checks the frame left on the user stack. Coverage: set_handler,
+ *  signal_send, signal_deliver */
+int signal_frame_test(){
+    TEST_HEADER;
+    pcb_t* pcb_ptr = get_pcb(0);
+    hw_context_t ctx;
+    uint32_t* stack;
+    hw_context_t* saved;
+    int result = PASS;
+
+    if(set_handler(NUM_SIGNALS, NULL) != -1 || set_handler(ALARM, (void*)signal_frame_test) != -1)
+        return FAIL;
+
+    user_paging_switch(0);
+    user_map_range(0, USER_MEM + PAGE_4MB - ALIGN_4KB, USER_MEM + PAGE_4MB, USER_MAP_WRITE);
+    memset(pcb_ptr, 0, sizeof(pcb_t));
+    if(set_handler(ALARM, (void*)PROGRAM_IMAGE_ADDR) != 0)
+        result = FAIL;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.eip = PROGRAM_IMAGE_ADDR + 0x100;
+    ctx.esp = USER_MEM + PAGE_4MB - sizeof(int32_t);
+    ctx.eax = 391;
+    signal_send(0, ALARM);
+    signal_deliver(&ctx);
+
+    stack = (uint32_t*)ctx.esp;
+    saved = (hw_context_t*)&stack[2];
+    if(ctx.eip != PROGRAM_IMAGE_ADDR || pcb_ptr->sig_pending != 0 || pcb_ptr->sig_mask != SIG_ALL)
+        result = FAIL;
+    if(stack[1] != ALARM || saved->eax != 391 || saved->eip != PROGRAM_IMAGE_ADDR + 0x100)
+        result = FAIL;
+    if(stack[0] != (uint32_t)(saved + 1))  //returns into the sigreturn code
+        result = FAIL;
+
+    memset(pcb_ptr, 0, sizeof(pcb_t));
+    user_paging_reset(0);
+    return result;
+}
+
+/*    interrupt_test
+ *  Builds a made up process tree to check which process Ctrl-C goes to, and
+ *  which pending signals cut a kernel wait short. Coverage: sched_foreground,
+ *  signal_pending */
+extern uint32_t pid_array[PID_MAX];
+int interrupt_test(){
+    TEST_HEADER;
+    int result = PASS;
+    int i;
+
+    for(i = 0; i < 3; i++){
+        memset(get_pcb(i), 0, sizeof(pcb_t));
+        pid_array[i] = 1;
+    }
+    get_pcb(1)->parent_pid = 0;             //shell -> program
+    get_pcb(2)->parent_pid = 1;             //program -> forked copy
+    get_pcb(2)->forked = 1;
+    if(sched_foreground() != 1)
+        result = FAIL;
+
+    signal_send(0, ALARM);                  //ignored by default
+    if(signal_pending())
+        result = FAIL;
+    signal_send(0, INTERRUPT);
+    if(!signal_pending())
+        result = FAIL;
+    get_pcb(0)->sig_mask = 1 << INTERRUPT;
+    if(signal_pending())
+        result = FAIL;
+
+    for(i = 0; i < 3; i++){
+        memset(get_pcb(i), 0, sizeof(pcb_t));
+        pid_array[i] = 0;
+    }
+    return result;
+}
+
+/*    crashlog_test
+ *  Fills the crash ring past its size and checks that the text lists the
+ *  newest CRASH_RING_SIZE records. Leaves those records in crashlog, so it
+ *  is not run by default. Coverage: crash_record, crashlog_show */
+int crashlog_test(){
+    TEST_HEADER;
+    int8_t text[PROC_BUF_SIZE];
+    int32_t len;
+    int32_t lines = 0;
+    int32_t i;
+
+    for(i = 0; i <= CRASH_RING_SIZE; i++)
+        crash_record(E14, 0x391000 + i, i);
+    len = crashlog_show(text, PROC_BUF_SIZE);
+    for(i = 0; i < len; i++)
+        lines += (text[i] == '\n');
+
+    if(lines != CRASH_RING_SIZE + 1)        //header and the ring
+        return FAIL;
+    if(strncmp(text + len - 4, " 10\n", 4) != 0)    //newest error code last
+        return FAIL;
+    return PASS;
+}
+
+/*    smp_test
+ *  Checks that this code runs on the bootstrap processor and that every AP
+ *  that came online takes local timer interrupts. Passes on one CPU too.
+ *  Coverage: smp_scan, smp_init, smp_this_cpu, lapic_timer_handler */
+int smp_test(){
+    TEST_HEADER;
+    uint32_t before[SMP_MAX_CPUS];
+    uint32_t start;
+    uint32_t i;
+
+    if(smp_this_cpu() != &cpus[0] || !cpus[0].online)
+        return FAIL;
+
+    for(i = 0; i < smp_ncpus; i++)
+        before[i] = cpus[i].ticks;
+    start = pit_ticks;
+    while(pit_ticks - start < 5);
+    for(i = 1; i < smp_ncpus; i++){
+        if(cpus[i].online && cpus[i].ticks == before[i])
+            return FAIL;
+    }
+    return PASS;
+}
+
+/*    smp_cpu_test
+ *  Checks that every CPU that came online has a TSS and page directory of
+ *  its own, sharing the kernel's 4MB entry, and that the bootstrap
+ *  processor holds the kernel lock while the tests run. Passes on one CPU
+ *  too. Coverage: smp_init, paging_ap_init, kernel_lock */
+int smp_cpu_test(){
+    TEST_HEADER;
+    uint32_t i, j;
+
+    if(cpus[0].tss != &tss || cpus[0].dir != page_directory)
+        return FAIL;
+    if(smp_this_cpu()->lock_depth == 0)
+        return FAIL;
+    for(i = 1; i < smp_ncpus; i++){
+        if(!cpus[i].online)
+            continue;
+        if(cpus[i].dir[KERNEL_ADDR / PAGE_4MB].val != page_directory[KERNEL_ADDR / PAGE_4MB].val)
+            return FAIL;
+        for(j = 0; j < i; j++){
+            if(cpus[i].tss == cpus[j].tss || cpus[i].dir == cpus[j].dir)
+                return FAIL;
+        }
+    }
+    return PASS;
+}
+
+/*    serial_test
+ *  Looks ttyS0 up the way open does and sends a line through the transmit
+ *  ring, which must drain. Coverage: serial_lookup, serial_write,
+ *  serial_flush */
+int serial_test(){
+    TEST_HEADER;
+    dentry_t dentry;
+
+    if(read_dentry_by_name((uint8_t*)SERIAL_NAME, &dentry) != 0)
+        return FAIL;
+    if(dentry.ftype != SERIAL_FTYPE)
+        return FAIL;
+    if(read_dentry_by_name((uint8_t*)"ttyS1", &dentry) != -1)
+        return FAIL;
+
+    serial_write("serial_test\n", 12);
+    serial_flush();
+    return PASS;
+}
+
 /* Checkpoint 3 tests */
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
 
+/* Benchmarks, one iteration each, see ktest_bench */
+#define BENCH_ITERS     64
+#define BENCH_WARMUP    4
+
+static int8_t bench_text[PROC_BUF_SIZE];
+static uint32_t bench_inode;
+
+static void bench_memcpy(){
+    memcpy(lib_dst, lib_src, LIB_TEST_MAX);
+}
+
+static void bench_memcpy_unaligned(){
+    memcpy(lib_dst + 1, lib_src + 3, LIB_TEST_MAX - 3);
+}
+
+static void bench_memmove(){
+    memmove(lib_src + 4, lib_src, LIB_TEST_MAX - 4);
+}
+
+static void bench_strlen(){
+    strlen((int8_t*)lib_dst);
+}
+
+static void bench_snprintf(){
+    snprintf(bench_text, sizeof(bench_text), "ESP: %#x \t ESI: %#x\nEFLAGS: %#x\n",
+             0x7FFFF0, 0x1234, 0x202);
+}
+
+static void bench_lookup(){
+    dentry_t dentry;
+    read_dentry_by_name((uint8_t*)"testprint", &dentry);
+}
+
+static void bench_read_cold(){
+    fs_cache_flush();
+    read_data(bench_inode, 0, lib_dst, LIB_TEST_MAX);
+}
+
+static void bench_read_disk(){
+    bcache_flush();
+    read_data(bench_inode, 0, lib_dst, LIB_TEST_MAX);
+}
+
+static void bench_read_warm(){
+    read_data(bench_inode, 0, lib_dst, LIB_TEST_MAX);
+}
+
+/* The EOI an RTC interrupt needs on the 8259s, two writes to ISA ports,
+ * against the single local APIC register write. Nothing is in service
+ * while the benchmarks run, so the EOIs change nothing. */
+#define EOI_BENCH_IRQ   8           //RTC, on the slave 8259
+
+static void bench_eoi_8259(){
+    outb(EOI | (EOI_BENCH_IRQ - MAX_MASTER_IRQ_NUM), SLAVE_8259_CMD_PORT);
+    outb(EOI | SLAVE_IRQ_NUM, MASTER_8259_CMD_PORT);
+}
+
+static void bench_eoi_lapic(){
+    lapic_eoi();
+}
+
+static void bench_irqstat(){
+    stats_show(bench_text, sizeof(bench_text));
+}
+
+/* Benchmark entry point, run when booted with "ktest" */
+void launch_benches(){
+    dentry_t dentry;
+
+    lib_fill(lib_src, LIB_TEST_MAX, 0);
+    lib_fill(lib_dst, LIB_TEST_MAX, 0);
+    lib_dst[LIB_TEST_MAX - 1] = '\0';
+
+    ktest_bench("memcpy_16k", bench_memcpy, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("memcpy_unaligned_16k", bench_memcpy_unaligned, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("memmove_16k", bench_memmove, BENCH_ITERS, BENCH_WARMUP);
+    //memcpy and memmove above leave no NUL in lib_dst
+    lib_dst[LIB_TEST_MAX - 1] = '\0';
+    ktest_bench("strlen_16k", bench_strlen, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("snprintf_regs", bench_snprintf, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("irqstat_show", bench_irqstat, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("eoi_8259", bench_eoi_8259, BENCH_ITERS, BENCH_WARMUP);
+    if(irq_ioapic)
+        ktest_bench("eoi_lapic", bench_eoi_lapic, BENCH_ITERS, BENCH_WARMUP);
+    ktest_bench("dentry_lookup", bench_lookup, BENCH_ITERS, BENCH_WARMUP);
+    //Whichever way fish is stored: run once on an image made with
+    //createfs -z and once without to compare decompressing with copying
+    if(read_dentry_by_name((uint8_t*)"fish", &dentry) == 0){
+        bench_inode = dentry.inode_num;
+        ktest_bench(dentry.ftype == LZ_FTYPE ? "read_fish_lz_cold" : "read_fish_raw",
+                    bench_read_cold, BENCH_ITERS, BENCH_WARMUP);
+        if(dentry.ftype == LZ_FTYPE)
+            ktest_bench("read_fish_lz_cached", bench_read_warm, BENCH_ITERS, BENCH_WARMUP);
+        if(fs_on_disk)
+            ktest_bench("read_fish_disk", bench_read_disk, BENCH_ITERS, BENCH_WARMUP);
+    }
+}
+
 /* Test suite entry point */
 void launch_tests(){
     /* ---- Checkpoint 1 ---- */
@@ -390,6 +1524,32 @@ void launch_tests(){
     /* ---- File System Tests ---- */
     //TEST_OUTPUT("dir_test", dir_test());
     //TEST_OUTPUT("file_test", file_test());
+    TEST_OUTPUT("fs_hash_test", fs_hash_test());
+    TEST_OUTPUT("lz4_test", lz4_test());
+    TEST_OUTPUT("bcache_test", bcache_test());
+    TEST_OUTPUT("proc_test", proc_test());
+    TEST_OUTPUT("trace_test", trace_test());
+    TEST_OUTPUT("prof_test", prof_test());
+    TEST_OUTPUT("string_lib_test", string_lib_test());
+    //TEST_OUTPUT("string_lib_bench", string_lib_bench());
+    TEST_OUTPUT("snprintf_test", snprintf_test());
+    //TEST_OUTPUT("printf_bench", printf_bench());
+    TEST_OUTPUT("elf_test", elf_test());
+    TEST_OUTPUT("map_page_test", map_page_test());
+    TEST_OUTPUT("lazy_page_test", lazy_page_test());
+    TEST_OUTPUT("vidmap_buffer_test", vidmap_buffer_test());
+    TEST_OUTPUT("page_cache_test", page_cache_test());
+    TEST_OUTPUT("elf_nomem_test", elf_nomem_test());
+    TEST_OUTPUT("cow_test", cow_test());
+    TEST_OUTPUT("context_switch_test", context_switch_test());
+    TEST_OUTPUT("waitpid_test", waitpid_test());
+    TEST_OUTPUT("signal_frame_test", signal_frame_test());
+    TEST_OUTPUT("interrupt_test", interrupt_test());
+    //TEST_OUTPUT("crashlog_test", crashlog_test());
+    TEST_OUTPUT("smp_test", smp_test());
+    TEST_OUTPUT("smp_cpu_test", smp_cpu_test());
+    TEST_OUTPUT("serial_test", serial_test());
+    TEST_OUTPUT("terminal_raw_test", terminal_raw_test());
 
     /* ---- RTC Tests ---- */
     //TEST_OUTPUT("rtc_read_write_test", rtc_read_write_test());
@@ -4,4 +4,7 @@
 // test launcher
 void launch_tests();
 
+// benchmark launcher, results go out through ktest_bench
+void launch_benches();
+
 #endif /* TESTS_H */
@@ -0,0 +1,167 @@
+/* trace.c - Syscall trace ring and latency histograms
+ * vim:ts=4 noexpandtab
+ */
+
+#include "trace.h"
+#include "idt.h"
+#include "lib.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "stats.h"
+#include "smp.h"
+
+static int8_t* syscall_names[MAX_SYSCALL_NUM + 1] = {
+    "",
+    "halt",
+    "execute",
+    "read",
+    "write",
+    "open",
+    "close",
+    "getargs",
+    "vidmap",
+    "set_handler",
+    "sigreturn",
+    "trace",
+    "prof_ctl",
+    "prof_read",
+    "fork",
+    "wait",
+    "waitpid",
+    "vidmap_buffered",
+    "vflip",
+};
+
+/* Ring of the most recent syscalls */
+static trace_ring_t trace_ring;
+
+/* hist[num][b] counts calls that took between 2^b and 2^(b+1) - 1 cycles */
+static uint32_t syscall_hist[MAX_SYSCALL_NUM + 1][HIST_BUCKETS];
+
+/* Covers the ring and the histograms */
+static spinlock_t trace_lock = SPINLOCK_INIT("trace");
+
+/* static uint32_t log2_bucket(uint32_t cycles);
+ * Inputs: cycles = duration to bucket
+ * Return Value: index of the highest set bit, 0 for 0 cycles
+ * Function: Picks the histogram bucket with a single bsr */
+static uint32_t log2_bucket(uint32_t cycles) {
+    uint32_t bit;
+
+    if (cycles == 0)
+        return 0;
+    asm ("bsrl %1, %0" : "=r"(bit) : "rm"(cycles));
+    return bit;
+}
+
+/* void trace_ring_add(trace_ring_t* ring, const trace_rec_t* rec);
+ * Inputs: ring = ring to add to
+ *         rec = record to copy in
+ * Return Value: none
+ * Function: stores the record over the oldest one once the ring is full */
+void trace_ring_add(trace_ring_t* ring, const trace_rec_t* rec) {
+    ring->recs[ring->head] = *rec;
+    ring->head = (ring->head + 1) % TRACE_RING_SIZE;
+    if (ring->count < TRACE_RING_SIZE)
+        ring->count++;
+}
+
+/* uint32_t trace_ring_copy(const trace_ring_t* ring, trace_rec_t* out, uint32_t max);
+ * Inputs: ring = ring to read
+ *         out = destination for the records
+ *         max = most records out has room for
+ * Return Value: number of records copied
+ * Function: copies the newest records, oldest first. The ring is left as
+ *           it is. */
+uint32_t trace_ring_copy(const trace_ring_t* ring, trace_rec_t* out, uint32_t max) {
+    uint32_t count = max;
+    uint32_t slot;
+    uint32_t i;
+
+    if (count > ring->count)
+        count = ring->count;
+    slot = (ring->head + TRACE_RING_SIZE - count) % TRACE_RING_SIZE;
+    for (i = 0; i < count; i++) {
+        out[i] = ring->recs[slot];
+        slot = (slot + 1) % TRACE_RING_SIZE;
+    }
+    return count;
+}
+
+/* void syscall_trace(uint32_t cycles, int32_t ret, syscall_frame_t* frame);
+ * Inputs: cycles = TSC cycles the syscall took
+ *         ret = value returned to the user
+ *         frame = arguments and syscall number left on the kernel stack
+ * Return Value: none
+ * Function: Adds the call to the syscall vector's statistics, its histogram
+ *           and the trace ring */
+void syscall_trace(uint32_t cycles, int32_t ret, syscall_frame_t* frame) {
+    trace_rec_t rec;
+    uint32_t flags;
+
+    vec_stat_add(SYSCALL_VEC_NUM, cycles);
+
+    rec.pid = cur_pid;
+    rec.num = frame->num;
+    rec.args[0] = frame->args[0];
+    rec.args[1] = frame->args[1];
+    rec.args[2] = frame->args[2];
+    rec.ret = ret;
+    rec.cycles = cycles;
+
+    spin_lock_irqsave(&trace_lock, flags);
+    syscall_hist[frame->num][log2_bucket(cycles)]++;
+    trace_ring_add(&trace_ring, &rec);
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+/* int32_t trace(void* buf, int32_t nbytes);
+ * Inputs: buf = user buffer for trace_rec_t records
+ *         nbytes = size of buf
+ * Return Value: number of bytes copied, -1 if buf is not all user memory
+ * Function: Copies as many of the newest records as fit, oldest first.
+ *           The ring is left as it is. */
+int32_t trace(void* buf, int32_t nbytes) {
+    uint32_t count;
+    uint32_t flags;
+
+    if (nbytes < 0 || (uint32_t)buf < USER_MEM ||
+        (uint32_t)nbytes > USER_MEM + PAGE_4MB - (uint32_t)buf)
+        return -1;
+
+    spin_lock_irqsave(&trace_lock, flags);
+    count = trace_ring_copy(&trace_ring, (trace_rec_t*)buf, nbytes / sizeof(trace_rec_t));
+    spin_unlock_irqrestore(&trace_lock, flags);
+
+    return count * sizeof(trace_rec_t);
+}
+
+/* int32_t syshist_show(int8_t* buf, int32_t size);
+ * Inputs: buf = destination for the text
+ *         size = size of buf
+ * Return Value: number of characters written
+ * Function: One line per syscall that has run, listing the non-empty
+ *           buckets as <2^b cycles>:<calls> */
+int32_t syshist_show(int8_t* buf, int32_t size) {
+    int32_t len = 0;
+    uint32_t num;
+    uint32_t b;
+
+    len += snprintf(buf + len, size - len, "syscall      log2(cycles):calls\n");
+    for (num = 1; num <= MAX_SYSCALL_NUM; num++) {
+        for (b = 0; b < HIST_BUCKETS; b++) {
+            if (syscall_hist[num][b] != 0)
+                break;
+        }
+        if (b == HIST_BUCKETS)
+            continue;
+
+        len += snprintf(buf + len, size - len, "%-13s", syscall_names[num]);
+        for (; b < HIST_BUCKETS; b++) {
+            if (syscall_hist[num][b] != 0)
+                len += snprintf(buf + len, size - len, "%u:%u ", b, syscall_hist[num][b]);
+        }
+        len += snprintf(buf + len, size - len, "\n");
+    }
+    return len;
+}
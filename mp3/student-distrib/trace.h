@@ -0,0 +1,53 @@
+/* trace.h - Syscall trace ring and latency histograms
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+#define TRACE_RING_SIZE     256     // records kept, oldest are overwritten
+#define TRACE_NUM_ARGS      3
+#define HIST_BUCKETS        32      // one per power of two of TSC cycles
+
+/* One dispatched syscall. Copied out as is by the trace syscall, so the
+ * layout is shared with user programs. */
+typedef struct trace_rec {
+    uint32_t pid;
+    uint32_t num;
+    uint32_t args[TRACE_NUM_ARGS];
+    int32_t  ret;
+    uint32_t cycles;
+} trace_rec_t;
+
+/* Ring of the most recent records, the oldest are overwritten */
+typedef struct trace_ring {
+    trace_rec_t recs[TRACE_RING_SIZE];
+    uint32_t head;                  // slot the next record goes in
+    uint32_t count;
+} trace_ring_t;
+
+/* What syscall_handler leaves on the stack above the return value: the
+ * three arguments, the entry time stamp and the syscall number */
+typedef struct syscall_frame {
+    uint32_t args[TRACE_NUM_ARGS];
+    uint32_t stamp;
+    uint32_t num;
+} syscall_frame_t;
+
+/* Record a finished syscall. Called from syscall_support.S. */
+void syscall_trace(uint32_t cycles, int32_t ret, syscall_frame_t* frame);
+
+/* Add a record to a ring, and copy out up to max of its newest records,
+ * oldest first. The callers keep interrupts off around them. */
+void trace_ring_add(trace_ring_t* ring, const trace_rec_t* rec);
+uint32_t trace_ring_copy(const trace_ring_t* ring, trace_rec_t* out, uint32_t max);
+
+/* Copy the trace ring, oldest record first, into a user buffer */
+int32_t trace(void* buf, int32_t nbytes);
+
+/* Write the per-syscall latency histograms as text into buf */
+int32_t syshist_show(int8_t* buf, int32_t size);
+
+#endif /* _TRACE_H */
@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS     100
+#define RTC_FREQ   4       /* timing window is one RTC period, 1/4 s */
+
+static uint32_t
+rdtsc (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t buf[16];
+
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+static void
+report (const char* what, uint32_t cycles, uint32_t window)
+{
+    uint32_t per_call = cycles / ROUNDS;
+
+    ece391_fdputs (1, (uint8_t*)what);
+    put_num (per_call);
+    ece391_fdputs (1, (uint8_t*)" cycles, ");
+    if (0 != per_call)
+        put_num (window / per_call * RTC_FREQ);
+    else
+        ece391_fdputs (1, (uint8_t*)"?");
+    ece391_fdputs (1, (uint8_t*)" per second\n");
+}
+
+/*
+ * Times fork+waitpid+halt against execute+halt of a program that exits
+ * at once.
+ * Run as "forkbench"; "forkbench child" is the program it executes.
+ */
+int main ()
+{
+    uint8_t arg[32];
+    int32_t rtc_fd, freq = RTC_FREQ, garbage;
+    uint32_t start, window, i;
+    int32_t pid;
+
+    if (0 == ece391_getargs (arg, sizeof (arg)))
+        return 0;
+
+    /* Count TSC cycles in one RTC period */
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    if (-1 == rtc_fd || -1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"could not open rtc\n");
+	return 2;
+    }
+    ece391_read (rtc_fd, &garbage, 4);
+    start = rdtsc ();
+    ece391_read (rtc_fd, &garbage, 4);
+    window = rdtsc () - start;
+    ece391_close (rtc_fd);
+
+    start = rdtsc ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (0 == (pid = ece391_fork ()))
+	    ece391_halt (0);
+	if (-1 == pid || -1 == ece391_waitpid (pid, 0, 0)) {
+	    ece391_fdputs (1, (uint8_t*)"could not fork\n");
+	    return 2;
+	}
+    }
+    report ("fork+halt:    ", rdtsc () - start, window);
+
+    start = rdtsc ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (-1 == ece391_execute ((uint8_t*)"forkbench child")) {
+	    ece391_fdputs (1, (uint8_t*)"could not execute\n");
+	    return 2;
+	}
+    }
+    report ("execute+halt: ", rdtsc () - start, window);
+
+    return 0;
+}
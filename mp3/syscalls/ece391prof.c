@@ -0,0 +1,104 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define INTERVAL   4       /* RTC ticks between samples */
+#define MAX_SLOTS  256     /* distinct (pid, eip) pairs kept */
+#define BATCH      64
+
+typedef struct slot {
+    uint32_t eip;
+    uint32_t pid;
+    uint32_t count;
+} slot_t;
+
+static slot_t slots[MAX_SLOTS];
+static int32_t nslots;
+static uint32_t other;
+
+static void
+put_num (uint32_t value, int32_t radix)
+{
+    uint8_t buf[16];
+
+    ece391_itoa (value, buf, radix);
+    ece391_fdputs (1, buf);
+}
+
+static void
+add_sample (ece391_prof_sample_t* s)
+{
+    int32_t i;
+
+    for (i = 0; i < nslots; i++) {
+        if (slots[i].eip == s->eip && slots[i].pid == s->pid) {
+	    slots[i].count++;
+	    return;
+	}
+    }
+    if (nslots == MAX_SLOTS) {
+        other++;
+	return;
+    }
+    slots[nslots].eip = s->eip;
+    slots[nslots].pid = s->pid;
+    slots[nslots].count = 1;
+    nslots++;
+}
+
+/*
+ * Runs the command with the profiler on, then prints one
+ * "count pid eip" line per sampled address, busiest first.
+ * Feed the output to student-distrib/profsym.sh to get symbols.
+ */
+int main ()
+{
+    static ece391_prof_sample_t batch[BATCH];
+    uint8_t cmd[1024];
+    int32_t cnt, i, j, dropped;
+    slot_t tmp;
+
+    if (0 != ece391_getargs (cmd, 1024)) {
+        ece391_fdputs (1, (uint8_t*)"usage: prof <command>\n");
+	return 3;
+    }
+
+    ece391_prof_ctl (INTERVAL);
+    if (-1 == ece391_execute (cmd)) {
+        ece391_prof_ctl (0);
+        ece391_fdputs (1, (uint8_t*)"could not run command\n");
+	return 2;
+    }
+    dropped = ece391_prof_ctl (0);
+
+    while (0 < (cnt = ece391_prof_read (batch, sizeof (batch)))) {
+        for (i = 0; i < cnt / (int32_t)sizeof (ece391_prof_sample_t); i++)
+	    add_sample (&batch[i]);
+    }
+
+    for (i = 1; i < nslots; i++) {
+        tmp = slots[i];
+	for (j = i; j > 0 && slots[j - 1].count < tmp.count; j--)
+	    slots[j] = slots[j - 1];
+	slots[j] = tmp;
+    }
+
+    for (i = 0; i < nslots; i++) {
+        put_num (slots[i].count, 10);
+	ece391_fdputs (1, (uint8_t*)" ");
+	put_num (slots[i].pid, 10);
+	ece391_fdputs (1, (uint8_t*)" 0x");
+	put_num (slots[i].eip, 16);
+	ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    if (0 != other || 0 != dropped) {
+        ece391_fdputs (1, (uint8_t*)"# unlisted ");
+	put_num (other, 10);
+	ece391_fdputs (1, (uint8_t*)" dropped ");
+	put_num (dropped, 10);
+	ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
@@ -4,14 +4,118 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_JOBS 4
+#define JOB_CMD_LEN 32
+
+/* Programs started with a trailing '&'. pid is 0 for a free slot. */
+typedef struct job {
+    int32_t pid;
+    uint8_t cmd[JOB_CMD_LEN];
+} job_t;
+
+static job_t jobs[MAX_JOBS];
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t buf[16];
+
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+static void
+report (int32_t rval)
+{
+    if (-1 == rval)
+	ece391_fdputs (1, (uint8_t*)"no such command\n");
+    else if (256 == rval)
+	ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
+    else if (0 != rval)
+	ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+}
+
+static void
+job_done (int32_t pid, int32_t status)
+{
+    int32_t i;
+
+    /* Orphans handed to the base shell are reaped without a word */
+    for (i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].pid == pid) {
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    put_num (i + 1);
+	    ece391_fdputs (1, (uint8_t*)(0 == status ? "] done " : "] failed "));
+	    ece391_fdputs (1, jobs[i].cmd);
+	    ece391_fdputs (1, (uint8_t*)"\n");
+	    jobs[i].pid = 0;
+	    return;
+	}
+    }
+}
+
+/*
+ * Runs cmd in a forked copy of the shell so the prompt comes back at once.
+ * The copy waits in execute and halts with 0 if the program succeeded.
+ */
+static void
+job_start (uint8_t* cmd)
+{
+    int32_t i, pid, rval;
+
+    for (i = 0; i < MAX_JOBS && 0 != jobs[i].pid; i++);
+    if (MAX_JOBS == i) {
+        ece391_fdputs (1, (uint8_t*)"too many jobs\n");
+	return;
+    }
+
+    if (0 == (pid = ece391_fork ())) {
+        rval = ece391_execute (cmd);
+	report (rval);
+	ece391_halt (0 == rval ? 0 : 1);
+    }
+    if (-1 == pid) {
+        ece391_fdputs (1, (uint8_t*)"could not start job\n");
+	return;
+    }
+
+    jobs[i].pid = pid;
+    if (ece391_strlen (cmd) >= JOB_CMD_LEN)
+        cmd[JOB_CMD_LEN - 1] = '\0';
+    ece391_strcpy (jobs[i].cmd, cmd);
+    ece391_fdputs (1, (uint8_t*)"[");
+    put_num (i + 1);
+    ece391_fdputs (1, (uint8_t*)"] ");
+    put_num (pid);
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+static void
+jobs_list (void)
+{
+    int32_t i;
+
+    for (i = 0; i < MAX_JOBS; i++) {
+        if (0 != jobs[i].pid) {
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    put_num (i + 1);
+	    ece391_fdputs (1, (uint8_t*)"] running ");
+	    ece391_fdputs (1, jobs[i].cmd);
+	    ece391_fdputs (1, (uint8_t*)"\n");
+	}
+    }
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, pid, status;
     uint8_t buf[BUFSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        while (0 < (pid = ece391_waitpid (-1, &status, WNOHANG)))
+	    job_done (pid, status);
+
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -19,18 +123,31 @@ int main ()
 	}
 	if (cnt > 0 && '\n' == buf[cnt - 1])
 	    cnt--;
+	while (cnt > 0 && ' ' == buf[cnt - 1])
+	    cnt--;
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
+	if (0 == ece391_strcmp (buf, (uint8_t*)"jobs")) {
+	    jobs_list ();
+	    continue;
+	}
+	if (0 == ece391_strcmp (buf, (uint8_t*)"wait")) {
+	    while (-1 != (pid = ece391_wait (&status)))
+	        job_done (pid, status);
+	    continue;
+	}
+	if ('&' == buf[cnt - 1]) {
+	    buf[--cnt] = '\0';
+	    while (cnt > 0 && ' ' == buf[cnt - 1])
+	        buf[--cnt] = '\0';
+	    if (cnt > 0)
+	        job_start (buf);
+	    continue;
+	}
 	rval = ece391_execute (buf);
-	if (-1 == rval)
-	    ece391_fdputs (1, (uint8_t*)"no such command\n");
-	else if (256 == rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
-	else if (0 != rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	report (rval);
     }
 }
-
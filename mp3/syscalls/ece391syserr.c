@@ -199,7 +199,8 @@ int err_unopened(void) {
 }
 
 /* TEST 6 err_vidmap
- * tries to call vidmap with a NULL ptr and an address in the kernel
+ * tries to call vidmap and vidmap_buffered with a NULL ptr and an address
+ * in the kernel, and vflip without a back page
  * prints "[TEST_NAME]: PASS" if behavior is EXPECTED
  *     and then returns 0
  * prints "[TEST_NAME]: FAIL" if behavior is UNEXPECTED
@@ -217,6 +218,17 @@ int err_vidmap(void) {
 		ece391_fdputs (1, (uint8_t*)"Kernel pointer fail fail\n");
 		fail = 2;
 	}
+
+	if (-1 != ece391_vidmap_buffered((uint8_t **) 0x0) ||
+	    -1 != ece391_vidmap_buffered((uint8_t **) 0x400000)) {
+		ece391_fdputs (1, (uint8_t*)"Buffered bad pointer fail\n");
+		fail = 2;
+	}
+
+	if (-1 != ece391_vflip()) {
+		ece391_fdputs (1, (uint8_t*)"vflip without a back page fail\n");
+		fail = 2;
+	}
 	
 	if (fail) {
 		ece391_fdputs (1, (uint8_t*)"err_vidmap: FAIL\n");
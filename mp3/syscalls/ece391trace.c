@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_RECS 64
+
+static const char* names[] = {
+    "?", "halt", "execute", "read", "write", "open", "close",
+    "getargs", "vidmap", "set_handler", "sigreturn", "trace",
+    "prof_ctl", "prof_read", "fork", "wait", "waitpid",
+    "vidmap_buffered", "vflip"
+};
+
+static void
+put_num (uint32_t value, int32_t radix)
+{
+    uint8_t buf[16];
+
+    ece391_itoa (value, buf, radix);
+    ece391_fdputs (1, buf);
+}
+
+int main ()
+{
+    static ece391_trace_rec_t recs[MAX_RECS];
+    int32_t fd, cnt, n, i, j;
+    uint8_t buf[1024];
+
+    cnt = ece391_trace (recs, sizeof (recs));
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"trace failed\n");
+	return 3;
+    }
+
+    n = cnt / sizeof (ece391_trace_rec_t);
+    for (i = 0; i < n; i++) {
+        put_num (recs[i].pid, 10);
+	ece391_fdputs (1, (uint8_t*)" ");
+	if (recs[i].num < sizeof (names) / sizeof (names[0]))
+	    ece391_fdputs (1, (uint8_t*)names[recs[i].num]);
+	else
+	    put_num (recs[i].num, 10);
+	ece391_fdputs (1, (uint8_t*)"(");
+	for (j = 0; j < 3; j++) {
+	    ece391_fdputs (1, (uint8_t*)(j == 0 ? "0x" : ", 0x"));
+	    put_num (recs[i].args[j], 16);
+	}
+	ece391_fdputs (1, (uint8_t*)") = ");
+	if (recs[i].ret < 0) {
+	    ece391_fdputs (1, (uint8_t*)"-");
+	    put_num (-recs[i].ret, 10);
+	} else {
+	    put_num (recs[i].ret, 10);
+	}
+	ece391_fdputs (1, (uint8_t*)"  ");
+	put_num (recs[i].cycles, 10);
+	ece391_fdputs (1, (uint8_t*)" cycles\n");
+    }
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"syshist")))
+        return 0;
+    while (0 < (cnt = ece391_read (fd, buf, 1024)))
+        ece391_write (1, buf, cnt);
+    ece391_close (fd);
+
+    return 0;
+}